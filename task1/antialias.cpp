@@ -0,0 +1,69 @@
+#include "antialias.h"
+
+#include <algorithm>
+#include <vector>
+
+Tile grow_tile(const Tile& tile, int width, int height) {
+    return Tile {std::max(tile.x0 - 1, 0), std::max(tile.y0 - 1, 0),
+                 std::min(tile.x1 + 1, width), std::min(tile.y1 + 1, height)};
+}
+
+EdgeRefineStats refine_edges(const PixelIterator& iterate_samples, int samples, const Tile& tile,
+                             int width, int height, const int* iterations, int stride,
+                             int num_it, const Gradient& gradient, unsigned char* rgb, int rgb_stride) {
+    const Tile grown = grow_tile(tile, width, height);
+    auto at = [&](int x, int y) {
+        x = std::min(std::max(x, grown.x0), grown.x1 - 1);
+        y = std::min(std::max(y, grown.y0), grown.y1 - 1);
+        return iterations[size_t(y - grown.y0) * stride + (x - grown.x0)];
+    };
+
+    // edge pixels first, then all their samples in one call so that the kernels get long spans
+    std::vector<int> edges;
+    for (int y = tile.y0; y < tile.y1; ++y)
+        for (int x = tile.x0; x < tile.x1; ++x) {
+            const int center = at(x, y);
+            bool edge = false;
+
+            for (int dy = -1; dy <= 1 and not edge; ++dy)
+                for (int dx = -1; dx <= 1 and not edge; ++dx)
+                    edge = at(x + dx, y + dy) != center;
+
+            if (edge) {
+                edges.push_back(x);
+                edges.push_back(y);
+            }
+        }
+
+    EdgeRefineStats stats;
+    stats.pixels = int64_t(edges.size() / 2);
+
+    const int per_pixel = samples * samples;
+    std::vector<int> xs, ys, values(edges.size() / 2 * per_pixel);
+    xs.reserve(values.size());
+    ys.reserve(values.size());
+    for (size_t e = 0; e < edges.size(); e += 2)
+        for (int j = 0; j < samples; ++j)
+            for (int i = 0; i < samples; ++i) {
+                xs.push_back(edges[e] * samples + i);
+                ys.push_back(edges[e + 1] * samples + j);
+            }
+
+    stats.iterations = iterate_samples(xs.data(), ys.data(), int(xs.size()), values.data());
+
+    for (size_t p = 0; p < edges.size() / 2; ++p) {
+        float sum[3] = {0, 0, 0};
+        for (int s = 0; s < per_pixel; ++s) {
+            float color[3];
+            sample_color(values[p * per_pixel + s], num_it, gradient, color);
+            for (int c = 0; c < 3; ++c)
+                sum[c] += color[c];
+        }
+
+        unsigned char* out = rgb + (size_t(edges[2 * p + 1] - tile.y0) * rgb_stride + (edges[2 * p] - tile.x0)) * 3;
+        for (int c = 0; c < 3; ++c)
+            out[c] = to_channel(sum[c] / per_pixel);
+    }
+
+    return stats;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tile_render.h"
+
+// Adaptive edge supersampling, the cpu mirror of refine.glsl. A pixel with one of its 8
+// neighbours at another iteration value (the image border is clamped) is sampled on a
+// samples x samples sub-pixel grid and gets the average color of the samples, all other
+// pixels keep their color. Most of the boundary aliasing goes for a small share of the
+// cost of supersampling every pixel.
+
+// Tile with one more pixel on every side, clipped to the image: what refine_edges
+// needs to tell edge pixels of the tile.
+Tile grow_tile(const Tile& tile, int width, int height);
+
+struct EdgeRefineStats {
+    int64_t pixels = 0;       // refined ones
+    uint64_t iterations = 0;  // pixel-iterations of their samples
+};
+
+// Refines the pixels of tile. iterations points at pixel (grown.x0, grown.y0) of
+// grown = grow_tile(tile, width, height), stride in elements. rgb points at pixel
+// (tile.x0, tile.y0), 3 bytes per pixel, rgb_stride in pixels.
+// iterate_samples iterates the samples times larger image: its pixel
+// (x * samples + i, y * samples + j) is sample (i, j) of pixel (x, y).
+EdgeRefineStats refine_edges(const PixelIterator& iterate_samples, int samples, const Tile& tile,
+                             int width, int height, const int* iterations, int stride,
+                             int num_it, const Gradient& gradient, unsigned char* rgb, int rgb_stride);
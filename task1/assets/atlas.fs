@@ -0,0 +1,89 @@
+#version 330 core
+
+// Julia sets of the atlas cells and the escape time overview of the c plane, colored
+// directly. Appended with palette.glsl and kernel_glsl, see atlas.vs.
+out vec4 o_frag_color;
+
+in vec2 coordinates;
+flat in vec2 cell_c;
+flat in int overview;
+
+uniform float u_R;
+uniform int u_num_it;
+
+// orbit_bailout is max(u_escape_radius, |c|), see frac-shader.fs
+uniform bool u_periodicity;
+uniform float u_escape_radius;
+const float PERIODICITY_EPS = 1e-6;
+
+// corners of the sweep of the cells in c, outlined on the overview
+uniform vec2 u_sweep_min;
+uniform vec2 u_sweep_max;
+uniform float u_overview_pixel;
+const float OVERVIEW_EXTENT = 2.0;
+
+vec2 fractal_step(vec2 z, vec2 c);
+bool fractal_captured(vec2 z, float r, float r2);
+int fractal_value(int i, vec2 z);
+vec4 palette_color(int i);
+
+// iterate_overview in atlas.cpp
+int escape_time(vec2 c)
+{
+    float bailout2 = max(4.0, c.x * c.x + c.y * c.y);
+    vec2 z = vec2(0.0);
+
+    for (int i = 1; i <= u_num_it; ++i) {
+        z = fractal_step(z, c);
+        if (z.x * z.x + z.y * z.y > bailout2)
+            return i;
+    }
+
+    return 0;
+}
+
+// the loop of frac-shader.fs, the cell is the fractal quad at scale 1
+int julia_value(vec2 world, vec2 c)
+{
+    float bailout = max(u_escape_radius, sqrt(c.x * c.x + c.y * c.y));
+    vec2 cur = fractal_step(world, c);
+    vec2 saved = vec2(1e10);
+    int next_save = 1;
+
+    for (int i = 1; i <= u_num_it; ++i, cur = fractal_step(cur, c)) {
+        if (fractal_captured(cur, u_R, u_R * u_R))
+            return fractal_value(i, cur);
+
+        if (u_periodicity) {
+            float len2 = cur.x * cur.x + cur.y * cur.y;
+            vec2 d = cur - saved;
+            if (d.x * d.x + d.y * d.y <= PERIODICITY_EPS * PERIODICITY_EPS || bailout * bailout <= len2)
+                return 0;
+
+            if (i == next_save) {
+                saved = cur;
+                next_save *= 2;
+            }
+        }
+    }
+
+    return 0;
+}
+
+void main()
+{
+    if (overview == 0) {
+        o_frag_color = palette_color(julia_value(coordinates, cell_c));
+        return;
+    }
+
+    vec2 c = coordinates * OVERVIEW_EXTENT;
+    vec2 border = min(abs(c - u_sweep_min), abs(c - u_sweep_max));
+    bool near = all(greaterThan(c, u_sweep_min - u_overview_pixel)) && all(lessThan(c, u_sweep_max + u_overview_pixel));
+    if (near && min(border.x, border.y) < u_overview_pixel) {
+        o_frag_color = vec4(1.0);
+        return;
+    }
+
+    o_frag_color = palette_color(escape_time(c));
+}
@@ -0,0 +1,31 @@
+#version 330 core
+
+// Parameter atlas, one instance per square: instance 0 is the c plane overview, then the
+// cells row by row. Placed as atlas_geometry in atlas.cpp, in pixels from the top left.
+layout (location = 0) in vec3 in_position;
+layout (location = 1) in vec2 in_c;  // per instance, c of the cell
+
+out vec2 coordinates;  // -1 .. 1 over the square, y up
+flat out vec2 cell_c;
+flat out int overview;
+
+uniform vec2 u_viewport;
+uniform int u_cols;
+uniform vec3 u_overview;  // x, y, size
+uniform vec3 u_grid;      // x, y of the first cell, cell size
+
+void main()
+{
+    vec3 square = u_overview;
+    if (gl_InstanceID > 0) {
+        int k = gl_InstanceID - 1;
+        square = vec3(u_grid.xy + vec2(k % u_cols, k / u_cols) * u_grid.z, u_grid.z);
+    }
+
+    overview = gl_InstanceID == 0 ? 1 : 0;
+    cell_c = in_c;
+    coordinates = in_position.xy;
+
+    vec2 pixel = square.xy + (vec2(in_position.x, -in_position.y) + 1.0) * 0.5 * square.z;
+    gl_Position = vec4(2.0 * pixel.x / u_viewport.x - 1.0, 1.0 - 2.0 * pixel.y / u_viewport.y, 0.0, 1.0);
+}
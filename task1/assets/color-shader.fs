@@ -0,0 +1,64 @@
+#version 330 core
+
+out vec4 o_frag_color;
+
+// written by frac-shader.fs
+uniform isampler2D u_iterations;
+
+// edge pixels refined by the refine pass (alpha 1), see refine.glsl
+uniform bool u_antialias;
+uniform sampler2D u_refined;
+
+// framebuffer size, the iteration buffer is smaller while interacting (dynamic resolution)
+uniform vec2 u_viewport;
+
+// palette.glsl
+vec4 palette_color(int i);
+
+// bilinear between the colors of the 4 nearest iteration values
+vec4 upscaled_color(ivec2 size)
+{
+    vec2 p = gl_FragCoord.xy * vec2(size) / u_viewport - 0.5;
+    ivec2 p0 = ivec2(floor(p));
+    vec2 f = p - vec2(p0);
+    ivec2 lo = clamp(p0, ivec2(0), size - 1), hi = clamp(p0 + 1, ivec2(0), size - 1);
+
+    int i00 = texelFetch(u_iterations, ivec2(lo.x, lo.y), 0).r;
+    int i10 = texelFetch(u_iterations, ivec2(hi.x, lo.y), 0).r;
+    int i01 = texelFetch(u_iterations, ivec2(lo.x, hi.y), 0).r;
+    int i11 = texelFetch(u_iterations, ivec2(hi.x, hi.y), 0).r;
+
+    // ITER_OUTSIDE everywhere, keep the background
+    if (max(max(i00, i10), max(i01, i11)) < 0)
+        discard;
+
+    return mix(mix(palette_color(i00), palette_color(i10), f.x),
+               mix(palette_color(i01), palette_color(i11), f.x), f.y);
+}
+
+void main()
+{
+    ivec2 size = textureSize(u_iterations, 0);
+    if (size != ivec2(u_viewport)) {
+        o_frag_color = upscaled_color(size);
+        return;
+    }
+
+    ivec2 p = ivec2(gl_FragCoord.xy);
+
+    if (u_antialias) {
+        vec4 refined = texelFetch(u_refined, p, 0);
+        if (refined.a > 0.0) {
+            o_frag_color = vec4(refined.rgb, 1.0);
+            return;
+        }
+    }
+
+    int i = texelFetch(u_iterations, p, 0).r;
+
+    // ITER_OUTSIDE, keep the background
+    if (i < 0)
+        discard;
+
+    o_frag_color = palette_color(i);
+}
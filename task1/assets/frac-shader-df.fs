@@ -0,0 +1,128 @@
+#version 330 core
+
+// frac-shader.fs in double-float, see Precision::DoubleFloat: a value is vec2(hi, lo)
+// with hi + lo exact. Drawn like frac-shader-fp64.fs, the functions are the ones in
+// fractal_cpu.cpp. They rely on the compiler keeping the float operations as written.
+layout (location = 0) out ivec2 o_iter;
+
+// refine pass, see frac-shader.fs
+layout (location = 1) out vec4 o_color;
+uniform bool u_refine;
+vec4 refine_color();
+
+const int ITER_OUTSIDE = -1;
+
+uniform vec2 u_cvec;
+uniform float u_R;
+uniform int u_num_it;
+
+uniform bool u_periodicity;
+uniform float u_bailout;
+const float PERIODICITY_EPS = 1e-6;
+
+uniform vec2 u_size;
+uniform vec2 u_translation_hi;
+uniform vec2 u_translation_lo;
+uniform float u_scale;
+uniform float u_aspect_ratio;
+
+vec2 two_sum(float a, float b) {
+    float s = a + b;
+    float v = s - a;
+    return vec2(s, (a - (s - v)) + (b - v));
+}
+
+// |a| >= |b|
+vec2 quick_two_sum(float a, float b) {
+    float s = a + b;
+    return vec2(s, b - (s - a));
+}
+
+vec2 split(float a) {
+    float t = a * 4097.0;
+    float hi = t - (t - a);
+    return vec2(hi, a - hi);
+}
+
+vec2 two_prod(float a, float b) {
+    float p = a * b;
+    vec2 as = split(a), bs = split(b);
+    return vec2(p, ((as.x * bs.x - p) + as.x * bs.y + as.y * bs.x) + as.y * bs.y);
+}
+
+vec2 df_add(vec2 a, vec2 b) {
+    vec2 s = two_sum(a.x, b.x);
+    return quick_two_sum(s.x, s.y + (a.y + b.y));
+}
+
+vec2 df_sub(vec2 a, vec2 b) {
+    return df_add(a, -b);
+}
+
+vec2 df_mul(vec2 a, vec2 b) {
+    vec2 p = two_prod(a.x, b.x);
+    return quick_two_sum(p.x, p.y + (a.x * b.y + a.y * b.x));
+}
+
+bool df_le(vec2 a, float b) {
+    return a.x < b || (a.x == b && a.y <= 0.0);
+}
+
+// the pixel moved by offset (in pixels, within +-0.5)
+ivec2 iterate_sample(vec2 offset)
+{
+    // the offset from the center is small, float is enough for it
+    float nx = 2.0 * (gl_FragCoord.x + offset.x) / u_size.x - 1.0;
+    float ny = (1.0 - 2.0 * (u_size.y - gl_FragCoord.y - offset.y) / u_size.y) * u_aspect_ratio;
+    vec2 x = df_add(vec2(u_translation_hi.x, u_translation_lo.x), vec2(nx / u_scale, 0.0));
+    vec2 y = df_add(vec2(u_translation_hi.y, u_translation_lo.y), vec2(ny / u_scale, 0.0));
+    if (abs(x.x) > 1.0 || abs(y.x) > 1.0)
+        return ivec2(ITER_OUTSIDE, 0);
+
+    vec2 cx = vec2(u_cvec.x, 0.0), cy = vec2(u_cvec.y, 0.0);
+
+    vec2 zx = df_add(df_sub(df_mul(x, x), df_mul(y, y)), cx);
+    vec2 zy = df_add(2.0 * df_mul(x, y), cy);
+
+    vec2 saved = vec2(1e10);
+    int next_save = 1;
+
+    for (int i = 1; i <= u_num_it; ++i) {
+        vec2 xx = df_mul(zx, zx), yy = df_mul(zy, zy);
+        vec2 len2 = df_add(xx, yy);
+        if (df_le(len2, u_R * u_R))
+            return ivec2(i, i);
+
+        // high parts are plenty for this
+        if (u_periodicity) {
+            vec2 d = vec2(zx.x, zy.x) - saved;
+            if (d.x * d.x + d.y * d.y <= PERIODICITY_EPS * PERIODICITY_EPS || u_bailout * u_bailout <= len2.x)
+                return ivec2(0, i);
+
+            if (i == next_save) {
+                saved = vec2(zx.x, zy.x);
+                next_save *= 2;
+            }
+        }
+
+        vec2 xy = df_mul(zx, zy);
+        zx = df_add(df_sub(xx, yy), cx);
+        zy = df_add(2.0 * xy, cy);
+    }
+
+    return ivec2(0, u_num_it);
+}
+
+void main()
+{
+    if (u_refine) {
+        o_color = refine_color();
+        return;
+    }
+
+    ivec2 res = iterate_sample(vec2(0));
+    if (res.x == ITER_OUTSIDE)
+        discard;
+
+    o_iter = res;
+}
@@ -0,0 +1,87 @@
+#version 330 core
+#extension GL_ARB_gpu_shader_fp64 : require
+
+// frac-shader.fs in double, see Precision::Double. The quad is drawn over the whole
+// screen and the pixel position is taken from gl_FragCoord, as interpolated
+// coordinates are float only. Same expressions as world_x and world_y in fractal_cpu.cpp.
+layout (location = 0) out ivec2 o_iter;
+
+// refine pass, see frac-shader.fs
+layout (location = 1) out vec4 o_color;
+uniform bool u_refine;
+vec4 refine_color();
+
+const int ITER_OUTSIDE = -1;
+
+uniform vec2 u_cvec;
+uniform float u_R;
+uniform int u_num_it;
+
+uniform bool u_periodicity;
+uniform float u_bailout;
+const float PERIODICITY_EPS = 1e-6;
+
+uniform vec2 u_size;
+uniform dvec2 u_translation_d;
+uniform double u_scale_d;
+uniform float u_aspect_ratio;
+
+// see frac-shader.fs, kernel_glsl for double
+dvec2 fractal_step(dvec2 z, dvec2 c);
+bool fractal_captured(dvec2 z, double r, double r2);
+int fractal_value(int i, dvec2 z);
+
+// the pixel moved by offset (in pixels, within +-0.5)
+ivec2 iterate_sample(vec2 offset)
+{
+    // gl_FragCoord is at pixel centers, 2 * x + 1 and 2 * y + 1 for the top row first y
+    double x = double(gl_FragCoord.x) + double(offset.x);
+    double y = double(u_size.y - gl_FragCoord.y) - double(offset.y);
+    double nx = 2.0 * x / double(u_size.x) - 1.0;
+    double ny = (1.0 - 2.0 * y / double(u_size.y)) * double(u_aspect_ratio);
+    dvec2 world = dvec2(nx, ny) / u_scale_d + u_translation_d;
+    if (abs(world.x) > 1.0 || abs(world.y) > 1.0)
+        return ivec2(ITER_OUTSIDE, 0);
+
+    dvec2 c = dvec2(u_cvec);
+    double r = double(u_R), r2 = double(u_R * u_R), bailout2 = double(u_bailout * u_bailout);
+
+    dvec2 cur = fractal_step(world, c);
+    dvec2 saved = dvec2(1e10);
+    int next_save = 1;
+
+    for (int i = 1; i <= u_num_it; ++i) {
+        if (fractal_captured(cur, r, r2))
+            return ivec2(fractal_value(i, cur), i);
+
+        if (u_periodicity) {
+            double len2 = cur.x * cur.x + cur.y * cur.y;
+            dvec2 d = cur - saved;
+            if (d.x * d.x + d.y * d.y <= double(PERIODICITY_EPS * PERIODICITY_EPS) || bailout2 <= len2)
+                return ivec2(0, i);
+
+            if (i == next_save) {
+                saved = cur;
+                next_save *= 2;
+            }
+        }
+
+        cur = fractal_step(cur, c);
+    }
+
+    return ivec2(0, u_num_it);
+}
+
+void main()
+{
+    if (u_refine) {
+        o_color = refine_color();
+        return;
+    }
+
+    ivec2 res = iterate_sample(vec2(0));
+    if (res.x == ITER_OUTSIDE)
+        discard;
+
+    o_iter = res;
+}
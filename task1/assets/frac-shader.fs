@@ -1,8 +1,19 @@
 #version 330 core
 
-out vec4 o_frag_color;
+// iteration buffer: x is the value, see ITER_* in fractal_cpu.h, y is the number of f_c
+// evaluations done. Colors are applied by color-shader.fs, pixels that are not drawn keep
+// the cleared (ITER_OUTSIDE, 0)
+layout (location = 0) out ivec2 o_iter;
 in vec2 coordinates;
 
+// refine pass: colors of edge pixels instead, see refine.glsl (appended with palette.glsl)
+layout (location = 1) out vec4 o_color;
+uniform bool u_refine;
+uniform vec2 u_size;
+vec4 refine_color();
+
+const int ITER_OUTSIDE = -1;
+
 vec2 cmult(vec2 a, vec2 b) {
     return vec2(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
 }
@@ -11,25 +22,134 @@ uniform vec2 u_cvec;
 uniform float u_R;
 uniform int u_num_it;
 
-uniform sampler2D grad;
+// stop orbits that escaped past u_bailout or are stuck in a cycle, see FractalParams::periodicity
+uniform bool u_periodicity;
+const float PERIODICITY_EPS = 1e-6;
+
+// deep zoom: coordinates are ndc and every pixel is a perturbation of the reference orbit,
+// its offset from the orbit start is (ndc * u_delta_mant + u_orbit_offset) * 2^u_delta_exp,
+// u_orbit_offset being where the view moved since the orbit was computed
+uniform bool u_deep;
+uniform sampler2D u_orbit;
+uniform int u_orbit_len;
+uniform int u_orbit_width;
+uniform float u_delta_mant;
+uniform float u_delta_exp;
+uniform vec2 u_orbit_offset;
+uniform float u_bailout;
+
+uniform vec2 u_translation;
+uniform float u_scale;
+uniform float u_aspect_ratio;
 
-// vec4 color_in = vec4(1, 0.3, 0.3, 1.0);
-vec4 color_out = vec4(0, 0, 0, 1.0);
+// z^n + c, the capture test and the iteration value of the KernelVariant, generated by
+// kernel_glsl and appended by shader_t
+vec2 fractal_step(vec2 z, vec2 c);
+bool fractal_captured(vec2 z, float r, float r2);
+int fractal_value(int i, vec2 z);
 
-vec2 f_c(vec2 z) {
-    return cmult(z, z) + u_cvec;
+vec2 orbit_point(int m) {
+    return texelFetch(u_orbit, ivec2(m % u_orbit_width, m / u_orbit_width), 0).xy;
 }
 
-void main()
+// same as iterate_point_deep in deep_zoom.cpp, ndc has y scaled by the aspect ratio
+ivec2 iterate_deep(vec2 ndc)
 {
-    // return texture(grad, 0.5 * (coordinates + vec2(1, 0)));
-    vec2 cur = f_c(coordinates);
+    // the fractal quad, only matters when the view is not deep yet
+    vec2 world = u_translation + ndc / u_scale;
+    if (abs(world.x) > 1 || abs(world.y) > 1)
+        return ivec2(ITER_OUTSIDE, 0);
+
+    vec2 d = ndc * u_delta_mant + u_orbit_offset;
+    float e = u_delta_exp;
+    int m = 0;
+    int last = u_orbit_len - 1;
+
+    for (int i = 1; i <= u_num_it; ++i) {
+        vec2 z = orbit_point(m);
+        float s = exp2(e);
+
+        d = 2.0 * cmult(z, d) + s * cmult(d, d);
+        m += 1;
 
-    for (int i = 1; i <= u_num_it; ++i, cur = f_c(cur))
-        if (cur.x * cur.x + cur.y * cur.y <= u_R * u_R) {
-            o_frag_color = texture(grad, vec2((i - 1) / float(u_num_it - 1), 0));
-            return;
+        float mx = max(abs(d.x), abs(d.y));
+        if (mx > 256.0 || (mx < 1.0 / 256.0 && mx > 0.0)) {
+            float k = floor(log2(mx));
+            d *= exp2(-k);
+            e += k;
         }
-    
-    o_frag_color = color_out;
+
+        vec2 delta = d * exp2(e);
+        vec2 cur = orbit_point(m) + delta;
+        float len2 = dot(cur, cur);
+
+        if (len2 <= u_R * u_R)
+            return ivec2(i, i);
+        if (len2 > u_bailout * u_bailout)
+            return ivec2(0, i);
+
+        if (m == last || len2 < dot(delta, delta)) {
+            d = cur - orbit_point(0);
+            e = 0.0;
+            m = 0;
+        }
+    }
+
+    return ivec2(0, u_num_it);
+}
+
+// the pixel moved by offset (in pixels, within +-0.5)
+ivec2 iterate_sample(vec2 offset)
+{
+    // ndc (and world) units per pixel, the same for x and y
+    float pixel = 2.0 / u_size.x;
+
+    if (u_deep)
+        return iterate_deep(vec2(coordinates.x, coordinates.y * u_aspect_ratio) + offset * pixel);
+
+    // the refine pass is drawn over the whole screen, coordinates are ndc
+    vec2 world = coordinates;
+    if (u_refine)
+        world = u_translation + (vec2(coordinates.x, coordinates.y * u_aspect_ratio) + offset * pixel) / u_scale;
+    if (abs(world.x) > 1 || abs(world.y) > 1)
+        return ivec2(ITER_OUTSIDE, 0);
+
+    vec2 cur = fractal_step(world, u_cvec);
+
+    // Brent: compare with the value saved at the last power of two step
+    vec2 saved = vec2(1e10);
+    int next_save = 1;
+
+    for (int i = 1; i <= u_num_it; ++i, cur = fractal_step(cur, u_cvec)) {
+        if (fractal_captured(cur, u_R, u_R * u_R))
+            return ivec2(fractal_value(i, cur), i);
+
+        if (u_periodicity) {
+            float len2 = cur.x * cur.x + cur.y * cur.y;
+            vec2 d = cur - saved;
+            if (d.x * d.x + d.y * d.y <= PERIODICITY_EPS * PERIODICITY_EPS || u_bailout * u_bailout <= len2)
+                return ivec2(0, i);
+
+            if (i == next_save) {
+                saved = cur;
+                next_save *= 2;
+            }
+        }
+    }
+
+    return ivec2(0, u_num_it);
+}
+
+void main()
+{
+    if (u_refine) {
+        o_color = refine_color();
+        return;
+    }
+
+    ivec2 res = iterate_sample(vec2(0));
+    if (res.x == ITER_OUTSIDE)
+        discard;
+
+    o_iter = res;
 }
@@ -6,11 +6,20 @@ out vec2 coordinates;
 uniform vec2 u_translation;
 uniform float u_scale;
 uniform float u_aspect_ratio;
+uniform bool u_deep;
+uniform bool u_refine;
 
 void main()
 {
     vec2 pos = vec2(in_position.x, in_position.y);
 
+    // deep zoom and the refine pass cover the whole screen, coordinates are in ndc then
+    if (u_deep || u_refine) {
+        gl_Position = vec4(pos, in_position.z, 1.0);
+        coordinates = pos;
+        return;
+    }
+
     vec2 tr_pos = pos - u_translation;
     
     gl_Position = vec4(tr_pos.x * u_scale, tr_pos.y * u_scale / u_aspect_ratio, in_position.z, 1.0);
@@ -0,0 +1,31 @@
+// Iteration value -> color, appended to color-shader.fs and the frac-shader*.fs by
+// shader_t. Same as sample_color in fractal_cpu.cpp with the default palette.
+
+// max_value of the FractalParams, the largest iteration value
+uniform int u_max_value;
+
+uniform sampler2D grad;
+
+// the gradient is mirrored after 1, offset 0 and repeat 1 give the plain gradient
+uniform float u_palette_offset;
+uniform float u_palette_repeat;
+
+// glClearColor in OpenGL::main_loop
+const vec4 color_background = vec4(0.30, 0.55, 0.60, 1.0);
+const vec4 color_out = vec4(0, 0, 0, 1.0);
+
+vec4 palette_color(int i)
+{
+    // ITER_OUTSIDE
+    if (i < 0)
+        return color_background;
+    if (i == 0)
+        return color_out;
+
+    float t = u_max_value > 1 ? (i - 1) / float(u_max_value - 1) : 0.0;
+    t = t * u_palette_repeat + u_palette_offset;
+    t = 1.0 - abs(mod(t, 2.0) - 1.0);
+
+    // no implicit derivatives, this is called in loops of the refine pass
+    return textureLod(grad, vec2(t, 0), 0.0);
+}
@@ -0,0 +1,31 @@
+// Adaptive edge supersampling, appended to the frac-shader*.fs after palette.glsl. A pixel
+// with one of its 8 neighbours at another iteration value gets u_refine_samples^2 samples
+// on a sub-pixel grid and the average of their colors, other pixels are discarded. Needs
+// iterate_sample of the shader it is appended to. Same as refine_edges in antialias.cpp.
+
+uniform isampler2D u_iterations;
+uniform int u_refine_samples;
+
+vec4 refine_color()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ivec2 last = textureSize(u_iterations, 0) - 1;
+    int center = texelFetch(u_iterations, p, 0).x;
+
+    bool edge = false;
+    for (int dy = -1; dy <= 1; ++dy)
+        for (int dx = -1; dx <= 1; ++dx)
+            edge = edge || texelFetch(u_iterations, clamp(p + ivec2(dx, dy), ivec2(0), last), 0).x != center;
+
+    if (!edge)
+        discard;
+
+    vec4 sum = vec4(0);
+    for (int j = 0; j < u_refine_samples; ++j)
+        for (int i = 0; i < u_refine_samples; ++i) {
+            vec2 offset = (vec2(i, j) + 0.5) / float(u_refine_samples) - 0.5;
+            sum += palette_color(iterate_sample(offset).x);
+        }
+
+    return sum / float(u_refine_samples * u_refine_samples);
+}
@@ -0,0 +1,140 @@
+#version 430 core
+
+// Mariani-Silver on the gpu: every work group owns a TILE x TILE square of the iteration
+// buffer and goes down through blocks of TILE, TILE / 2, ... MIN_BLOCK pixels. Only the
+// borders of the blocks are iterated, blocks with a uniform border are filled, the rest of
+// the pixels is iterated at the end. Same output as frac-shader.fs apart from what the
+// filling gets wrong.
+
+layout (local_size_x = 16, local_size_y = 16) in;
+
+layout (rg32i, binding = 0) uniform writeonly iimage2D u_iterations;
+uniform ivec2 u_size;
+
+uniform vec2 u_translation;
+uniform float u_scale;
+uniform float u_aspect_ratio;
+
+uniform vec2 u_cvec;
+uniform float u_R;
+uniform int u_num_it;
+
+uniform bool u_periodicity;
+uniform float u_bailout;
+const float PERIODICITY_EPS = 1e-6;
+
+const int TILE = 64;
+const int MIN_BLOCK = 8;
+const int THREADS = 256;
+const int ITER_OUTSIDE = -1;
+const int UNKNOWN = -2;
+
+shared int values[TILE * TILE];
+
+// f_c evaluations (0 for filled pixels) of the pixels of this thread, pixel i is always
+// handled by thread i % THREADS
+int steps[TILE * TILE / THREADS];
+shared int uniform_block[(TILE / MIN_BLOCK) * (TILE / MIN_BLOCK)];
+
+// see frac-shader.fs, appended by shader_t
+vec2 fractal_step(vec2 z, vec2 c);
+bool fractal_captured(vec2 z, float r, float r2);
+int fractal_value(int i, vec2 z);
+
+// pixel (0, 0) is the bottom left one, as in the framebuffer, same loop as frac-shader.fs
+ivec2 iterate(ivec2 p) {
+    if (p.x >= u_size.x || p.y >= u_size.y)
+        return ivec2(ITER_OUTSIDE, 0);
+
+    vec2 ndc = (2.0 * vec2(p) + 1.0) / vec2(u_size) - 1.0;
+    vec2 world = vec2(ndc.x, ndc.y * u_aspect_ratio) / u_scale + u_translation;
+    if (abs(world.x) > 1.0 || abs(world.y) > 1.0)
+        return ivec2(ITER_OUTSIDE, 0);
+
+    vec2 cur = fractal_step(world, u_cvec);
+    vec2 saved = vec2(1e10);
+    int next_save = 1;
+
+    for (int i = 1; i <= u_num_it; ++i, cur = fractal_step(cur, u_cvec)) {
+        if (fractal_captured(cur, u_R, u_R * u_R))
+            return ivec2(fractal_value(i, cur), i);
+
+        if (u_periodicity) {
+            float len2 = cur.x * cur.x + cur.y * cur.y;
+            vec2 d = cur - saved;
+            if (d.x * d.x + d.y * d.y <= PERIODICITY_EPS * PERIODICITY_EPS || u_bailout * u_bailout <= len2)
+                return ivec2(0, i);
+
+            if (i == next_save) {
+                saved = cur;
+                next_save *= 2;
+            }
+        }
+    }
+
+    return ivec2(0, u_num_it);
+}
+
+void compute(int i, ivec2 p) {
+    ivec2 res = iterate(p);
+    values[i] = res.x;
+    steps[i / THREADS] = res.y;
+}
+
+void sync() {
+    memoryBarrierShared();
+    barrier();
+}
+
+void main()
+{
+    ivec2 origin = ivec2(gl_WorkGroupID.xy) * TILE;
+    int tid = int(gl_LocalInvocationIndex);
+
+    for (int i = tid; i < TILE * TILE; i += THREADS) {
+        values[i] = UNKNOWN;
+        steps[i / THREADS] = 0;
+    }
+    sync();
+
+    for (int size = TILE; size >= MIN_BLOCK; size /= 2) {
+        int blocks = TILE / size;
+
+        for (int i = tid; i < TILE * TILE; i += THREADS) {
+            ivec2 m = ivec2(i % TILE, i / TILE) % size;
+            bool border = m.x == 0 || m.y == 0 || m.x == size - 1 || m.y == size - 1;
+            if (border && values[i] == UNKNOWN)
+                compute(i, origin + ivec2(i % TILE, i / TILE));
+        }
+        for (int b = tid; b < blocks * blocks; b += THREADS)
+            uniform_block[b] = 1;
+        sync();
+
+        // any border pixel that differs from the corner breaks the block, ITER_OUTSIDE always does
+        for (int i = tid; i < TILE * TILE; i += THREADS) {
+            ivec2 l = ivec2(i % TILE, i / TILE);
+            ivec2 m = l % size, b = l / size;
+            int corner = values[(b.y * size) * TILE + b.x * size];
+            bool border = m.x == 0 || m.y == 0 || m.x == size - 1 || m.y == size - 1;
+            if (border && (values[i] != corner || corner == ITER_OUTSIDE))
+                uniform_block[b.y * blocks + b.x] = 0;
+        }
+        sync();
+
+        for (int i = tid; i < TILE * TILE; i += THREADS) {
+            ivec2 b = ivec2(i % TILE, i / TILE) / size;
+            if (values[i] == UNKNOWN && uniform_block[b.y * blocks + b.x] == 1)
+                values[i] = values[(b.y * size) * TILE + b.x * size];
+        }
+        sync();
+    }
+
+    // every thread handles the same pixels in all loops, no sync needed from here
+    for (int i = tid; i < TILE * TILE; i += THREADS) {
+        ivec2 p = origin + ivec2(i % TILE, i / TILE);
+        if (values[i] == UNKNOWN)
+            compute(i, p);
+        if (p.x < u_size.x && p.y < u_size.y)
+            imageStore(u_iterations, p, ivec4(values[i], steps[i / THREADS], 0, 0));
+    }
+}
@@ -0,0 +1,144 @@
+#include "atlas.h"
+
+#include <algorithm>
+#include <cmath>
+
+AtlasGeometry atlas_geometry(const AtlasLayout& layout, int width, int height) {
+    AtlasGeometry geometry;
+
+    int grid_left = 0;
+    if (layout.overview) {
+        geometry.overview_size = std::min(height, width / 3);
+        geometry.overview_y = (height - geometry.overview_size) / 2;
+        grid_left = geometry.overview_size;
+    }
+
+    int grid_width = width - grid_left;
+    geometry.cell = std::max(0, std::min(grid_width / layout.cols, height / layout.rows));
+    geometry.grid_x = grid_left + (grid_width - geometry.cell * layout.cols) / 2;
+    geometry.grid_y = (height - geometry.cell * layout.rows) / 2;
+    return geometry;
+}
+
+void atlas_cell_c(const AtlasLayout& layout, int col, int row, double* c) {
+    double step = layout.span / layout.cols;
+    c[0] = layout.center[0] + (col + 0.5 - 0.5 * layout.cols) * step;
+    c[1] = layout.center[1] - (row + 0.5 - 0.5 * layout.rows) * step;
+}
+
+AtlasHit atlas_hit(const AtlasLayout& layout, int width, int height, double x, double y, double* c) {
+    const AtlasGeometry geometry = atlas_geometry(layout, width, height);
+
+    double u = x - geometry.overview_x, v = y - geometry.overview_y;
+    if (geometry.overview_size > 0 and u >= 0 and v >= 0 and u < geometry.overview_size and v < geometry.overview_size) {
+        c[0] = (2 * u / geometry.overview_size - 1) * OVERVIEW_EXTENT;
+        c[1] = (1 - 2 * v / geometry.overview_size) * OVERVIEW_EXTENT;
+        return AtlasHit::Overview;
+    }
+
+    if (geometry.cell == 0)
+        return AtlasHit::None;
+
+    int col = int(std::floor((x - geometry.grid_x) / geometry.cell));
+    int row = int(std::floor((y - geometry.grid_y) / geometry.cell));
+    if (col < 0 or row < 0 or col >= layout.cols or row >= layout.rows)
+        return AtlasHit::None;
+
+    atlas_cell_c(layout, col, row, c);
+    return AtlasHit::Cell;
+}
+
+FractalParams atlas_cell_params(const FractalParams& params, const AtlasLayout& layout, int col, int row) {
+    double c[2];
+    atlas_cell_c(layout, col, row, c);
+
+    FractalParams cell = params;
+    cell.translation[0] = cell.translation[1] = 0;
+    cell.scale = 1;
+    cell.aspect_ratio = 1;
+    cell.cvec[0] = float(c[0]);
+    cell.cvec[1] = float(c[1]);
+    cell.precision = Precision::Float;
+    return cell;
+}
+
+uint64_t iterate_overview(const FractalParams& params, int size, int x0, int y0, int x1, int y1,
+                          int* out, int stride) {
+    const float extent = float(OVERVIEW_EXTENT);
+    uint64_t iterations = 0;
+
+    for (int y = y0; y < y1; ++y)
+        for (int x = x0; x < x1; ++x) {
+            float cx = float((2.0 * x + 1) / size - 1) * extent;
+            float cy = float(1 - (2.0 * y + 1) / size) * extent;
+            float bailout2 = std::max(4.0f, cx * cx + cy * cy);
+
+            float zx = 0, zy = 0;
+            int value = ITER_NEVER, i = 1;
+            for (; i <= params.num_it; ++i) {
+                // fractal_step of kernel_glsl
+                float px = zx, py = zy;
+                for (int k = 1; k < params.variant.power; ++k) {
+                    float t = px * zx - py * zy;
+                    py = px * zy + py * zx;
+                    px = t;
+                }
+                zx = px + cx, zy = py + cy;
+
+                if (zx * zx + zy * zy > bailout2) {
+                    value = i;
+                    break;
+                }
+            }
+
+            out[size_t(y - y0) * stride + (x - x0)] = value;
+            iterations += std::min(i, params.num_it);
+        }
+
+    return iterations;
+}
+
+TiledRenderStats render_atlas(const FractalParams& params, const AtlasLayout& layout, int width, int height,
+                              const TiledRenderOptions& options,
+                              const Gradient& gradient, std::vector<unsigned char>& rgb) {
+    const AtlasGeometry geometry = atlas_geometry(layout, width, height);
+
+    TiledRenderOptions plain = options;
+    plain.subdivide = false;
+    plain.antialias = 0;
+
+    auto iterate = [&](const Tile& tile, int* out, int stride) {
+        for (int y = tile.y0; y < tile.y1; ++y)
+            std::fill_n(out + size_t(y - tile.y0) * stride, tile.x1 - tile.x0, ITER_OUTSIDE);
+
+        // part of the square at (x, y) inside the tile, in pixels of the square
+        int x0, y0, x1, y1;
+        auto clip = [&](int x, int y, int size) {
+            x0 = std::max(tile.x0, x) - x, x1 = std::min(tile.x1, x + size) - x;
+            y0 = std::max(tile.y0, y) - y, y1 = std::min(tile.y1, y + size) - y;
+            return x0 < x1 and y0 < y1;
+        };
+        auto at = [&](int x, int y) {
+            return out + size_t(y - tile.y0) * stride + (x - tile.x0);
+        };
+
+        uint64_t iterations = 0;
+        const int ox = geometry.overview_x, oy = geometry.overview_y;
+        if (geometry.overview_size > 0 and clip(ox, oy, geometry.overview_size))
+            iterations += iterate_overview(params, geometry.overview_size, x0, y0, x1, y1,
+                                           at(ox + x0, oy + y0), stride);
+
+        for (int row = 0; geometry.cell > 0 and row < layout.rows; ++row)
+            for (int col = 0; col < layout.cols; ++col) {
+                const int cx = geometry.grid_x + col * geometry.cell, cy = geometry.grid_y + row * geometry.cell;
+                if (clip(cx, cy, geometry.cell))
+                    iterations += iterate_region(atlas_cell_params(params, layout, col, row),
+                                                 geometry.cell, geometry.cell, x0, y0, x1, y1,
+                                                 at(cx + x0, cy + y0), stride, options.kernel);
+            }
+
+        return iterations;
+    };
+
+    return render_tiled(iterate, max_value(params), width, height, plain, gradient, rgb);
+}
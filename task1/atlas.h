@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "fractal_cpu.h"
+#include "tile_render.h"
+
+// Parameter atlas: a cols x rows grid of small Julia sets for a sweep of c, next to an
+// overview of the c plane (the Mandelbrot set of the variant's power) to pick the sweep
+// from. The layout is shared by atlas.vs and the cpu render, pixel rows from the top.
+
+// the overview shows c in [-OVERVIEW_EXTENT, OVERVIEW_EXTENT]^2
+const double OVERVIEW_EXTENT = 2;
+const int MAX_ATLAS_SIDE = 16;
+
+struct AtlasLayout {
+    int cols = 8, rows = 6;
+    double center[2] = {0, 0};  // c of the middle of the grid
+    double span = 1;            // c across the grid, cells are span / cols apart in re and im
+    bool overview = true;
+};
+
+// squares in pixels, top left corner
+struct AtlasGeometry {
+    int overview_x = 0, overview_y = 0, overview_size = 0;  // size 0 without the overview
+    int grid_x = 0, grid_y = 0, cell = 0;
+};
+
+// The overview is a square at the left, a third of the width at most, the cells are the
+// largest squares that fit the rest, centered.
+AtlasGeometry atlas_geometry(const AtlasLayout& layout, int width, int height);
+
+// c of cell (col, row), row 0 at the top
+void atlas_cell_c(const AtlasLayout& layout, int col, int row, double* c);
+
+enum class AtlasHit {
+    None,
+    Overview,
+    Cell
+};
+
+// What is under the point (x, y) in pixels, c gets the c there (of the cell for a cell).
+AtlasHit atlas_hit(const AtlasLayout& layout, int width, int height, double x, double y, double* c);
+
+// the FractalParams of a cell: the fractal quad at scale 1 with the cell's c
+FractalParams atlas_cell_params(const FractalParams& params, const AtlasLayout& layout, int col, int row);
+
+// Escape time of c = overview pixel (x, y) in a size x size overview, as iterate_region:
+// the first i with |z_i| > max(2, |c|) for z_0 = 0 and f_c of the variant's power,
+// ITER_NEVER if that never happens within params.num_it. Float, like atlas.fs.
+uint64_t iterate_overview(const FractalParams& params, int size, int x0, int y0, int x1, int y1,
+                          int* out, int stride);
+
+// The whole atlas as one tiled job, tiles are split at cell borders. Subdivision and
+// antialiasing of options are ignored.
+TiledRenderStats render_atlas(const FractalParams& params, const AtlasLayout& layout, int width, int height,
+                              const TiledRenderOptions& options,
+                              const Gradient& gradient, std::vector<unsigned char>& rgb);
@@ -0,0 +1,231 @@
+#include "bigfixed.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <stdexcept>
+
+BigFixed::BigFixed(int frac_limbs): limbs(std::max(frac_limbs, 0) + 1, 0) {
+}
+
+BigFixed::BigFixed(double value, int frac_limbs): BigFixed(frac_limbs) {
+    if (value == 0 or not std::isfinite(value))
+        return;
+
+    negative = value < 0;
+
+    int exponent;
+    double mantissa = std::frexp(std::abs(value), &exponent);
+    uint64_t bits = uint64_t(std::ldexp(mantissa, 53));
+
+    // value = bits * 2^(exponent - 53), limb bit 0 is 2^(-32 * frac_limbs)
+    int shift = exponent - 53 + 32 * this->frac_limbs();
+    for (int b = 0; b < 53; ++b) {
+        int pos = b + shift;
+        if ((bits >> b & 1) and pos >= 0 and pos < 32 * int(limbs.size()))
+            limbs[pos / 32] |= uint32_t(1) << (pos % 32);
+    }
+
+    if (is_zero())
+        negative = false;
+}
+
+BigFixed BigFixed::from_string(const std::string& s, int frac_limbs) {
+    size_t pos = 0;
+    bool negative = false;
+    if (pos < s.size() and (s[pos] == '-' or s[pos] == '+'))
+        negative = s[pos++] == '-';
+
+    std::string int_digits, frac_digits;
+    while (pos < s.size() and std::isdigit((unsigned char)s[pos]))
+        int_digits += s[pos++];
+    if (pos < s.size() and s[pos] == '.')
+        for (++pos; pos < s.size() and std::isdigit((unsigned char)s[pos]); ++pos)
+            frac_digits += s[pos];
+
+    int exponent = 0;
+    if (pos < s.size() and (s[pos] == 'e' or s[pos] == 'E')) {
+        size_t used = 0;
+        exponent = std::stoi(s.substr(pos + 1), &used);
+        pos += 1 + used;
+    }
+
+    if (pos != s.size() or (int_digits.empty() and frac_digits.empty()))
+        throw std::runtime_error("bad number " + s);
+
+    // one guard limb for the divisions below
+    BigFixed res(frac_limbs + 1);
+    for (auto it = frac_digits.rbegin(); it != frac_digits.rend(); ++it) {
+        res.limbs.back() = uint32_t(*it - '0');
+        res.div_small(10);
+    }
+
+    uint64_t int_part = 0;
+    for (char c: int_digits) {
+        int_part = int_part * 10 + (c - '0');
+        if (int_part >> 32)
+            throw std::runtime_error("integer part is too large in " + s);
+    }
+    res.limbs.back() = uint32_t(int_part);
+
+    for (; exponent > 0; --exponent)
+        res.mul_small(10);
+    for (; exponent < 0; ++exponent)
+        res.div_small(10);
+
+    res.set_precision(frac_limbs);
+    res.negative = negative and not res.is_zero();
+    return res;
+}
+
+int BigFixed::limbs_for_scale(double scale) {
+    double bits = std::max(0.0, std::log2(std::max(scale, 1.0))) + 64;
+    return int(std::ceil(bits / 32)) + 1;
+}
+
+void BigFixed::set_precision(int frac_limbs) {
+    frac_limbs = std::max(frac_limbs, 0);
+    int diff = frac_limbs - this->frac_limbs();
+
+    if (diff > 0)
+        limbs.insert(limbs.begin(), diff, 0);
+    else if (diff < 0)
+        limbs.erase(limbs.begin(), limbs.begin() - diff);
+
+    if (is_zero())
+        negative = false;
+}
+
+bool BigFixed::is_zero() const {
+    return std::all_of(limbs.begin(), limbs.end(), [](uint32_t l) { return l == 0; });
+}
+
+int BigFixed::compare_magnitude(const BigFixed& a, const BigFixed& b) {
+    for (int i = int(a.limbs.size()) - 1; i >= 0; --i)
+        if (a.limbs[i] != b.limbs[i])
+            return a.limbs[i] < b.limbs[i] ? -1 : 1;
+    return 0;
+}
+
+void BigFixed::add_magnitude(std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+    uint64_t carry = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        uint64_t t = uint64_t(a[i]) + b[i] + carry;
+        a[i] = uint32_t(t);
+        carry = t >> 32;
+    }
+}
+
+// a -= b, |a| >= |b|
+void BigFixed::sub_magnitude(std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+    int64_t borrow = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        int64_t t = int64_t(a[i]) - b[i] - borrow;
+        borrow = t < 0;
+        a[i] = uint32_t(t + (borrow << 32));
+    }
+}
+
+void BigFixed::div_small(uint32_t d) {
+    uint64_t rem = 0;
+    for (int i = int(limbs.size()) - 1; i >= 0; --i) {
+        uint64_t cur = rem << 32 | limbs[i];
+        limbs[i] = uint32_t(cur / d);
+        rem = cur % d;
+    }
+}
+
+void BigFixed::mul_small(uint32_t m) {
+    uint64_t carry = 0;
+    for (auto& limb: limbs) {
+        uint64_t t = uint64_t(limb) * m + carry;
+        limb = uint32_t(t);
+        carry = t >> 32;
+    }
+}
+
+double BigFixed::to_double() const {
+    double res = 0;
+    for (int i = int(limbs.size()) - 1; i >= 0; --i)
+        res += std::ldexp(double(limbs[i]), 32 * (i - frac_limbs()));
+    return negative ? -res : res;
+}
+
+std::string BigFixed::to_string(int digits) const {
+    std::string res = negative ? "-" : "";
+    res += std::to_string(limbs.back());
+    res += '.';
+
+    BigFixed frac = *this;
+    for (int i = 0; i < digits; ++i) {
+        frac.limbs.back() = 0;
+        frac.mul_small(10);
+        res += char('0' + frac.limbs.back());
+    }
+
+    return res;
+}
+
+BigFixed BigFixed::operator-() const {
+    BigFixed res = *this;
+    res.negative = not negative and not is_zero();
+    return res;
+}
+
+BigFixed BigFixed::operator+(const BigFixed& other) const {
+    BigFixed a = *this, b = other;
+    int prec = std::max(a.frac_limbs(), b.frac_limbs());
+    a.set_precision(prec);
+    b.set_precision(prec);
+
+    if (a.negative == b.negative) {
+        add_magnitude(a.limbs, b.limbs);
+    } else if (compare_magnitude(a, b) >= 0) {
+        sub_magnitude(a.limbs, b.limbs);
+    } else {
+        sub_magnitude(b.limbs, a.limbs);
+        a = b;
+    }
+
+    if (a.is_zero())
+        a.negative = false;
+    return a;
+}
+
+BigFixed BigFixed::operator-(const BigFixed& other) const {
+    return *this + (-other);
+}
+
+BigFixed BigFixed::operator*(const BigFixed& other) const {
+    int prec = std::max(frac_limbs(), other.frac_limbs());
+    BigFixed a = *this, b = other;
+    a.set_precision(prec);
+    b.set_precision(prec);
+
+    const size_t n = a.limbs.size();
+    std::vector<uint32_t> product(2 * n, 0);
+
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < n; ++j) {
+            uint64_t t = uint64_t(a.limbs[i]) * b.limbs[j] + product[i + j] + carry;
+            product[i + j] = uint32_t(t);
+            carry = t >> 32;
+        }
+        product[i + n] = uint32_t(carry);
+    }
+
+    // drop the extra fractional limbs, the integer part is assumed to fit in one limb
+    BigFixed res(prec);
+    std::copy(product.begin() + prec, product.begin() + prec + n, res.limbs.begin());
+    res.negative = (a.negative != b.negative) and not res.is_zero();
+    return res;
+}
+
+bool BigFixed::operator==(const BigFixed& other) const {
+    BigFixed a = *this, b = other;
+    int prec = std::max(a.frac_limbs(), b.frac_limbs());
+    a.set_precision(prec);
+    b.set_precision(prec);
+    return a.negative == b.negative and a.limbs == b.limbs;
+}
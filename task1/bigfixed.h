@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Signed fixed point number with one 32-bit integer limb and a configurable
+// number of 32-bit fractional limbs. Just enough arithmetic for reference orbits.
+class BigFixed {
+private:
+    bool negative = false;
+    std::vector<uint32_t> limbs;  // little endian, limbs[frac_limbs] is the integer part
+
+    int frac_limbs() const {
+        return int(limbs.size()) - 1;
+    }
+
+    bool is_zero() const;
+    static int compare_magnitude(const BigFixed& a, const BigFixed& b);
+    static void add_magnitude(std::vector<uint32_t>& a, const std::vector<uint32_t>& b);
+    static void sub_magnitude(std::vector<uint32_t>& a, const std::vector<uint32_t>& b);
+    void div_small(uint32_t d);
+    void mul_small(uint32_t m);
+
+public:
+    explicit BigFixed(int frac_limbs = 2);
+    BigFixed(double value, int frac_limbs);
+
+    // "[-]123.456[e-78]"
+    static BigFixed from_string(const std::string& s, int frac_limbs);
+
+    // number of fractional limbs enough for a view with the given scale (pixels are ~1/scale apart)
+    static int limbs_for_scale(double scale);
+
+    int precision() const {
+        return frac_limbs();
+    }
+
+    // extends with zeros or truncates the fractional part
+    void set_precision(int frac_limbs);
+
+    double to_double() const;
+    std::string to_string(int digits) const;
+
+    BigFixed operator-() const;
+    BigFixed operator+(const BigFixed& other) const;
+    BigFixed operator-(const BigFixed& other) const;
+    BigFixed operator*(const BigFixed& other) const;
+
+    BigFixed& operator+=(const BigFixed& other) {
+        return *this = *this + other;
+    }
+
+    BigFixed& operator-=(const BigFixed& other) {
+        return *this = *this - other;
+    }
+
+    bool operator==(const BigFixed& other) const;
+
+    bool operator!=(const BigFixed& other) const {
+        return not (*this == other);
+    }
+};
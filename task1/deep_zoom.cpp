@@ -0,0 +1,166 @@
+#include "deep_zoom.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // keeps |d| around 1, the magnitude goes to the exponent
+    void renormalize(float& dx, float& dy, float& e) {
+        float mx = std::max(std::abs(dx), std::abs(dy));
+
+        if (mx > 256 or (mx < 1 / 256.0f and mx > 0)) {
+            float k = std::floor(std::log2(mx));
+            dx *= std::exp2(-k);
+            dy *= std::exp2(-k);
+            e += k;
+        }
+    }
+
+    // delta_{k+1} = 2 Z_k delta_k + delta_k^2, where delta = d * 2^e
+    int iterate_point_deep(float dx, float dy, float e, const ReferenceOrbit& orbit,
+                           int num_it, float r2, float bailout2) {
+        const float* ref = orbit.points.data();
+        const int last = orbit.length() - 1;
+        int m = 0;
+
+        for (int i = 1; i <= num_it; ++i) {
+            float zx = ref[2 * m], zy = ref[2 * m + 1];
+            float s = std::exp2(e);
+
+            float nx = 2 * (zx * dx - zy * dy) + s * (dx * dx - dy * dy);
+            float ny = 2 * (zx * dy + zy * dx) + s * (2 * dx * dy);
+            dx = nx, dy = ny;
+            m += 1;
+
+            renormalize(dx, dy, e);
+
+            float deltax = dx * std::exp2(e), deltay = dy * std::exp2(e);
+            float x = ref[2 * m] + deltax, y = ref[2 * m + 1] + deltay;
+            float len2 = x * x + y * y;
+
+            if (len2 <= r2)
+                return i;
+            if (len2 > bailout2)
+                return ITER_NEVER;
+
+            // end of the reference or the pixel got closer to 0 than to the reference:
+            // continue against the start of the orbit, precision is not a problem any more
+            if (m == last or len2 < deltax * deltax + deltay * deltay) {
+                dx = x - ref[0];
+                dy = y - ref[1];
+                e = 0;
+                m = 0;
+            }
+        }
+
+        return ITER_NEVER;
+    }
+
+    struct DeepPixels {
+        const FractalParams& params;
+        const DeepView& view;
+        const ReferenceOrbit& orbit;
+        int width, height;
+
+        float mantissa, exponent;
+        float offset[2];
+        double center[2];
+        float r2, bailout2;
+
+        DeepPixels(const FractalParams& params, const DeepView& view, const ReferenceOrbit& orbit, int width, int height)
+            : params(params), view(view), orbit(orbit), width(width), height(height) {
+            split_inv_scale(view.scale, mantissa, exponent);
+            orbit_offset(view, orbit, exponent, offset[0], offset[1]);
+            center[0] = view.center[0].to_double();
+            center[1] = view.center[1].to_double();
+            r2 = params.R * params.R;
+            bailout2 = orbit.bailout * orbit.bailout;
+        }
+
+        int operator()(int x, int y) const {
+            float nx = (2 * x + 1) / float(width) - 1;
+            float ny = (1 - (2 * y + 1) / float(height)) * params.aspect_ratio;
+
+            // the fractal quad, only matters when the view is not deep yet
+            if (std::abs(center[0] + nx / view.scale) > 1 or std::abs(center[1] + ny / view.scale) > 1)
+                return ITER_OUTSIDE;
+
+            return iterate_point_deep(nx * mantissa + offset[0], ny * mantissa + offset[1], exponent, orbit,
+                                      params.num_it, r2, bailout2);
+        }
+    };
+}
+
+ReferenceOrbit compute_reference_orbit(const DeepView& view, const FractalParams& params) {
+    ReferenceOrbit orbit;
+    orbit.bailout = orbit_bailout(params);
+
+    const int prec = BigFixed::limbs_for_scale(view.scale);
+    BigFixed x = view.center[0], y = view.center[1];
+    x.set_precision(prec);
+    y.set_precision(prec);
+    orbit.center[0] = x;
+    orbit.center[1] = y;
+
+    const BigFixed cx(params.cvec[0], prec), cy(params.cvec[1], prec);
+    const float bailout2 = orbit.bailout * orbit.bailout;
+
+    orbit.points.reserve(2 * (size_t(params.num_it) + 1));
+    for (int k = 0; k <= params.num_it; ++k) {
+        float fx = float(x.to_double()), fy = float(y.to_double());
+        orbit.points.push_back(fx);
+        orbit.points.push_back(fy);
+
+        if (k >= 1 and fx * fx + fy * fy > bailout2)
+            break;
+
+        BigFixed xx = x * x, yy = y * y, xy = x * y;
+        x = xx - yy + cx;
+        y = xy + xy + cy;
+    }
+
+    return orbit;
+}
+
+void split_inv_scale(double scale, float& mantissa, float& exponent) {
+    int e;
+    mantissa = float(std::frexp(1 / scale, &e));
+    exponent = float(e);
+}
+
+void orbit_offset(const DeepView& view, const ReferenceOrbit& orbit, float exponent, float& dx, float& dy) {
+    dx = float(std::ldexp((view.center[0] - orbit.center[0]).to_double(), -int(exponent)));
+    dy = float(std::ldexp((view.center[1] - orbit.center[1]).to_double(), -int(exponent)));
+}
+
+uint64_t iterate_region_deep(const FractalParams& params, const DeepView& view, const ReferenceOrbit& orbit,
+                             int width, int height, int x0, int y0, int x1, int y1,
+                             int* out, int stride) {
+    DeepPixels pixel(params, view, orbit, width, height);
+
+    uint64_t iterations = 0;
+    for (int y = y0; y < y1; ++y) {
+        int* row = out + size_t(y - y0) * stride;
+
+        for (int x = x0; x < x1; ++x) {
+            int res = row[x - x0] = pixel(x, y);
+            iterations += res == ITER_NEVER ? params.num_it : std::max(res, 0);
+        }
+    }
+
+    return iterations;
+}
+
+uint64_t iterate_pixels_deep(const FractalParams& params, const DeepView& view, const ReferenceOrbit& orbit,
+                             int width, int height, const int* xs, const int* ys, int n, int* out) {
+    DeepPixels pixel(params, view, orbit, width, height);
+
+    uint64_t iterations = 0;
+    for (int i = 0; i < n; ++i) {
+        int res = out[i] = pixel(xs[i], ys[i]);
+        iterations += res == ITER_NEVER ? params.num_it : std::max(res, 0);
+    }
+
+    return iterations;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "bigfixed.h"
+#include "fractal_cpu.h"
+
+// View for zooms beyond float precision, the center is kept in BigFixed.
+// Only aspect_ratio, cvec, R and num_it of FractalParams are used together with it.
+struct DeepView {
+    BigFixed center[2];
+    double scale = 1;
+};
+
+// f_c^k(center) for k = 0, 1, ..., computed in BigFixed and rounded to float.
+// Stops once the orbit leaves the bailout radius, but has at least 2 points.
+// A view that moved away from center is still drawn against it, see orbit_offset.
+struct ReferenceOrbit {
+    std::vector<float> points;  // x0, y0, x1, y1, ...
+    float bailout = 2;
+    BigFixed center[2];
+
+    int length() const {
+        return int(points.size() / 2);
+    }
+};
+
+ReferenceOrbit compute_reference_orbit(const DeepView& view, const FractalParams& params);
+
+// Pixel offsets are kept as mantissa * 2^exponent, this splits 1 / scale that way.
+void split_inv_scale(double scale, float& mantissa, float& exponent);
+
+// view center minus the orbit start in units of 2^exponent, added to every pixel offset
+void orbit_offset(const DeepView& view, const ReferenceOrbit& orbit, float exponent, float& dx, float& dy);
+
+// Perturbation of every pixel against the reference orbit in plain float, the cpu
+// counterpart of the deep path in frac-shader.fs. Same output as iterate_region.
+uint64_t iterate_region_deep(const FractalParams& params, const DeepView& view, const ReferenceOrbit& orbit,
+                             int width, int height, int x0, int y0, int x1, int y1,
+                             int* out, int stride);
+
+// same for a list of pixels, see iterate_pixels
+uint64_t iterate_pixels_deep(const FractalParams& params, const DeepView& view, const ReferenceOrbit& orbit,
+                             int width, int height, const int* xs, const int* ys, int n, int* out);
@@ -0,0 +1,566 @@
+#include "distributed.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+#include "subdivision.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // every message is this header and length bytes of payload
+    const uint32_t PROTOCOL_MAGIC = 0x314c554a;  // "JUL1"
+    const size_t HEADER_BYTES = 12;
+
+    enum class Message : uint32_t {
+        Hello = 1,   // worker: pid
+        Job = 2,     // coordinator: tile, image size, FractalParams
+        Result = 3,  // worker: tile, pixel-iterations, seconds, the iteration values
+        Quit = 4     // coordinator
+    };
+
+    class Packer {
+    private:
+        std::vector<unsigned char> bytes;
+
+    public:
+        explicit Packer(Message type) {
+            put(PROTOCOL_MAGIC);
+            put(uint32_t(type));
+            put(uint32_t(0));
+        }
+
+        template<typename T>
+        void put(T value) {
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(&value);
+            bytes.insert(bytes.end(), p, p + sizeof(T));
+        }
+
+        void put_bytes(const void* data, size_t size) {
+            const unsigned char* p = static_cast<const unsigned char*>(data);
+            bytes.insert(bytes.end(), p, p + size);
+        }
+
+        // with the payload length filled in
+        const std::vector<unsigned char>& finish() {
+            uint32_t length = uint32_t(bytes.size() - HEADER_BYTES);
+            std::memcpy(bytes.data() + 8, &length, sizeof(length));
+            return bytes;
+        }
+    };
+
+    class Unpacker {
+    private:
+        const unsigned char* data;
+        size_t size, pos = 0;
+
+    public:
+        Unpacker(const unsigned char* data, size_t size) : data(data), size(size) {}
+
+        template<typename T>
+        T get() {
+            T value;
+            get_bytes(&value, sizeof(T));
+            return value;
+        }
+
+        void get_bytes(void* out, size_t n) {
+            if (pos + n > size)
+                throw std::runtime_error("truncated message");
+            std::memcpy(out, data + pos, n);
+            pos += n;
+        }
+    };
+
+    struct Job {
+        uint32_t tile = 0;
+        int width = 0, height = 0;
+        Tile rect = {0, 0, 0, 0};
+        bool subdivide = false;
+        FractalParams params;
+    };
+
+    std::vector<unsigned char> pack_job(const Job& job) {
+        Packer packer(Message::Job);
+        packer.put(job.tile);
+        packer.put(int32_t(job.width));
+        packer.put(int32_t(job.height));
+        for (int v: {job.rect.x0, job.rect.y0, job.rect.x1, job.rect.y1})
+            packer.put(int32_t(v));
+        packer.put(uint8_t(job.subdivide));
+
+        const FractalParams& p = job.params;
+        packer.put(p.translation[0]);
+        packer.put(p.translation[1]);
+        packer.put(p.scale);
+        packer.put(p.aspect_ratio);
+        packer.put(p.cvec[0]);
+        packer.put(p.cvec[1]);
+        packer.put(p.R);
+        packer.put(int32_t(p.num_it));
+        packer.put(uint8_t(p.periodicity));
+        packer.put(uint8_t(p.precision));
+        packer.put(uint8_t(p.variant.power));
+        packer.put(uint8_t(p.variant.metric));
+        packer.put(uint8_t(p.variant.coloring));
+        return packer.finish();
+    }
+
+    Job unpack_job(Unpacker& in) {
+        Job job;
+        job.tile = in.get<uint32_t>();
+        job.width = in.get<int32_t>();
+        job.height = in.get<int32_t>();
+        job.rect.x0 = in.get<int32_t>();
+        job.rect.y0 = in.get<int32_t>();
+        job.rect.x1 = in.get<int32_t>();
+        job.rect.y1 = in.get<int32_t>();
+        job.subdivide = in.get<uint8_t>() != 0;
+
+        FractalParams& p = job.params;
+        p.translation[0] = in.get<double>();
+        p.translation[1] = in.get<double>();
+        p.scale = in.get<double>();
+        p.aspect_ratio = in.get<float>();
+        p.cvec[0] = in.get<float>();
+        p.cvec[1] = in.get<float>();
+        p.R = in.get<float>();
+        p.num_it = in.get<int32_t>();
+        p.periodicity = in.get<uint8_t>() != 0;
+        p.precision = Precision(in.get<uint8_t>());
+        p.variant.power = in.get<uint8_t>();
+        p.variant.metric = EscapeMetric(in.get<uint8_t>());
+        p.variant.coloring = Coloring(in.get<uint8_t>());
+        return job;
+    }
+
+#ifndef _WIN32
+    bool write_all(int fd, const std::vector<unsigned char>& bytes) {
+        size_t done = 0;
+        while (done < bytes.size()) {
+            ssize_t n = ::write(fd, bytes.data() + done, bytes.size() - done);
+            if (n < 0 and errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            done += size_t(n);
+        }
+        return true;
+    }
+
+    bool read_all(int fd, void* out, size_t size) {
+        unsigned char* p = static_cast<unsigned char*>(out);
+        size_t done = 0;
+        while (done < size) {
+            ssize_t n = ::read(fd, p + done, size - done);
+            if (n < 0 and errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            done += size_t(n);
+        }
+        return true;
+    }
+
+    // type and payload of the next message, false when the peer is gone
+    bool read_message(int fd, Message& type, std::vector<unsigned char>& payload) {
+        uint32_t header[3];
+        if (not read_all(fd, header, HEADER_BYTES))
+            return false;
+        if (header[0] != PROTOCOL_MAGIC)
+            throw std::runtime_error("not a tile protocol peer");
+
+        type = Message(header[1]);
+        payload.resize(header[2]);
+        return read_all(fd, payload.data(), payload.size());
+    }
+
+    struct Connection {
+        int fd = -1;
+        pid_t pid = -1;             // local workers only
+        size_t stats = 0;           // index into DistributedStats::workers
+        std::deque<uint32_t> jobs;  // sent and not answered yet
+        std::vector<unsigned char> input;
+        bool alive = true;
+    };
+
+    int listen_tcp(int port) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            throw std::runtime_error("socket failed");
+
+        int yes = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+        sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(uint16_t(port));
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 or listen(fd, 16) != 0) {
+            close(fd);
+            throw std::runtime_error(fmt::format("cannot listen on port {}", port));
+        }
+        return fd;
+    }
+
+    // this executable with --worker-fd on the other end of a socketpair
+    Connection spawn_worker(const std::string& executable, CpuKernel kernel) {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0)
+            throw std::runtime_error("socketpair failed");
+
+        pid_t pid = fork();
+        if (pid < 0)
+            throw std::runtime_error("fork failed");
+
+        if (pid == 0) {
+            // only the worker's own end survives exec
+            fcntl(sv[1], F_SETFD, 0);
+            std::string fd = std::to_string(sv[1]);
+            execl("/proc/self/exe", executable.c_str(), "--worker-fd", fd.c_str(), "--kernel", kernel_name(kernel),
+                  static_cast<char*>(nullptr));
+            execlp(executable.c_str(), executable.c_str(), "--worker-fd", fd.c_str(), "--kernel", kernel_name(kernel),
+                   static_cast<char*>(nullptr));
+            _exit(127);
+        }
+
+        close(sv[1]);
+        Connection connection;
+        connection.fd = sv[0];
+        connection.pid = pid;
+        return connection;
+    }
+#endif
+}
+
+#ifdef _WIN32
+
+DistributedStats render_distributed(const FractalParams&, int, int, const TiledRenderOptions&,
+                                    const DistributedOptions&, const std::string&,
+                                    const Gradient&, std::vector<unsigned char>&) {
+    throw std::runtime_error("worker processes need POSIX sockets");
+}
+
+int run_worker(int, CpuKernel) {
+    throw std::runtime_error("worker processes need POSIX sockets");
+}
+
+int run_remote_worker(const std::string&, CpuKernel) {
+    throw std::runtime_error("worker processes need POSIX sockets");
+}
+
+#else
+
+DistributedStats render_distributed(const FractalParams& params, int width, int height,
+                                    const TiledRenderOptions& options, const DistributedOptions& distributed,
+                                    const std::string& executable,
+                                    const Gradient& gradient, std::vector<unsigned char>& rgb) {
+    if (options.antialias > 1)
+        throw std::runtime_error("antialiasing is not distributed");
+
+    // a dead worker shows as a failed write otherwise
+    signal(SIGPIPE, SIG_IGN);
+
+    const std::vector<Tile> tiles = make_tiles(width, height, options.tile_size);
+    const int num_it = max_value(params);
+    rgb.resize(size_t(width) * height * 3);
+
+    DistributedStats stats;
+    stats.tiles = int(tiles.size());
+
+    std::deque<uint32_t> pending;
+    for (uint32_t t = 0; t < tiles.size(); ++t)
+        pending.push_back(t);
+
+    std::vector<Connection> connections;
+    auto add_connection = [&](Connection connection, const std::string& name) {
+        connection.stats = stats.workers.size();
+        stats.workers.emplace_back();
+        stats.workers.back().name = name;
+        connections.push_back(std::move(connection));
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (int w = 0; w < distributed.workers; ++w) {
+        Connection connection = spawn_worker(executable, options.kernel);
+        std::string name = fmt::format("pid {}", connection.pid);
+        add_connection(std::move(connection), name);
+    }
+    const int listener = distributed.listen_port > 0 ? listen_tcp(distributed.listen_port) : -1;
+
+    // its unanswered tiles go back to the front of the queue
+    auto drop = [&](Connection& connection) {
+        if (not connection.alive)
+            return;
+        connection.alive = false;
+        close(connection.fd);
+        if (connection.pid > 0) {
+            kill(connection.pid, SIGKILL);
+            waitpid(connection.pid, nullptr, 0);
+        }
+
+        DistributedWorkerStats& worker = stats.workers[connection.stats];
+        worker.died = true;
+        worker.requeued = int(connection.jobs.size());
+        for (auto it = connection.jobs.rbegin(); it != connection.jobs.rend(); ++it)
+            pending.push_front(*it);
+        connection.jobs.clear();
+        std::cerr << fmt::format("worker {} is gone, {} tiles requeued\n", worker.name, worker.requeued);
+    };
+
+    // tile, pixel-iterations and seconds before the values of a result
+    const size_t result_fields = sizeof(uint32_t) + sizeof(uint64_t) + sizeof(double);
+    size_t max_payload = result_fields;
+    for (const Tile& tile: tiles)
+        max_payload = std::max(max_payload, result_fields + sizeof(int) * size_t(tile.x1 - tile.x0) * (tile.y1 - tile.y0));
+
+    // false for a result the peer was not asked for or of the wrong size, the peer is
+    // dropped then like a dead one
+    auto handle_result = [&](Connection& connection, const unsigned char* payload, size_t size) {
+        Unpacker in(payload, size);
+        if (size < sizeof(uint32_t))
+            return false;
+        uint32_t t = in.get<uint32_t>();
+        auto job = std::find(connection.jobs.begin(), connection.jobs.end(), t);
+        if (job == connection.jobs.end()) {
+            std::cerr << fmt::format("worker {} sent a result for tile {}, which it was not given\n",
+                                     stats.workers[connection.stats].name, t);
+            return false;
+        }
+
+        const Tile& tile = tiles[t];
+        const int tw = tile.x1 - tile.x0, th = tile.y1 - tile.y0;
+        if (size != result_fields + sizeof(int) * size_t(tw) * th) {
+            std::cerr << fmt::format("worker {} sent {} bytes for tile {}\n", stats.workers[connection.stats].name, size, t);
+            return false;
+        }
+        connection.jobs.erase(job);
+
+        uint64_t iterations = in.get<uint64_t>();
+        double seconds = in.get<double>();
+        std::vector<int> values(size_t(tw) * th);
+        in.get_bytes(values.data(), values.size() * sizeof(int));
+
+        for (int y = 0; y < th; ++y)
+            colorize(values.data() + size_t(y) * tw, tw, num_it, gradient,
+                     rgb.data() + (size_t(tile.y0 + y) * width + tile.x0) * 3);
+
+        DistributedWorkerStats& worker = stats.workers[connection.stats];
+        worker.tiles += 1;
+        worker.pixels += int64_t(tw) * th;
+        worker.iterations += iterations;
+        worker.busy_seconds += seconds;
+        stats.total.iterations += iterations;
+
+        if (distributed.kill_worker_after > 0 and connection.stats == 0 and worker.tiles == distributed.kill_worker_after
+            and connection.pid > 0)
+            kill(connection.pid, SIGKILL);
+        return true;
+    };
+
+    int done = 0;
+    while (done < stats.tiles) {
+        for (Connection& connection: connections)
+            while (connection.alive and int(connection.jobs.size()) < distributed.jobs_in_flight and not pending.empty()) {
+                Job job;
+                job.tile = pending.front();
+                job.width = width, job.height = height;
+                job.rect = tiles[job.tile];
+                job.subdivide = options.subdivide;
+                job.params = params;
+
+                connection.jobs.push_back(job.tile);
+                pending.pop_front();
+                if (not write_all(connection.fd, pack_job(job)))
+                    drop(connection);
+            }
+
+        std::vector<pollfd> fds;
+        std::vector<Connection*> polled;
+        for (Connection& connection: connections)
+            if (connection.alive) {
+                fds.push_back(pollfd {connection.fd, POLLIN, 0});
+                polled.push_back(&connection);
+            }
+        if (fds.empty() and listener < 0)
+            throw std::runtime_error(fmt::format("all workers are gone, {} tiles left", stats.tiles - done));
+        if (listener >= 0)
+            fds.push_back(pollfd {listener, POLLIN, 0});
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            throw std::runtime_error("poll failed");
+        }
+
+        for (size_t i = 0; i < polled.size(); ++i) {
+            if (not (fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+
+            Connection& connection = *polled[i];
+            unsigned char buffer[1 << 16];
+            ssize_t n = ::read(connection.fd, buffer, sizeof(buffer));
+            if (n < 0 and errno == EINTR)
+                continue;
+            if (n <= 0) {
+                drop(connection);
+                continue;
+            }
+            connection.input.insert(connection.input.end(), buffer, buffer + n);
+
+            // every complete message in the buffer
+            size_t used = 0;
+            while (connection.alive and connection.input.size() - used >= HEADER_BYTES) {
+                uint32_t header[3];
+                std::memcpy(header, connection.input.data() + used, HEADER_BYTES);
+                // a longer message never completes, the buffer would grow without end
+                if (header[0] != PROTOCOL_MAGIC or header[2] > max_payload) {
+                    drop(connection);
+                    break;
+                }
+                if (connection.input.size() - used < HEADER_BYTES + header[2])
+                    break;
+
+                const unsigned char* payload = connection.input.data() + used + HEADER_BYTES;
+                if (Message(header[1]) == Message::Hello and connection.pid < 0 and header[2] >= sizeof(uint32_t)) {
+                    Unpacker in(payload, header[2]);
+                    stats.workers[connection.stats].name += fmt::format(" pid {}", in.get<uint32_t>());
+                } else if (Message(header[1]) == Message::Result) {
+                    if (not handle_result(connection, payload, header[2])) {
+                        drop(connection);
+                        break;
+                    }
+                    done += 1;
+                }
+                used += HEADER_BYTES + header[2];
+            }
+            if (connection.alive)
+                connection.input.erase(connection.input.begin(), connection.input.begin() + used);
+        }
+
+        if (listener >= 0 and (fds.back().revents & POLLIN)) {
+            sockaddr_storage addr;
+            socklen_t length = sizeof(addr);
+            int fd = accept4(listener, reinterpret_cast<sockaddr*>(&addr), &length, SOCK_CLOEXEC);
+            if (fd >= 0) {
+                char host[NI_MAXHOST], port[NI_MAXSERV];
+                getnameinfo(reinterpret_cast<sockaddr*>(&addr), length, host, sizeof(host), port, sizeof(port),
+                            NI_NUMERICHOST | NI_NUMERICSERV);
+                Connection connection;
+                connection.fd = fd;
+                add_connection(std::move(connection), fmt::format("{}:{}", host, port));
+            }
+        }
+    }
+
+    Packer quit(Message::Quit);
+    for (Connection& connection: connections)
+        if (connection.alive) {
+            write_all(connection.fd, quit.finish());
+            close(connection.fd);
+            if (connection.pid > 0)
+                waitpid(connection.pid, nullptr, 0);
+        }
+    if (listener >= 0)
+        close(listener);
+
+    stats.total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+int run_worker(int fd, CpuKernel kernel) {
+    Packer hello(Message::Hello);
+    hello.put(uint32_t(getpid()));
+    if (not write_all(fd, hello.finish()))
+        return 1;
+
+    Message type;
+    std::vector<unsigned char> payload;
+    std::vector<int> values;
+
+    while (read_message(fd, type, payload)) {
+        if (type == Message::Quit)
+            break;
+        if (type != Message::Job)
+            continue;
+
+        Unpacker in(payload.data(), payload.size());
+        Job job = unpack_job(in);
+        const Tile& tile = job.rect;
+        const int tw = tile.x1 - tile.x0;
+        values.resize(size_t(tw) * (tile.y1 - tile.y0));
+
+        auto start = std::chrono::steady_clock::now();
+        uint64_t iterations;
+        if (job.subdivide) {
+            auto iterate = [&](const int* xs, const int* ys, int n, int* out) {
+                return iterate_pixels(job.params, job.width, job.height, xs, ys, n, out, kernel);
+            };
+            iterations = iterate_subdivided(iterate, tile, values.data(), tw);
+        } else {
+            iterations = iterate_region(job.params, job.width, job.height, tile.x0, tile.y0, tile.x1, tile.y1,
+                                        values.data(), tw, kernel);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        Packer result(Message::Result);
+        result.put(job.tile);
+        result.put(iterations);
+        result.put(seconds);
+        result.put_bytes(values.data(), values.size() * sizeof(int));
+        if (not write_all(fd, result.finish()))
+            break;
+    }
+
+    close(fd);
+    return 0;
+}
+
+int run_remote_worker(const std::string& address, CpuKernel kernel) {
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos)
+        throw std::runtime_error("expected <host>:<port>, got " + address);
+    std::string host = address.substr(0, colon), port = address.substr(colon + 1);
+
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* found = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &found) != 0)
+        throw std::runtime_error("cannot resolve " + address);
+
+    int fd = -1;
+    for (addrinfo* a = found; a and fd < 0; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd >= 0 and connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(found);
+    if (fd < 0)
+        throw std::runtime_error("cannot connect to " + address);
+
+    signal(SIGPIPE, SIG_IGN);
+    return run_worker(fd, kernel);
+}
+
+#endif
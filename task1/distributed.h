@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "fractal_cpu.h"
+#include "tile_render.h"
+
+// Tile rendering spread over worker processes. The coordinator sends tile jobs over a
+// stream socket and gets raw iteration values back, colors them and keeps the image.
+// Local workers are this executable started with --worker-fd on one end of a
+// socketpair, remote ones connect over TCP with --worker <host>:<port> to a
+// coordinator started with --listen <port>. Messages are little endian, so all
+// machines have to be. POSIX only.
+
+struct DistributedOptions {
+    int workers = 2;        // local worker processes
+    int listen_port = 0;    // also accept remote workers on this TCP port, 0 is off
+    int jobs_in_flight = 2; // per worker, so that it does not wait for its next tile
+    int kill_worker_after = 0;  // SIGKILL the first local worker after this many tiles (testing), 0 is off
+};
+
+struct DistributedWorkerStats {
+    std::string name;  // pid of a local worker or the address of a remote one
+    int tiles = 0;
+    int64_t pixels = 0;
+    uint64_t iterations = 0;
+    double busy_seconds = 0;  // as measured by the worker
+    bool died = false;
+    int requeued = 0;         // its tiles handed to other workers after it died
+};
+
+struct DistributedStats {
+    CpuRenderStats total;
+    int tiles = 0;
+    std::vector<DistributedWorkerStats> workers;
+};
+
+// Renders width x height with tiles of options.tile_size into rgb, subdivision as in
+// render_tiled, no antialiasing. The tiles of a worker that dies go back to the queue.
+// executable is what local workers run. Throws if every worker is gone.
+DistributedStats render_distributed(const FractalParams& params, int width, int height,
+                                    const TiledRenderOptions& options, const DistributedOptions& distributed,
+                                    const std::string& executable,
+                                    const Gradient& gradient, std::vector<unsigned char>& rgb);
+
+// Worker side: answers jobs on fd until the coordinator says quit or goes away.
+int run_worker(int fd, CpuKernel kernel);
+
+// connects to a --listen coordinator at "host:port", then run_worker
+int run_remote_worker(const std::string& address, CpuKernel kernel);
@@ -0,0 +1,861 @@
+#include "fractal_cpu.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRACTAL_HAVE_SSE 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define FRACTAL_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+#include "stb_image.h"
+
+namespace
+{
+    // background, see glClearColor in OpenGL::main_loop
+    const float color_background[3] = {0.30f, 0.55f, 0.60f};
+
+    // Double-float arithmetic, the same functions as in frac-shader-df.fs. Needs strict
+    // float evaluation: no fma contraction, no reassociation, no x87 excess precision.
+    struct DoubleFloat {
+        float hi, lo;
+    };
+
+    DoubleFloat two_sum(float a, float b) {
+        float s = a + b;
+        float v = s - a;
+        return DoubleFloat {s, (a - (s - v)) + (b - v)};
+    }
+
+    // |a| >= |b|
+    DoubleFloat quick_two_sum(float a, float b) {
+        float s = a + b;
+        return DoubleFloat {s, b - (s - a)};
+    }
+
+    // Dekker, a = hi + lo with 12 bit halves
+    DoubleFloat split(float a) {
+        float t = a * 4097.0f;
+        float hi = t - (t - a);
+        return DoubleFloat {hi, a - hi};
+    }
+
+    DoubleFloat two_prod(float a, float b) {
+        float p = a * b;
+        DoubleFloat as = split(a), bs = split(b);
+        return DoubleFloat {p, ((as.hi * bs.hi - p) + as.hi * bs.lo + as.lo * bs.hi) + as.lo * bs.lo};
+    }
+
+    DoubleFloat df_add(DoubleFloat a, DoubleFloat b) {
+        DoubleFloat s = two_sum(a.hi, b.hi);
+        return quick_two_sum(s.hi, s.lo + (a.lo + b.lo));
+    }
+
+    DoubleFloat df_sub(DoubleFloat a, DoubleFloat b) {
+        return df_add(a, DoubleFloat {-b.hi, -b.lo});
+    }
+
+    DoubleFloat df_mul(DoubleFloat a, DoubleFloat b) {
+        DoubleFloat p = two_prod(a.hi, b.hi);
+        return quick_two_sum(p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+    }
+
+    bool df_le(DoubleFloat a, float b) {
+        return a.hi < b or (a.hi == b and a.lo <= 0);
+    }
+
+    DoubleFloat to_double_float(double v) {
+        float hi = float(v);
+        return DoubleFloat {hi, float(v - hi)};
+    }
+
+    // pixel centers -> world coordinates, inverse of frac-shader.vs. Float rounds the view
+    // to float first, as the shader gets float uniforms.
+    float world_x(const FractalParams& params, int width, int x, float) {
+        return ((2 * x + 1) / float(width) - 1) / float(params.scale) + float(params.translation[0]);
+    }
+
+    float world_y(const FractalParams& params, int height, int y, float) {
+        return (1 - (2 * y + 1) / float(height)) * params.aspect_ratio / float(params.scale) + float(params.translation[1]);
+    }
+
+    double world_x(const FractalParams& params, int width, int x, double) {
+        return ((2 * x + 1) / double(width) - 1) / params.scale + params.translation[0];
+    }
+
+    double world_y(const FractalParams& params, int height, int y, double) {
+        return (1 - (2 * y + 1) / double(height)) * double(params.aspect_ratio) / params.scale + params.translation[1];
+    }
+
+    // the offset from the center is small, float is enough for it
+    DoubleFloat world_x(const FractalParams& params, int width, int x, DoubleFloat) {
+        float offset = ((2 * x + 1) / float(width) - 1) / float(params.scale);
+        return df_add(to_double_float(params.translation[0]), DoubleFloat {offset, 0});
+    }
+
+    DoubleFloat world_y(const FractalParams& params, int height, int y, DoubleFloat) {
+        float offset = (1 - (2 * y + 1) / float(height)) * params.aspect_ratio / float(params.scale);
+        return df_add(to_double_float(params.translation[1]), DoubleFloat {offset, 0});
+    }
+
+    template <typename T>
+    void pixel_columns(const FractalParams& params, int width, int x0, int x1, std::vector<T>& wx) {
+        wx.resize(x1 - x0);
+        for (int x = x0; x < x1; ++x)
+            wx[x - x0] = world_x(params, width, x, T());
+    }
+
+    template <typename T>
+    T pixel_y(const FractalParams& params, int height, int y) {
+        return world_y(params, height, y, T());
+    }
+
+    // arithmetic of the kernels below on plain float or double, see SseOps for simd
+    template <typename T>
+    struct ScalarOps {
+        typedef T F;
+
+        static F add(F a, F b) { return a + b; }
+        static F sub(F a, F b) { return a - b; }
+        static F mul(F a, F b) { return a * b; }
+        static F abs(F a) { return std::abs(a); }
+        static F max(F a, F b) { return std::max(a, b); }
+        static bool le(F a, F b) { return a <= b; }
+    };
+
+    // p = p * z, the expressions kernel_glsl emits
+    template <typename O>
+    void multiply(typename O::F& px, typename O::F& py, typename O::F zx, typename O::F zy) {
+        typename O::F nx = O::sub(O::mul(px, zx), O::mul(py, zy));
+        py = O::add(O::mul(px, zy), O::mul(py, zx));
+        px = nx;
+    }
+
+    template <int K>
+    struct MultiplyBy {
+        template <typename O>
+        static void apply(typename O::F& px, typename O::F& py, typename O::F zx, typename O::F zy) {
+            MultiplyBy<K - 1>::template apply<O>(px, py, zx, zy);
+            multiply<O>(px, py, zx, zy);
+        }
+    };
+
+    template <>
+    struct MultiplyBy<0> {
+        template <typename O>
+        static void apply(typename O::F&, typename O::F&, typename O::F, typename O::F) {}
+    };
+
+    // A KernelVariant fixed at compile time: z^N is unrolled and every branch on the
+    // metric and the coloring folds away.
+    template <int N, EscapeMetric M, Coloring C>
+    struct StaticVariant {
+        explicit StaticVariant(const KernelVariant&) {}
+
+        EscapeMetric metric() const { return M; }
+        Coloring coloring() const { return C; }
+
+        template <typename O>
+        void power(typename O::F& zx, typename O::F& zy) const {
+            typename O::F px = zx, py = zy;
+            MultiplyBy<N - 1>::template apply<O>(px, py, zx, zy);
+            zx = px, zy = py;
+        }
+    };
+
+    // the generic kernel: the same loops with the variant read at run time
+    struct RuntimeVariant {
+        KernelVariant variant;
+
+        explicit RuntimeVariant(const KernelVariant& variant) : variant(variant) {}
+
+        EscapeMetric metric() const { return variant.metric; }
+        Coloring coloring() const { return variant.coloring; }
+
+        template <typename O>
+        void power(typename O::F& zx, typename O::F& zy) const {
+            typename O::F px = zx, py = zy;
+            for (int k = 1; k < variant.power; ++k)
+                multiply<O>(px, py, zx, zy);
+            zx = px, zy = py;
+        }
+    };
+
+    // |z| <= r in the metric of the variant, r2 = r * r. A bool or a mask of simd lanes.
+    template <typename O, typename Var>
+    auto captured(const Var& var, typename O::F zx, typename O::F zy, typename O::F r, typename O::F r2)
+        -> decltype(O::le(r, r)) {
+        switch (var.metric()) {
+        case EscapeMetric::Manhattan:
+            return O::le(O::add(O::abs(zx), O::abs(zy)), r);
+        case EscapeMetric::Chebyshev:
+            return O::le(O::max(O::abs(zx), O::abs(zy)), r);
+        default:
+            return O::le(O::add(O::mul(zx, zx), O::mul(zy, zy)), r2);
+        }
+    }
+
+    template <typename Var, typename T>
+    int captured_value(const Var& var, int i, T zy) {
+        return var.coloring() == Coloring::Decomposition ? 2 * i - (zy >= 0 ? 1 : 0) : i;
+    }
+
+    // float or double, bailout2 = 0 turns periodicity off
+    template <typename T, typename Var>
+    int iterate_point(const Var& var, T x, T y, T cx, T cy, T r, T r2, int num_it, T bailout2) {
+        typedef ScalarOps<T> O;
+
+        // cur = f_c(coordinates)
+        T zx = x, zy = y;
+        var.template power<O>(zx, zy);
+        zx += cx, zy += cy;
+
+        const T eps2 = PERIODICITY_EPS * PERIODICITY_EPS;
+        T sx = 1e10f, sy = 1e10f;
+        int next_save = 1;
+
+        for (int i = 1; i <= num_it; ++i) {
+            if (captured<O>(var, zx, zy, r, r2))
+                return captured_value(var, i, zy);
+
+            if (bailout2 > 0) {
+                T len2 = zx * zx + zy * zy;
+                T dx = zx - sx, dy = zy - sy;
+                if (dx * dx + dy * dy <= eps2 or bailout2 <= len2)
+                    return ITER_NEVER;
+
+                if (i == next_save) {
+                    sx = zx, sy = zy;
+                    next_save *= 2;
+                }
+            }
+
+            var.template power<O>(zx, zy);
+            zx += cx, zy += cy;
+        }
+
+        return ITER_NEVER;
+    }
+
+    // the loop of frac-shader-df.fs, the periodicity check looks at the high parts only
+    int iterate_point(DoubleFloat x, DoubleFloat y, float cx, float cy, float r2, int num_it, float bailout2) {
+        const DoubleFloat c[2] = {{cx, 0}, {cy, 0}};
+
+        DoubleFloat zx = df_add(df_sub(df_mul(x, x), df_mul(y, y)), c[0]);
+        DoubleFloat zy = df_mul(x, y);
+        zy = df_add(DoubleFloat {2 * zy.hi, 2 * zy.lo}, c[1]);
+
+        const float eps2 = PERIODICITY_EPS * PERIODICITY_EPS;
+        float sx = 1e10f, sy = 1e10f;
+        int next_save = 1;
+
+        for (int i = 1; i <= num_it; ++i) {
+            DoubleFloat xx = df_mul(zx, zx), yy = df_mul(zy, zy);
+            DoubleFloat len2 = df_add(xx, yy);
+            if (df_le(len2, r2))
+                return i;
+
+            if (bailout2 > 0) {
+                float dx = zx.hi - sx, dy = zy.hi - sy;
+                if (dx * dx + dy * dy <= eps2 or bailout2 <= len2.hi)
+                    return ITER_NEVER;
+
+                if (i == next_save) {
+                    sx = zx.hi, sy = zy.hi;
+                    next_save *= 2;
+                }
+            }
+
+            DoubleFloat xy = df_mul(zx, zy);
+            zx = df_add(df_sub(xx, yy), c[0]);
+            zy = df_add(DoubleFloat {2 * xy.hi, 2 * xy.lo}, c[1]);
+        }
+
+        return ITER_NEVER;
+    }
+
+    bool outside_quad(float x, float y) {
+        return std::abs(x) > 1 or std::abs(y) > 1;
+    }
+
+    bool outside_quad(double x, double y) {
+        return std::abs(x) > 1 or std::abs(y) > 1;
+    }
+
+    bool outside_quad(DoubleFloat x, DoubleFloat y) {
+        return std::abs(x.hi) > 1 or std::abs(y.hi) > 1;
+    }
+
+    // spans are arbitrary pixel lists, (wx[i], wy[i]) in world coordinates.
+    // r2 and the bailout are float products in the shaders as well.
+    template <typename T, typename Var>
+    void iterate_span_scalar(const T* wx, const T* wy, int n, const FractalParams& params, int* out) {
+        const Var var(params.variant);
+        const float r2 = params.R * params.R;
+        const float bailout2 = params.periodicity ? orbit_bailout(params) * orbit_bailout(params) : 0;
+
+        for (int i = 0; i < n; ++i) {
+            if (outside_quad(wx[i], wy[i]))
+                out[i] = ITER_OUTSIDE;
+            else
+                out[i] = iterate_point(var, wx[i], wy[i], T(params.cvec[0]), T(params.cvec[1]), T(params.R), T(r2),
+                                       params.num_it, T(bailout2));
+        }
+    }
+
+    // z^2 only, iterate_region checks the variant
+    void iterate_span_scalar(const DoubleFloat* wx, const DoubleFloat* wy, int n, const FractalParams& params, int* out) {
+        const float r2 = params.R * params.R;
+        const float bailout2 = params.periodicity ? orbit_bailout(params) * orbit_bailout(params) : 0;
+
+        for (int i = 0; i < n; ++i) {
+            if (outside_quad(wx[i], wy[i]))
+                out[i] = ITER_OUTSIDE;
+            else
+                out[i] = iterate_point(wx[i], wy[i], params.cvec[0], params.cvec[1], r2, params.num_it, bailout2);
+        }
+    }
+
+#ifdef FRACTAL_HAVE_SSE
+    struct SseOps {
+        typedef float T;
+        typedef __m128 F;
+        static const int lanes = 4;
+
+        static F set1(float v) { return _mm_set1_ps(v); }
+        static F load(const float* p) { return _mm_loadu_ps(p); }
+        static F add(F a, F b) { return _mm_add_ps(a, b); }
+        static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+        static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+        static F abs(F a) { return bandnot(_mm_set1_ps(-0.0f), a); }
+        static F max(F a, F b) { return _mm_max_ps(a, b); }
+        static F le(F a, F b) { return _mm_cmple_ps(a, b); }
+        static F band(F a, F b) { return _mm_and_ps(a, b); }
+        static F bandnot(F a, F b) { return _mm_andnot_ps(a, b); } // ~a & b
+        static F bor(F a, F b) { return _mm_or_ps(a, b); }
+        static int any(F a) { return _mm_movemask_ps(a); }
+        static void store(int* p, F a) { _mm_storeu_si128((__m128i*)p, _mm_cvttps_epi32(a)); }
+    };
+
+    struct SseDoubleOps {
+        typedef double T;
+        typedef __m128d F;
+        static const int lanes = 2;
+
+        static F set1(double v) { return _mm_set1_pd(v); }
+        static F load(const double* p) { return _mm_loadu_pd(p); }
+        static F add(F a, F b) { return _mm_add_pd(a, b); }
+        static F sub(F a, F b) { return _mm_sub_pd(a, b); }
+        static F mul(F a, F b) { return _mm_mul_pd(a, b); }
+        static F abs(F a) { return bandnot(_mm_set1_pd(-0.0), a); }
+        static F max(F a, F b) { return _mm_max_pd(a, b); }
+        static F le(F a, F b) { return _mm_cmple_pd(a, b); }
+        static F band(F a, F b) { return _mm_and_pd(a, b); }
+        static F bandnot(F a, F b) { return _mm_andnot_pd(a, b); }
+        static F bor(F a, F b) { return _mm_or_pd(a, b); }
+        static int any(F a) { return _mm_movemask_pd(a); }
+        static void store(int* p, F a) { _mm_storel_epi64((__m128i*)p, _mm_cvttpd_epi32(a)); }
+    };
+#endif
+
+#ifdef FRACTAL_HAVE_AVX2
+    struct Avx2Ops {
+        typedef float T;
+        typedef __m256 F;
+        static const int lanes = 8;
+
+        static F set1(float v) { return _mm256_set1_ps(v); }
+        static F load(const float* p) { return _mm256_loadu_ps(p); }
+        static F add(F a, F b) { return _mm256_add_ps(a, b); }
+        static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+        static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+        static F abs(F a) { return bandnot(_mm256_set1_ps(-0.0f), a); }
+        static F max(F a, F b) { return _mm256_max_ps(a, b); }
+        static F le(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+        static F band(F a, F b) { return _mm256_and_ps(a, b); }
+        static F bandnot(F a, F b) { return _mm256_andnot_ps(a, b); }
+        static F bor(F a, F b) { return _mm256_or_ps(a, b); }
+        static int any(F a) { return _mm256_movemask_ps(a); }
+        static void store(int* p, F a) { _mm256_storeu_si256((__m256i*)p, _mm256_cvttps_epi32(a)); }
+    };
+
+    struct Avx2DoubleOps {
+        typedef double T;
+        typedef __m256d F;
+        static const int lanes = 4;
+
+        static F set1(double v) { return _mm256_set1_pd(v); }
+        static F load(const double* p) { return _mm256_loadu_pd(p); }
+        static F add(F a, F b) { return _mm256_add_pd(a, b); }
+        static F sub(F a, F b) { return _mm256_sub_pd(a, b); }
+        static F mul(F a, F b) { return _mm256_mul_pd(a, b); }
+        static F abs(F a) { return bandnot(_mm256_set1_pd(-0.0), a); }
+        static F max(F a, F b) { return _mm256_max_pd(a, b); }
+        static F le(F a, F b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+        static F band(F a, F b) { return _mm256_and_pd(a, b); }
+        static F bandnot(F a, F b) { return _mm256_andnot_pd(a, b); }
+        static F bor(F a, F b) { return _mm256_or_pd(a, b); }
+        static int any(F a) { return _mm256_movemask_pd(a); }
+        static void store(int* p, F a) { _mm_storeu_si128((__m128i*)p, _mm256_cvttpd_epi32(a)); }
+    };
+#endif
+
+    // Two registers are iterated side by side to hide the multiply latency,
+    // so one lane group is 8 pixels for SSE and 16 for AVX2 (4 and 8 in double).
+    template <typename V, typename Var>
+    void iterate_span_simd(const typename V::T* wx, const typename V::T* wy, int n, const FractalParams& params, int* out) {
+        typedef typename V::F F;
+        const int group = 2 * V::lanes;
+        const Var var(params.variant);
+
+        const F cx = V::set1(params.cvec[0]), cy = V::set1(params.cvec[1]);
+        const F r = V::set1(params.R), r2 = V::set1(params.R * params.R);
+        const F zero = V::set1(0), one = V::set1(1), sign = V::set1(-0.0f), outside = V::set1(float(ITER_OUTSIDE));
+
+        const bool periodicity = params.periodicity;
+        const F bailout2 = V::set1(orbit_bailout(params) * orbit_bailout(params));
+        const F eps2 = V::set1(PERIODICITY_EPS * PERIODICITY_EPS);
+
+        int i = 0;
+        for (; i + group <= n; i += group) {
+            F zx[2], zy[2], res[2], active[2];
+            F sx[2] = {V::set1(1e10f), V::set1(1e10f)}, sy[2] = {V::set1(1e10f), V::set1(1e10f)};
+            int next_save = 1;
+
+            for (int k = 0; k < 2; ++k) {
+                F x = V::load(wx + i + k * V::lanes);
+                F y = V::load(wy + i + k * V::lanes);
+
+                active[k] = V::band(V::le(V::bandnot(sign, x), one), V::le(V::bandnot(sign, y), one));
+                res[k] = V::bandnot(active[k], outside);
+
+                zx[k] = x, zy[k] = y;
+                var.template power<V>(zx[k], zy[k]);
+                zx[k] = V::add(zx[k], cx);
+                zy[k] = V::add(zy[k], cy);
+            }
+
+            for (int it = 1; it <= params.num_it; ++it) {
+                const F itv = V::set1(float(it)), itv2 = V::set1(float(2 * it));
+
+                for (int k = 0; k < 2; ++k) {
+                    F hit = V::band(captured<V>(var, zx[k], zy[k], r, r2), active[k]);
+                    F value = itv;
+                    if (var.coloring() == Coloring::Decomposition)
+                        value = V::sub(itv2, V::band(V::le(zero, zy[k]), one));
+
+                    res[k] = V::bor(V::bandnot(hit, res[k]), V::band(hit, value));
+                    active[k] = V::bandnot(hit, active[k]);
+
+                    // stopped lanes keep res = ITER_NEVER
+                    if (periodicity) {
+                        F len2 = V::add(V::mul(zx[k], zx[k]), V::mul(zy[k], zy[k]));
+                        F dx = V::sub(zx[k], sx[k]), dy = V::sub(zy[k], sy[k]);
+                        F stuck = V::bor(V::le(V::add(V::mul(dx, dx), V::mul(dy, dy)), eps2), V::le(bailout2, len2));
+                        active[k] = V::bandnot(stuck, active[k]);
+                    }
+                }
+
+                if (periodicity and it == next_save) {
+                    for (int k = 0; k < 2; ++k)
+                        sx[k] = zx[k], sy[k] = zy[k];
+                    next_save *= 2;
+                }
+
+                if (not (V::any(active[0]) | V::any(active[1])))
+                    break;
+
+                for (int k = 0; k < 2; ++k) {
+                    var.template power<V>(zx[k], zy[k]);
+                    zx[k] = V::add(zx[k], cx);
+                    zy[k] = V::add(zy[k], cy);
+                }
+            }
+
+            V::store(out + i, res[0]);
+            V::store(out + i + V::lanes, res[1]);
+        }
+
+        iterate_span_scalar<typename V::T, Var>(wx + i, wy + i, n - i, params, out + i);
+    }
+
+    // a kernel (ScalarSpan or SimdSpan) for one variant
+    template <typename T>
+    struct ScalarSpan {
+        typedef T Real;
+
+        template <typename Var>
+        static void run(const T* wx, const T* wy, int n, const FractalParams& params, int* out) {
+            iterate_span_scalar<T, Var>(wx, wy, n, params, out);
+        }
+    };
+
+    template <typename V>
+    struct SimdSpan {
+        typedef typename V::T Real;
+
+        template <typename Var>
+        static void run(const Real* wx, const Real* wy, int n, const FractalParams& params, int* out) {
+            iterate_span_simd<V, Var>(wx, wy, n, params, out);
+        }
+    };
+
+    template <typename K>
+    using SpanFunction = void (*)(const typename K::Real*, const typename K::Real*, int, const FractalParams&, int*);
+
+    template <typename K, int N, EscapeMetric M>
+    SpanFunction<K> span_function(Coloring coloring) {
+        if (coloring == Coloring::Decomposition)
+            return &K::template run<StaticVariant<N, M, Coloring::Decomposition>>;
+        return &K::template run<StaticVariant<N, M, Coloring::Iterations>>;
+    }
+
+    template <typename K, int N>
+    SpanFunction<K> span_function(EscapeMetric metric, Coloring coloring) {
+        switch (metric) {
+        case EscapeMetric::Manhattan:
+            return span_function<K, N, EscapeMetric::Manhattan>(coloring);
+        case EscapeMetric::Chebyshev:
+            return span_function<K, N, EscapeMetric::Chebyshev>(coloring);
+        default:
+            return span_function<K, N, EscapeMetric::Euclidean>(coloring);
+        }
+    }
+
+    // instances for powers N .. MAX_POWER
+    template <typename K, int N>
+    struct PowerSpans {
+        static SpanFunction<K> find(const KernelVariant& variant) {
+            if (variant.power == N)
+                return span_function<K, N>(variant.metric, variant.coloring);
+            return PowerSpans<K, N + 1>::find(variant);
+        }
+    };
+
+    template <typename K>
+    struct PowerSpans<K, MAX_POWER + 1> {
+        static SpanFunction<K> find(const KernelVariant& variant) {
+            throw std::runtime_error("power " + std::to_string(variant.power) + " is not compiled in");
+        }
+    };
+
+    template <typename K>
+    void run_span(const typename K::Real* wx, const typename K::Real* wy, int n, const FractalParams& params, int* out,
+                  bool specialized) {
+        SpanFunction<K> fn = specialized ? PowerSpans<K, MIN_POWER>::find(params.variant) : &K::template run<RuntimeVariant>;
+        fn(wx, wy, n, params, out);
+    }
+
+    void iterate_span(const float* wx, const float* wy, int n, const FractalParams& params, int* out,
+                      CpuKernel kernel, bool specialized) {
+        switch (kernel) {
+        case CpuKernel::Scalar:
+            run_span<ScalarSpan<float>>(wx, wy, n, params, out, specialized);
+            break;
+#ifdef FRACTAL_HAVE_SSE
+        case CpuKernel::SSE:
+            run_span<SimdSpan<SseOps>>(wx, wy, n, params, out, specialized);
+            break;
+#endif
+#ifdef FRACTAL_HAVE_AVX2
+        case CpuKernel::AVX2:
+            run_span<SimdSpan<Avx2Ops>>(wx, wy, n, params, out, specialized);
+            break;
+#endif
+        default:
+            break;
+        }
+    }
+
+    void iterate_span(const double* wx, const double* wy, int n, const FractalParams& params, int* out,
+                      CpuKernel kernel, bool specialized) {
+        switch (kernel) {
+        case CpuKernel::Scalar:
+            run_span<ScalarSpan<double>>(wx, wy, n, params, out, specialized);
+            break;
+#ifdef FRACTAL_HAVE_SSE
+        case CpuKernel::SSE:
+            run_span<SimdSpan<SseDoubleOps>>(wx, wy, n, params, out, specialized);
+            break;
+#endif
+#ifdef FRACTAL_HAVE_AVX2
+        case CpuKernel::AVX2:
+            run_span<SimdSpan<Avx2DoubleOps>>(wx, wy, n, params, out, specialized);
+            break;
+#endif
+        default:
+            break;
+        }
+    }
+
+    void iterate_span(const DoubleFloat* wx, const DoubleFloat* wy, int n, const FractalParams& params, int* out,
+                      CpuKernel, bool) {
+        iterate_span_scalar(wx, wy, n, params, out);
+    }
+
+    uint64_t count_iterations(const int* res, int n, const FractalParams& params) {
+        uint64_t iterations = 0;
+        for (int i = 0; i < n; ++i)
+            iterations += res[i] == ITER_NEVER ? params.num_it : std::max(iteration_of_value(params.variant, res[i]), 0);
+        return iterations;
+    }
+
+    // spans are at most this long, so that buffers stay small and narrow regions still fill the simd lanes
+    const int span_size = 1024;
+
+    // iterate_region in world coordinates of type T
+    template <typename T>
+    uint64_t iterate_region_as(const FractalParams& params, int width, int height,
+                               int x0, int y0, int x1, int y1,
+                               int* out, int stride, CpuKernel kernel, bool specialized) {
+        std::vector<T> columns;
+        pixel_columns(params, width, x0, x1, columns);
+
+        const int w = x1 - x0;
+        uint64_t iterations = 0;
+
+        // rows that fill the simd lanes well go straight to the output
+        if (w >= 64) {
+            std::vector<T> wy(w);
+
+            for (int y = y0; y < y1; ++y) {
+                int* row = out + size_t(y - y0) * stride;
+                std::fill(wy.begin(), wy.end(), pixel_y<T>(params, height, y));
+
+                iterate_span(columns.data(), wy.data(), w, params, row, kernel, specialized);
+                iterations += count_iterations(row, w, params);
+            }
+
+            return iterations;
+        }
+
+        // narrow regions (columns, small rectangles) are walked row by row in spans
+        const int64_t count = int64_t(std::max(w, 0)) * std::max(y1 - y0, 0);
+
+        const size_t buffer_size = size_t(std::min<int64_t>(span_size, count));
+        std::vector<T> wx(buffer_size), wy(buffer_size);
+        std::vector<int> res(buffer_size);
+
+        for (int64_t start = 0; start < count; start += span_size) {
+            const int n = int(std::min<int64_t>(span_size, count - start));
+
+            int x = int(start % w), y = y0 + int(start / w);
+            T row_y = pixel_y<T>(params, height, y);
+            for (int i = 0; i < n; ++i) {
+                wx[i] = columns[x];
+                wy[i] = row_y;
+
+                if (++x == w and i + 1 < n) {
+                    x = 0;
+                    row_y = pixel_y<T>(params, height, ++y);
+                }
+            }
+
+            iterate_span(wx.data(), wy.data(), n, params, res.data(), kernel, specialized);
+            iterations += count_iterations(res.data(), n, params);
+
+            for (int i = 0; i < n; ++i) {
+                int64_t p = start + i;
+                out[size_t(p / w) * stride + p % w] = res[i];
+            }
+        }
+
+        return iterations;
+    }
+
+    template <typename T>
+    uint64_t iterate_pixels_as(const FractalParams& params, int width, int height,
+                               const int* xs, const int* ys, int n, int* out, CpuKernel kernel, bool specialized) {
+        std::vector<T> wx(std::min(n, span_size)), wy(wx.size());
+
+        uint64_t iterations = 0;
+        for (int start = 0; start < n; start += span_size) {
+            const int m = std::min(span_size, n - start);
+
+            // same expressions as pixel_columns and pixel_y, so results match iterate_region
+            for (int i = 0; i < m; ++i) {
+                wx[i] = world_x(params, width, xs[start + i], T());
+                wy[i] = world_y(params, height, ys[start + i], T());
+            }
+
+            iterate_span(wx.data(), wy.data(), m, params, out + start, kernel, specialized);
+            iterations += count_iterations(out + start, m, params);
+        }
+
+        return iterations;
+    }
+
+    void check_variant(const FractalParams& params) {
+        if (params.precision == Precision::DoubleFloat and params.variant != KernelVariant())
+            throw std::runtime_error("double-float iterates the default z^2 euclidean iterations variant only");
+    }
+}
+
+const char* precision_name(Precision precision) {
+    switch (precision) {
+    case Precision::Float:
+        return "float";
+    case Precision::Double:
+        return "double";
+    case Precision::DoubleFloat:
+        return "double-float";
+    }
+    return "unknown";
+}
+
+Precision auto_precision(double scale, bool native_double) {
+    if (scale < FLOAT_SCALE_LIMIT)
+        return Precision::Float;
+    return native_double ? Precision::Double : Precision::DoubleFloat;
+}
+
+const char* kernel_name(CpuKernel kernel) {
+    switch (kernel) {
+    case CpuKernel::Scalar:
+        return "scalar";
+    case CpuKernel::SSE:
+        return "sse";
+    case CpuKernel::AVX2:
+        return "avx2";
+    }
+    return "unknown";
+}
+
+bool kernel_available(CpuKernel kernel) {
+    switch (kernel) {
+    case CpuKernel::Scalar:
+        return true;
+#ifdef FRACTAL_HAVE_SSE
+    case CpuKernel::SSE:
+        return true;
+#endif
+#ifdef FRACTAL_HAVE_AVX2
+    case CpuKernel::AVX2:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+int max_value(const FractalParams& params) {
+    return params.num_it * values_per_iteration(params.variant);
+}
+
+// |z|^n - |c| >= |z| once |z| >= |c| and |z|^(n - 1) >= 2
+float orbit_bailout(const FractalParams& params) {
+    float c = std::sqrt(params.cvec[0] * params.cvec[0] + params.cvec[1] * params.cvec[1]);
+    float grows = std::pow(2.0f, 1.0f / (params.variant.power - 1));
+    return std::max(std::max(grows, c), capture_radius(params.variant, params.R));
+}
+
+CpuKernel best_kernel() {
+    for (CpuKernel kernel: {CpuKernel::AVX2, CpuKernel::SSE})
+        if (kernel_available(kernel))
+            return kernel;
+    return CpuKernel::Scalar;
+}
+
+uint64_t iterate_region(const FractalParams& params, int width, int height,
+                        int x0, int y0, int x1, int y1,
+                        int* out, int stride, CpuKernel kernel, bool specialized) {
+    if (not kernel_available(kernel))
+        throw std::runtime_error(std::string("cpu kernel is not compiled in: ") + kernel_name(kernel));
+    check_variant(params);
+
+    switch (params.precision) {
+    case Precision::Double:
+        return iterate_region_as<double>(params, width, height, x0, y0, x1, y1, out, stride, kernel, specialized);
+    case Precision::DoubleFloat:
+        return iterate_region_as<DoubleFloat>(params, width, height, x0, y0, x1, y1, out, stride, kernel, specialized);
+    default:
+        return iterate_region_as<float>(params, width, height, x0, y0, x1, y1, out, stride, kernel, specialized);
+    }
+}
+
+uint64_t iterate_pixels(const FractalParams& params, int width, int height,
+                        const int* xs, const int* ys, int n, int* out, CpuKernel kernel, bool specialized) {
+    if (not kernel_available(kernel))
+        throw std::runtime_error(std::string("cpu kernel is not compiled in: ") + kernel_name(kernel));
+    check_variant(params);
+
+    switch (params.precision) {
+    case Precision::Double:
+        return iterate_pixels_as<double>(params, width, height, xs, ys, n, out, kernel, specialized);
+    case Precision::DoubleFloat:
+        return iterate_pixels_as<DoubleFloat>(params, width, height, xs, ys, n, out, kernel, specialized);
+    default:
+        return iterate_pixels_as<float>(params, width, height, xs, ys, n, out, kernel, specialized);
+    }
+}
+
+Gradient::Gradient(const char* path) {
+    stbi_set_flip_vertically_on_load(true);
+    int height, comps;
+
+    // stbi_loadf as in Texture, so that the same gamma is applied
+    float *data = stbi_loadf(path, &width, &height, &comps, 3);
+
+    if (not data)
+        throw std::runtime_error(std::string("failed to load ") + path);
+
+    texels.assign(data, data + 3 * width);
+    stbi_image_free(data);
+}
+
+void Gradient::sample(float u, float* rgb) const {
+    float s = u * width - 0.5f;
+    float fl = std::floor(s);
+    float w = s - fl;
+
+    int i0 = std::min(std::max(int(fl), 0), width - 1);
+    int i1 = std::min(std::max(int(fl) + 1, 0), width - 1);
+
+    for (int c = 0; c < 3; ++c)
+        rgb[c] = texels[3 * i0 + c] * (1 - w) + texels[3 * i1 + c] * w;
+}
+
+void sample_color(int value, int num_it, const Gradient& gradient, float* rgb) {
+    std::fill(rgb, rgb + 3, 0.0f);
+
+    if (value == ITER_OUTSIDE)
+        std::copy(color_background, color_background + 3, rgb);
+    else if (value != ITER_NEVER)
+        gradient.sample(num_it > 1 ? (value - 1) / float(num_it - 1) : 0, rgb);
+}
+
+unsigned char to_channel(float c) {
+    return (unsigned char)(std::min(std::max(c, 0.0f), 1.0f) * 255 + 0.5f);
+}
+
+void colorize(const int* iterations, int count, int num_it, const Gradient& gradient, unsigned char* rgb) {
+    for (int i = 0; i < count; ++i) {
+        float color[3];
+        sample_color(iterations[i], num_it, gradient, color);
+
+        for (int c = 0; c < 3; ++c)
+            rgb[3 * i + c] = to_channel(color[c]);
+    }
+}
+
+CpuRenderStats render_image(const FractalParams& params, int width, int height, CpuKernel kernel,
+                            const Gradient& gradient, std::vector<unsigned char>& rgb) {
+    std::vector<int> iterations(size_t(width) * height);
+    CpuRenderStats stats;
+
+    auto start = std::chrono::steady_clock::now();
+    stats.iterations = iterate_region(params, width, height, 0, 0, width, height, iterations.data(), width, kernel);
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    rgb.resize(iterations.size() * 3);
+    colorize(iterations.data(), int(iterations.size()), max_value(params), gradient, rgb.data());
+    return stats;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "kernel_variant.h"
+
+// CPU mirror of frac-shader.vs + frac-shader.fs, used where there is no GPU.
+
+// Arithmetic of the iteration loop, see frac-shader-fp64.fs and frac-shader-df.fs.
+enum class Precision {
+    Float,
+    Double,      // native double, ARB_gpu_shader_fp64 on the gpu
+    DoubleFloat  // unevaluated sum of two floats, about 48 bits of mantissa
+};
+
+const char* precision_name(Precision precision);
+
+// First scales where a precision gets more than 1% of the pixels other than long double,
+// from --bench-precision on the alpha fixed point (-0.1519, -0.4939) of the default c,
+// where there is detail at every scale. Above MAX_DOUBLE_SCALE deep zoom is needed.
+const double FLOAT_SCALE_LIMIT = 1e3;
+const double DOUBLE_FLOAT_SCALE_LIMIT = 1e11;
+const double MAX_DOUBLE_SCALE = 1e12;
+
+// Cheapest precision that is still exact enough at this scale, Double if native_double
+// (the gpu has ARB_gpu_shader_fp64), DoubleFloat otherwise.
+Precision auto_precision(double scale, bool native_double);
+
+struct FractalParams {
+    // double for the Double and DoubleFloat precisions, Float rounds them to float first
+    double translation[2] = {0, 0};
+    double scale = 1;
+    float aspect_ratio = 1;
+
+    float cvec[2] = {0, 0};
+    float R = 2;
+    int num_it = 1;
+
+    // u_periodicity: stop orbits that escaped past orbit_bailout or got stuck in a cycle
+    // (Brent style check against the value at the last power of two step). They are
+    // ITER_NEVER anyway, up to PERIODICITY_EPS.
+    bool periodicity = false;
+
+    Precision precision = Precision::Float;
+
+    // z^n + c, capture metric and coloring. DoubleFloat and deep zoom do the default only.
+    KernelVariant variant;
+};
+
+// largest iteration value, num_it times values_per_iteration. Colors are spread over 1 .. this.
+int max_value(const FractalParams& params);
+
+const float PERIODICITY_EPS = 1e-6f;
+
+// Radius after which an orbit only grows and can never get into u_R again
+// (its capture_radius), for the power of the variant.
+float orbit_bailout(const FractalParams& params);
+
+// Lanes are for Precision::Float, Double has half as many. DoubleFloat always runs scalar.
+enum class CpuKernel {
+    Scalar,
+    SSE,  // 2 x 4 lanes
+    AVX2  // 2 x 8 lanes
+};
+
+const char* kernel_name(CpuKernel kernel);
+bool kernel_available(CpuKernel kernel);
+CpuKernel best_kernel();
+
+// values of the iteration buffer
+const int ITER_OUTSIDE = -1;  // pixel is not covered by the fractal quad
+const int ITER_NEVER = 0;     // orbit never got into u_R, color_out in the shader
+// otherwise - first i with |z_i| <= R, as in the shader loop
+
+// Computes iteration values for pixels [x0, x1) x [y0, y1) of a width x height image,
+// row 0 being the top one. out points at pixel (x0, y0), stride is in elements.
+// Returns the number of f_c evaluations the plain loop does (pixel-iterations), orbits
+// stopped by periodicity are counted as num_it.
+// The loop is compiled for every KernelVariant, specialized = false runs one loop that
+// reads the variant at run time instead (for --bench-kernels).
+uint64_t iterate_region(const FractalParams& params, int width, int height,
+                        int x0, int y0, int x1, int y1,
+                        int* out, int stride, CpuKernel kernel, bool specialized = true);
+
+// Same for a list of pixels (xs[i], ys[i]), out[i] gets the value of pixel i.
+uint64_t iterate_pixels(const FractalParams& params, int width, int height,
+                        const int* xs, const int* ys, int n, int* out, CpuKernel kernel,
+                        bool specialized = true);
+
+// Bottom row of grad.png, loaded and filtered the same way as the gradient texture.
+class Gradient {
+private:
+    int width;
+    std::vector<float> texels;
+
+public:
+    Gradient(const char* path);
+
+    // GL_LINEAR + GL_CLAMP_TO_EDGE lookup at (u, 0)
+    void sample(float u, float* rgb) const;
+};
+
+// Color of one iteration value as float RGB, before rounding to 8 bits. num_it is
+// max_value of the params.
+void sample_color(int value, int num_it, const Gradient& gradient, float* rgb);
+
+// 8 bit channel of sample_color
+unsigned char to_channel(float c);
+
+// Maps iteration values to RGB8 exactly like color-shader.fs does with the default palette.
+void colorize(const int* iterations, int count, int num_it, const Gradient& gradient, unsigned char* rgb);
+
+struct CpuRenderStats {
+    uint64_t iterations = 0;
+    double seconds = 0;
+
+    double mpix_it_per_second() const {
+        return seconds > 0 ? iterations / seconds / 1e6 : 0;
+    }
+};
+
+// Single-threaded render of the whole image into width * height * 3 bytes.
+CpuRenderStats render_image(const FractalParams& params, int width, int height, CpuKernel kernel,
+                            const Gradient& gradient, std::vector<unsigned char>& rgb);
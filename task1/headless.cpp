@@ -0,0 +1,706 @@
+#include "headless.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "atlas.h"
+#include "deep_zoom.h"
+#include "distributed.h"
+#include "fractal_cpu.h"
+#include "image_writer.h"
+#include "keyframes.h"
+#include "subdivision.h"
+#include "tile_render.h"
+#include "stb_image_write.h"
+
+namespace
+{
+    struct Options {
+        FractalParams params;
+        int width = 1920, height = 1080;
+
+        // perturbation against a BigFixed reference orbit, position is parsed exactly
+        bool deep = false;
+        std::string position[2] = {"0", "0"};
+        double scale = 0.5;
+        TiledRenderOptions tiled;
+
+        // --atlas: a grid of Julia sets around --c instead of one view
+        bool atlas = false;
+        AtlasLayout layout;
+
+        // --animate: frames between keyframes, numbered pngs written by encoder threads
+        std::string keyframes, frame_prefix;
+        double fps = 30;
+        int encoders = 2;
+
+        // --workers: tiles rendered by worker processes, see distributed.h
+        DistributedOptions distributed;
+        bool use_workers = false;
+        std::string executable;
+        int worker_fd = -1;          // started by a coordinator
+        std::string worker_address;  // --worker <host>:<port>
+
+        std::string output;
+        bool bench = false, bench_precision = false, bench_antialias = false, bench_kernels = false;
+        int repeats = 3;
+    };
+
+    void usage() {
+        std::cerr << "usage:\n"
+                  << "  task1                      interactive viewer\n"
+                  << "  task1 --cpu <out.png>      render on the cpu, tiles are spread over all cores\n"
+                  << "  task1 --atlas <out.png>    julia sets of a grid of c around --c and the c plane overview\n"
+                  << "  task1 --animate <keys.txt> <prefix>  frames <prefix>00000.png ... between the keyframes,\n"
+                  << "                             one \"time x y scale c_re c_im R numit\" per line\n"
+                  << "  task1 --cpu <out.png> --workers <n>  the same in n worker processes, --listen <port> also\n"
+                  << "                             takes remote workers, started with  task1 --worker <host>:<port>\n"
+                  << "  task1 --bench              measure every compiled in cpu kernel\n"
+                  << "  task1 --bench-precision    time and error of every precision, zooming into --position\n"
+                  << "  task1 --bench-antialias    edge supersampling against supersampling every pixel\n"
+                  << "  task1 --bench-kernels      compile time specialized kernels against the generic one\n"
+                  << "options:\n"
+                  << "  --size <w>x<h>  --kernel scalar|sse|avx2  --repeats <n>\n"
+                  << "  --tile <n>  --threads <n>  --static (no work stealing)  --subdivide (Mariani-Silver)\n"
+                  << "  --position <x> <y>  --scale <s>  --c <re> <im>  --R <r>  --numit <n>  --periodicity\n"
+                  << "  --precision float|double|double-float|auto  --antialias <n> (n x n samples for edge pixels)\n"
+                  << "  --deep (perturbation, for --scale up to 1e300, --position with as many digits as needed)\n"
+                  << "  --power <2..6> (z^n + c)  --metric euclidean|manhattan|chebyshev  --coloring iterations|decomposition\n"
+                  << "  --grid <cols>x<rows>  --span <s> (c across the grid)  --no-overview, for --atlas\n"
+                  << "  --fps <f>  --encoders <n> (png encoding threads, 0 encodes on the render thread), for --animate\n"
+                  << "  --jobs <n> (tiles in flight per worker)  --kill-worker <n> (kill a worker after n tiles), for --workers\n";
+    }
+
+    CpuKernel parse_kernel(const std::string& name) {
+        for (CpuKernel kernel: {CpuKernel::Scalar, CpuKernel::SSE, CpuKernel::AVX2})
+            if (name == kernel_name(kernel))
+                return kernel;
+        throw std::runtime_error("unknown kernel " + name);
+    }
+
+    Precision parse_precision(const std::string& name, double scale) {
+        if (name == "auto")
+            return auto_precision(scale, true);
+        for (Precision precision: {Precision::Float, Precision::Double, Precision::DoubleFloat})
+            if (name == precision_name(precision))
+                return precision;
+        throw std::runtime_error("unknown precision " + name);
+    }
+
+    EscapeMetric parse_metric(const std::string& name) {
+        for (EscapeMetric metric: {EscapeMetric::Euclidean, EscapeMetric::Manhattan, EscapeMetric::Chebyshev})
+            if (name == metric_name(metric))
+                return metric;
+        throw std::runtime_error("unknown metric " + name);
+    }
+
+    Coloring parse_coloring(const std::string& name) {
+        for (Coloring coloring: {Coloring::Iterations, Coloring::Decomposition})
+            if (name == coloring_name(coloring))
+                return coloring;
+        throw std::runtime_error("unknown coloring " + name);
+    }
+
+    Options parse_options(int argc, char **argv) {
+        Options opts;
+
+        // same view as the interactive defaults in main()
+        opts.params.cvec[0] = 0.069, opts.params.cvec[1] = -0.644;
+        opts.params.R = 0.178;
+        opts.params.scale = 0.5;
+        opts.params.num_it = 35;
+
+        int pos = 1;
+        auto next = [&]() -> std::string {
+            if (pos >= argc)
+                throw std::runtime_error(std::string("missing value after ") + argv[pos - 1]);
+            return argv[pos++];
+        };
+        auto next_float = [&]() { return std::stof(next()); };
+        auto next_int = [&]() { return std::stoi(next()); };
+        std::string precision = "float";
+
+        while (pos < argc) {
+            std::string arg = argv[pos++];
+
+            if (arg == "--cpu") {
+                opts.output = next();
+            } else if (arg == "--atlas") {
+                opts.output = next();
+                opts.atlas = true;
+            } else if (arg == "--animate") {
+                opts.keyframes = next();
+                opts.frame_prefix = next();
+            } else if (arg == "--fps") {
+                opts.fps = std::stod(next());
+                if (opts.fps <= 0)
+                    throw std::runtime_error("--fps must be positive");
+            } else if (arg == "--encoders") {
+                opts.encoders = std::max(0, next_int());
+            } else if (arg == "--workers") {
+                opts.distributed.workers = std::max(0, next_int());
+                opts.use_workers = true;
+            } else if (arg == "--listen") {
+                opts.distributed.listen_port = next_int();
+                opts.use_workers = true;
+            } else if (arg == "--jobs") {
+                opts.distributed.jobs_in_flight = std::max(1, next_int());
+            } else if (arg == "--kill-worker") {
+                opts.distributed.kill_worker_after = std::max(0, next_int());
+            } else if (arg == "--worker-fd") {
+                opts.worker_fd = next_int();
+            } else if (arg == "--worker") {
+                opts.worker_address = next();
+            } else if (arg == "--grid") {
+                std::string grid = next();
+                if (sscanf(grid.c_str(), "%dx%d", &opts.layout.cols, &opts.layout.rows) != 2
+                    or opts.layout.cols <= 0 or opts.layout.rows <= 0)
+                    throw std::runtime_error("bad grid " + grid);
+            } else if (arg == "--span") {
+                opts.layout.span = std::stod(next());
+            } else if (arg == "--no-overview") {
+                opts.layout.overview = false;
+            } else if (arg == "--bench") {
+                opts.bench = true;
+            } else if (arg == "--bench-precision") {
+                opts.bench_precision = true;
+            } else if (arg == "--bench-antialias") {
+                opts.bench_antialias = true;
+            } else if (arg == "--bench-kernels") {
+                opts.bench_kernels = true;
+            } else if (arg == "--size") {
+                std::string size = next();
+                if (sscanf(size.c_str(), "%dx%d", &opts.width, &opts.height) != 2 or opts.width <= 0 or opts.height <= 0)
+                    throw std::runtime_error("bad size " + size);
+            } else if (arg == "--kernel") {
+                opts.tiled.kernel = parse_kernel(next());
+            } else if (arg == "--repeats") {
+                opts.repeats = std::max(1, next_int());
+            } else if (arg == "--tile") {
+                opts.tiled.tile_size = std::max(1, next_int());
+            } else if (arg == "--threads") {
+                opts.tiled.threads = std::max(1, next_int());
+            } else if (arg == "--static") {
+                opts.tiled.work_stealing = false;
+            } else if (arg == "--subdivide") {
+                opts.tiled.subdivide = true;
+            } else if (arg == "--antialias") {
+                opts.tiled.antialias = std::max(0, next_int());
+            } else if (arg == "--position") {
+                for (int i = 0; i < 2; ++i) {
+                    opts.position[i] = next();
+                    opts.params.translation[i] = std::stod(opts.position[i]);
+                }
+            } else if (arg == "--scale") {
+                opts.scale = std::stod(next());
+                opts.params.scale = opts.scale;
+            } else if (arg == "--deep") {
+                opts.deep = true;
+            } else if (arg == "--c") {
+                opts.params.cvec[0] = next_float();
+                opts.params.cvec[1] = next_float();
+            } else if (arg == "--R") {
+                opts.params.R = next_float();
+            } else if (arg == "--numit") {
+                opts.params.num_it = next_int();
+            } else if (arg == "--periodicity") {
+                opts.params.periodicity = true;
+            } else if (arg == "--precision") {
+                precision = next();
+            } else if (arg == "--power") {
+                opts.params.variant.power = next_int();
+                if (opts.params.variant.power < MIN_POWER or opts.params.variant.power > MAX_POWER)
+                    throw std::runtime_error(fmt::format("--power is {}..{}", MIN_POWER, MAX_POWER));
+            } else if (arg == "--metric") {
+                opts.params.variant.metric = parse_metric(next());
+            } else if (arg == "--coloring") {
+                opts.params.variant.coloring = parse_coloring(next());
+            } else {
+                throw std::runtime_error("unknown argument " + arg);
+            }
+        }
+
+        opts.executable = argv[0];
+        opts.params.aspect_ratio = float(opts.height) / opts.width;
+        opts.params.precision = parse_precision(precision, opts.scale);
+
+        opts.layout.center[0] = opts.params.cvec[0];
+        opts.layout.center[1] = opts.params.cvec[1];
+        if ((opts.atlas or not opts.keyframes.empty()) and opts.deep)
+            throw std::runtime_error("the atlas and animations are not for deep zoom");
+
+        if (opts.use_workers and (opts.deep or opts.atlas or not opts.keyframes.empty()))
+            throw std::runtime_error("only --cpu renders go to workers");
+
+        if (opts.params.variant != KernelVariant() and opts.deep)
+            throw std::runtime_error("deep zoom iterates z^2 with the euclidean metric only");
+        if (opts.params.variant != KernelVariant() and opts.params.precision == Precision::DoubleFloat)
+            throw std::runtime_error("double-float iterates z^2 with the euclidean metric only");
+        return opts;
+    }
+
+    int render_to_file(const Options& opts) {
+        Gradient gradient("grad.png");
+        std::vector<unsigned char> rgb;
+
+        TiledRenderStats stats;
+
+        if (opts.deep) {
+            DeepView view;
+            view.scale = opts.scale;
+            for (int i = 0; i < 2; ++i)
+                view.center[i] = BigFixed::from_string(opts.position[i], BigFixed::limbs_for_scale(view.scale));
+
+            auto start = std::chrono::steady_clock::now();
+            ReferenceOrbit orbit = compute_reference_orbit(view, opts.params);
+            std::cout << fmt::format("reference orbit: {} points, {} bits, {:.1f} ms\n", orbit.length(),
+                                     32 * view.center[0].precision(),
+                                     std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000);
+
+            TileIterator iterate = [&](const Tile& tile, int* out, int stride) {
+                return iterate_region_deep(opts.params, view, orbit, opts.width, opts.height,
+                                           tile.x0, tile.y0, tile.x1, tile.y1, out, stride);
+            };
+            if (opts.tiled.subdivide)
+                iterate = subdivided([&](const int* xs, const int* ys, int n, int* out) {
+                    return iterate_pixels_deep(opts.params, view, orbit, opts.width, opts.height, xs, ys, n, out);
+                });
+            const int samples = opts.tiled.antialias;
+            auto iterate_samples = [&](const int* xs, const int* ys, int n, int* out) {
+                return iterate_pixels_deep(opts.params, view, orbit, opts.width * samples, opts.height * samples,
+                                           xs, ys, n, out);
+            };
+            stats = render_tiled(iterate, max_value(opts.params), opts.width, opts.height, opts.tiled, gradient, rgb,
+                                 iterate_samples);
+        } else if (opts.atlas) {
+            stats = render_atlas(opts.params, opts.layout, opts.width, opts.height, opts.tiled, gradient, rgb);
+            std::cout << fmt::format("atlas: {}x{} cells of {} pixels, c ({:.6g}, {:.6g}) +- {:.6g}\n",
+                                     opts.layout.cols, opts.layout.rows,
+                                     atlas_geometry(opts.layout, opts.width, opts.height).cell,
+                                     opts.layout.center[0], opts.layout.center[1], opts.layout.span / 2);
+        } else {
+            stats = render_tiled(opts.params, opts.width, opts.height, opts.tiled, gradient, rgb);
+        }
+
+        std::cout << fmt::format("{}x{}, {} kernel{}, {} tiles on {} threads ({}), {:.1f} ms, {:.1f} Mpixel*it/s\n",
+                                 opts.width, opts.height,
+                                 opts.deep ? "deep" : fmt::format("{} {} {}", kernel_name(opts.tiled.kernel),
+                                                                  precision_name(opts.params.precision),
+                                                                  variant_name(opts.params.variant)),
+                                 opts.tiled.subdivide ? " subdivided" : "", stats.tiles,
+                                 stats.workers.size(), opts.tiled.work_stealing ? "work stealing" : "static",
+                                 stats.total.seconds * 1000, stats.total.mpix_it_per_second());
+
+        double busy = 0;
+        for (size_t w = 0; w < stats.workers.size(); ++w) {
+            const auto& worker = stats.workers[w];
+            busy += worker.busy_seconds;
+            std::cout << fmt::format("  worker {:2}: {:5} tiles, {:5} stolen, busy {:.1f} ms\n",
+                                     w, worker.tasks, worker.stolen, worker.busy_seconds * 1000);
+        }
+        if (stats.total.seconds > 0)
+            std::cout << fmt::format("  core utilization {:.1f}%\n",
+                                     100 * busy / (stats.total.seconds * stats.workers.size()));
+        if (opts.tiled.antialias > 1)
+            std::cout << fmt::format("  {} edge pixels refined with {} samples ({:.2f}%)\n", stats.refined_pixels,
+                                     opts.tiled.antialias * opts.tiled.antialias,
+                                     100.0 * stats.refined_pixels / (size_t(opts.width) * opts.height));
+
+        auto start = std::chrono::steady_clock::now();
+        if (not stbi_write_png(opts.output.c_str(), opts.width, opts.height, 3, rgb.data(), opts.width * 3))
+            throw std::runtime_error("failed to write " + opts.output);
+        std::cout << fmt::format("{} written in {:.1f} ms\n", opts.output,
+                                 std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000);
+        return 0;
+    }
+
+    int render_with_workers(const Options& opts) {
+        Gradient gradient("grad.png");
+        std::vector<unsigned char> rgb;
+
+        DistributedStats stats = render_distributed(opts.params, opts.width, opts.height, opts.tiled, opts.distributed,
+                                                    opts.executable, gradient, rgb);
+
+        std::cout << fmt::format("{}x{}, {} {} {} kernel{}, {} tiles on {} workers, {:.1f} ms, {:.1f} Mpixel*it/s\n",
+                                 opts.width, opts.height, kernel_name(opts.tiled.kernel),
+                                 precision_name(opts.params.precision), variant_name(opts.params.variant),
+                                 opts.tiled.subdivide ? " subdivided" : "", stats.tiles, stats.workers.size(),
+                                 stats.total.seconds * 1000, stats.total.mpix_it_per_second());
+        for (const auto& worker: stats.workers) {
+            double rate = worker.busy_seconds > 0 ? worker.iterations / worker.busy_seconds / 1e6 : 0;
+            std::cout << fmt::format("  {:>20}: {:5} tiles, {:6.2f} Mpixel, busy {:7.1f} ms, {:7.1f} Mpixel*it/s{}\n",
+                                     worker.name, worker.tiles, worker.pixels / 1e6, worker.busy_seconds * 1000, rate,
+                                     worker.died ? fmt::format(", died, {} tiles requeued", worker.requeued) : "");
+        }
+
+        if (not stbi_write_png(opts.output.c_str(), opts.width, opts.height, 3, rgb.data(), opts.width * 3))
+            throw std::runtime_error("failed to write " + opts.output);
+        std::cout << opts.output << " written\n";
+        return 0;
+    }
+
+    // Frames are rendered one after another with all --threads, each one is handed to
+    // the writer, which encodes it while the next one renders.
+    int render_animation(const Options& opts) {
+        const std::vector<Keyframe> keyframes = parse_keyframes(opts.keyframes);
+        const double duration = keyframes.back().time - keyframes.front().time;
+        const int frames = int(std::floor(duration * opts.fps + 1e-9)) + 1;
+
+        Gradient gradient("grad.png");
+        // two frames in flight per encoder keep them busy without piling up memory
+        AsyncImageWriter writer(opts.encoders, 2 * opts.encoders);
+
+        double render_seconds = 0;
+        uint64_t iterations = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        for (int frame = 0; frame < frames; ++frame) {
+            FractalParams params = interpolate_keyframes(keyframes, keyframes.front().time + frame / opts.fps,
+                                                         opts.params);
+            // the zoom can leave float behind, a chosen double or double-float stays
+            if (params.precision == Precision::Float)
+                params.precision = auto_precision(params.scale, true);
+
+            std::vector<unsigned char> rgb;
+            TiledRenderStats stats = render_tiled(params, opts.width, opts.height, opts.tiled, gradient, rgb);
+            render_seconds += stats.total.seconds;
+            iterations += stats.total.iterations;
+
+            writer.submit(fmt::format("{}{:05}.png", opts.frame_prefix, frame), opts.width, opts.height, std::move(rgb));
+        }
+        writer.finish();
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        ImageWriterStats written = writer.getStats();
+
+        std::cout << fmt::format("{} frames of {}x{}, {:.1f} s of animation at {} fps\n", frames, opts.width, opts.height,
+                                 duration, opts.fps);
+        std::cout << fmt::format("  render {:.1f} ms/frame on {} threads, {:.1f} Mpixel*it/s\n",
+                                 render_seconds * 1000 / frames, opts.tiled.threads,
+                                 render_seconds > 0 ? iterations / render_seconds / 1e6 : 0.0);
+        std::cout << fmt::format("  png encoding {:.1f} ms/frame {}, render loop stalled {:.1f} ms, at most {} queued\n",
+                                 written.encode_seconds * 1000 / frames,
+                                 opts.encoders > 0 ? fmt::format("on {} threads", opts.encoders) : "on the render thread",
+                                 written.stall_seconds * 1000, written.max_pending);
+        std::cout << fmt::format("{:.2f} s, {:.2f} frames/s\n", seconds, frames / seconds);
+        return 0;
+    }
+
+    int bench(const Options& opts) {
+        const size_t pixels = size_t(opts.width) * opts.height;
+        std::vector<int> reference, iterations(pixels);
+        uint64_t reference_iterations = 0;
+        double best_seconds = 0;
+
+        std::cout << fmt::format("{}x{}, c = ({}, {}), R = {}, numit = {}, {}\n", opts.width, opts.height,
+                                 opts.params.cvec[0], opts.params.cvec[1], opts.params.R, opts.params.num_it,
+                                 precision_name(opts.params.precision));
+
+        for (CpuKernel kernel: {CpuKernel::Scalar, CpuKernel::SSE, CpuKernel::AVX2}) {
+            if (not kernel_available(kernel))
+                continue;
+
+            CpuRenderStats best;
+            for (int r = 0; r < opts.repeats; ++r) {
+                CpuRenderStats stats;
+                auto start = std::chrono::steady_clock::now();
+                stats.iterations = iterate_region(opts.params, opts.width, opts.height, 0, 0, opts.width, opts.height,
+                                                  iterations.data(), opts.width, kernel);
+                stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                if (r == 0 or stats.seconds < best.seconds)
+                    best = stats;
+            }
+
+            if (reference.empty()) {
+                reference = iterations;
+                reference_iterations = best.iterations;
+            }
+
+            size_t mismatches = 0;
+            for (size_t i = 0; i < pixels; ++i)
+                mismatches += reference[i] != iterations[i];
+
+            std::cout << fmt::format("{:>8}: {:8.1f} ms  {:8.1f} Mpixel*it/s  {} pixels differ from scalar\n",
+                                     kernel_name(kernel), best.seconds * 1000, best.mpix_it_per_second(), mismatches);
+            best_seconds = best.seconds;
+        }
+
+        // the last (fastest) kernel once more, iterating only rectangle borders where possible
+        const CpuKernel kernel = best_kernel();
+        auto iterate = [&](const int* xs, const int* ys, int n, int* out) {
+            return iterate_pixels(opts.params, opts.width, opts.height, xs, ys, n, out, kernel);
+        };
+
+        CpuRenderStats best;
+        for (int r = 0; r < opts.repeats; ++r) {
+            CpuRenderStats stats;
+            auto start = std::chrono::steady_clock::now();
+            stats.iterations = iterate_subdivided(iterate, Tile {0, 0, opts.width, opts.height}, iterations.data(), opts.width);
+            stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            if (r == 0 or stats.seconds < best.seconds)
+                best = stats;
+        }
+
+        size_t mismatches = 0;
+        for (size_t i = 0; i < pixels; ++i)
+            mismatches += reference[i] != iterations[i];
+
+        std::cout << fmt::format("{:>8}: {:8.1f} ms  {:8.1f}x faster, {:.1f}% of the iterations, {} pixels differ from scalar\n",
+                                 std::string(kernel_name(kernel)) + "+ms", best.seconds * 1000,
+                                 best.seconds > 0 ? best_seconds / best.seconds : 0.0,
+                                 100.0 * best.iterations / std::max<uint64_t>(1, reference_iterations), mismatches);
+
+        return 0;
+    }
+
+    // The plain loop in long double (64 bit mantissa on x86, only double with msvc),
+    // the pixel position is computed from the exact --position.
+    void reference_region(const Options& opts, double scale, int* out) {
+        typedef long double L;
+        const FractalParams& params = opts.params;
+        const L center[2] = {std::stold(opts.position[0]), std::stold(opts.position[1])};
+        const L r2 = params.R * params.R, bailout2 = L(orbit_bailout(params)) * orbit_bailout(params);
+
+        for (int y = 0; y < opts.height; ++y)
+            for (int x = 0; x < opts.width; ++x) {
+                L px = ((2 * x + 1) / L(opts.width) - 1) / scale + center[0];
+                L py = (1 - (2 * y + 1) / L(opts.height)) * L(params.aspect_ratio) / scale + center[1];
+                int& res = out[size_t(y) * opts.width + x];
+
+                if (std::abs(px) > 1 or std::abs(py) > 1) {
+                    res = ITER_OUTSIDE;
+                    continue;
+                }
+
+                L zx = px * px - py * py + params.cvec[0], zy = 2 * px * py + params.cvec[1];
+                res = ITER_NEVER;
+                for (int i = 1; i <= params.num_it; ++i) {
+                    L len2 = zx * zx + zy * zy;
+                    if (len2 <= r2) {
+                        res = i;
+                        break;
+                    }
+                    // escaped for good, no need to overflow
+                    if (len2 > bailout2)
+                        break;
+
+                    L nx = zx * zx - zy * zy + params.cvec[0];
+                    zy = 2 * zx * zy + params.cvec[1];
+                    zx = nx;
+                }
+            }
+    }
+
+    // Every precision at scales 1 .. 1e15 around --position: time with the best kernel on one
+    // thread and the share of pixels that differ from long double. That is what the limits
+    // of auto_precision are taken from.
+    int bench_precision(const Options& opts) {
+        const size_t pixels = size_t(opts.width) * opts.height;
+        std::vector<int> reference(pixels), iterations(pixels);
+        const CpuKernel kernel = best_kernel();
+
+        std::cout << fmt::format("{}x{}, c = ({}, {}), R = {}, numit = {}, position ({}, {}), {} kernel\n",
+                                 opts.width, opts.height, opts.params.cvec[0], opts.params.cvec[1], opts.params.R,
+                                 opts.params.num_it, opts.position[0], opts.position[1], kernel_name(kernel));
+        std::cout << fmt::format("{:>7}", "scale");
+        for (Precision precision: {Precision::Float, Precision::Double, Precision::DoubleFloat})
+            std::cout << fmt::format("  {:>24}", precision_name(precision));
+        std::cout << "\n";
+
+        for (double scale = 1; scale <= 1e15; scale *= 10) {
+            reference_region(opts, scale, reference.data());
+            std::cout << fmt::format("{:7.0e}", scale);
+
+            for (Precision precision: {Precision::Float, Precision::Double, Precision::DoubleFloat}) {
+                FractalParams params = opts.params;
+                params.scale = scale;
+                params.precision = precision;
+
+                double best = 0;
+                for (int r = 0; r < opts.repeats; ++r) {
+                    auto start = std::chrono::steady_clock::now();
+                    iterate_region(params, opts.width, opts.height, 0, 0, opts.width, opts.height,
+                                   iterations.data(), opts.width, kernel);
+                    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                    best = r == 0 ? seconds : std::min(best, seconds);
+                }
+
+                size_t mismatches = 0;
+                for (size_t i = 0; i < pixels; ++i)
+                    mismatches += reference[i] != iterations[i];
+
+                std::cout << fmt::format("  {:8.1f} ms {:9.4f}% off", best * 1000, 100.0 * mismatches / pixels);
+            }
+            std::cout << "\n";
+        }
+
+        return 0;
+    }
+
+    // Every KernelVariant with its compile time specialized loop and with the generic loop
+    // that reads the variant at run time, one thread, --kernel and --precision.
+    int bench_kernels(const Options& opts) {
+        const size_t pixels = size_t(opts.width) * opts.height;
+        std::vector<int> specialized(pixels), generic(pixels);
+        const CpuKernel kernel = opts.tiled.kernel;
+
+        std::cout << fmt::format("{}x{}, c = ({}, {}), R = {}, numit = {}, {} {}\n", opts.width, opts.height,
+                                 opts.params.cvec[0], opts.params.cvec[1], opts.params.R, opts.params.num_it,
+                                 kernel_name(kernel), precision_name(opts.params.precision));
+        std::cout << fmt::format("{:>32}  {:>11}  {:>11}  {:>7}  {}\n", "variant", "specialized", "generic", "speedup",
+                                 "pixels differ");
+
+        auto run = [&](const FractalParams& params, bool specialize, std::vector<int>& out) {
+            CpuRenderStats best;
+            for (int r = 0; r < opts.repeats; ++r) {
+                CpuRenderStats stats;
+                auto start = std::chrono::steady_clock::now();
+                stats.iterations = iterate_region(params, opts.width, opts.height, 0, 0, opts.width, opts.height,
+                                                  out.data(), opts.width, kernel, specialize);
+                stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                if (r == 0 or stats.seconds < best.seconds)
+                    best = stats;
+            }
+            return best;
+        };
+
+        double total[2] = {0, 0};
+        for (int power = MIN_POWER; power <= MAX_POWER; ++power)
+            for (EscapeMetric metric: {EscapeMetric::Euclidean, EscapeMetric::Manhattan, EscapeMetric::Chebyshev})
+                for (Coloring coloring: {Coloring::Iterations, Coloring::Decomposition}) {
+                    FractalParams params = opts.params;
+                    params.variant.power = power;
+                    params.variant.metric = metric;
+                    params.variant.coloring = coloring;
+
+                    CpuRenderStats fast = run(params, true, specialized), slow = run(params, false, generic);
+                    total[0] += fast.seconds, total[1] += slow.seconds;
+
+                    size_t mismatches = 0;
+                    for (size_t i = 0; i < pixels; ++i)
+                        mismatches += specialized[i] != generic[i];
+
+                    std::cout << fmt::format("{:>32}  {:8.1f} ms  {:8.1f} ms  {:6.2f}x  {}\n", variant_name(params.variant),
+                                             fast.seconds * 1000, slow.seconds * 1000,
+                                             fast.seconds > 0 ? slow.seconds / fast.seconds : 0.0, mismatches);
+                }
+
+        std::cout << fmt::format("{:>32}  {:8.1f} ms  {:8.1f} ms  {:6.2f}x\n", "total", total[0] * 1000, total[1] * 1000,
+                                 total[0] > 0 ? total[1] / total[0] : 0.0);
+        return 0;
+    }
+
+    // mean absolute channel difference, in 8 bit steps
+    double color_error(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b) {
+        double total = 0;
+        for (size_t i = 0; i < a.size(); ++i)
+            total += std::abs(int(a[i]) - int(b[i]));
+        return total / std::max<size_t>(1, a.size());
+    }
+
+    // No antialiasing and edge supersampling with --antialias n (4 if not given) against
+    // n x n supersampling of every pixel, box filtered.
+    int bench_antialias(const Options& opts) {
+        Gradient gradient("grad.png");
+        const int n = opts.tiled.antialias > 1 ? opts.tiled.antialias : 4;
+
+        auto render = [&](int antialias, std::vector<unsigned char>& rgb) {
+            TiledRenderOptions tiled = opts.tiled;
+            tiled.antialias = antialias;
+
+            TiledRenderStats best;
+            for (int r = 0; r < opts.repeats; ++r) {
+                TiledRenderStats stats = render_tiled(opts.params, opts.width, opts.height, tiled, gradient, rgb);
+                if (r == 0 or stats.total.seconds < best.total.seconds)
+                    best = stats;
+            }
+            return best;
+        };
+
+        std::vector<unsigned char> plain, adaptive, fine;
+        TiledRenderStats plain_stats = render(0, plain), adaptive_stats = render(n, adaptive);
+
+        // every pixel: the n times larger image, box filtered
+        TiledRenderOptions tiled = opts.tiled;
+        tiled.antialias = 0;
+        TiledRenderStats full_stats;
+        for (int r = 0; r < opts.repeats; ++r) {
+            TiledRenderStats stats = render_tiled(opts.params, opts.width * n, opts.height * n, tiled, gradient, fine);
+            if (r == 0 or stats.total.seconds < full_stats.total.seconds)
+                full_stats = stats;
+        }
+
+        std::vector<unsigned char> full(plain.size());
+        for (int y = 0; y < opts.height; ++y)
+            for (int x = 0; x < opts.width; ++x)
+                for (int c = 0; c < 3; ++c) {
+                    int sum = 0;
+                    for (int j = 0; j < n; ++j)
+                        for (int i = 0; i < n; ++i)
+                            sum += fine[(size_t(y * n + j) * opts.width * n + x * n + i) * 3 + c];
+                    full[(size_t(y) * opts.width + x) * 3 + c] = (unsigned char)((sum + n * n / 2) / (n * n));
+                }
+
+        std::cout << fmt::format("{}x{}, numit = {}, {} samples per refined pixel\n", opts.width, opts.height,
+                                 opts.params.num_it, n * n);
+        std::cout << fmt::format("    none: {:8.1f} ms  error {:.3f}\n", plain_stats.total.seconds * 1000,
+                                 color_error(plain, full));
+        std::cout << fmt::format("   edges: {:8.1f} ms  error {:.3f}, {:.2f}% of the pixels refined\n",
+                                 adaptive_stats.total.seconds * 1000, color_error(adaptive, full),
+                                 100.0 * adaptive_stats.refined_pixels / (size_t(opts.width) * opts.height));
+        std::cout << fmt::format("  {:>2}xSSAA: {:7.1f} ms  (reference)\n", n * n, full_stats.total.seconds * 1000);
+        return 0;
+    }
+}
+
+int run_headless(int argc, char **argv) {
+    Options opts;
+
+    try {
+        opts = parse_options(argc, argv);
+    } catch (std::exception& e) {
+        std::cerr << e.what() << "\n";
+        usage();
+        return 1;
+    }
+
+    if (opts.worker_fd >= 0)
+        return run_worker(opts.worker_fd, opts.tiled.kernel);
+
+    if (not opts.worker_address.empty())
+        return run_remote_worker(opts.worker_address, opts.tiled.kernel);
+
+    if (opts.bench)
+        return bench(opts);
+
+    if (opts.bench_precision)
+        return bench_precision(opts);
+
+    if (opts.bench_antialias)
+        return bench_antialias(opts);
+
+    if (opts.bench_kernels)
+        return bench_kernels(opts);
+
+    if (not opts.keyframes.empty())
+        return render_animation(opts);
+
+    if (not opts.output.empty() and opts.use_workers)
+        return render_with_workers(opts);
+
+    if (not opts.output.empty())
+        return render_to_file(opts);
+
+    usage();
+    return 1;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+// Command line modes which don't need a window or an OpenGL context.
+// Returns the process exit code.
+int run_headless(int argc, char **argv);
@@ -0,0 +1,91 @@
+#include "image_writer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#include "stb_image_write.h"
+
+AsyncImageWriter::AsyncImageWriter(int threads, int max_pending) : max_pending(std::max(1, max_pending)) {
+    for (int i = 0; i < threads; ++i)
+        workers.emplace_back([this]() { work(); });
+}
+
+AsyncImageWriter::~AsyncImageWriter() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        space.wait(lock, [this]() { return queue.empty() and writing == 0; });
+        stop = true;
+    }
+    wake.notify_all();
+
+    for (auto& worker: workers)
+        worker.join();
+}
+
+void AsyncImageWriter::write(const Job& job) {
+    auto start = std::chrono::steady_clock::now();
+    bool written = stbi_write_png(job.path.c_str(), job.width, job.height, 3, job.rgb.data(), job.width * 3);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.images += 1;
+    stats.encode_seconds += seconds;
+    if (not written and not error)
+        error = std::make_exception_ptr(std::runtime_error("failed to write " + job.path));
+}
+
+void AsyncImageWriter::work() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        wake.wait(lock, [this]() { return stop or not queue.empty(); });
+        if (queue.empty())
+            return;
+
+        Job job = std::move(queue.front());
+        queue.pop_front();
+        writing += 1;
+        space.notify_all();
+
+        lock.unlock();
+        write(job);
+        lock.lock();
+
+        writing -= 1;
+        space.notify_all();
+    }
+}
+
+void AsyncImageWriter::submit(const std::string& path, int width, int height, std::vector<unsigned char> rgb) {
+    Job job {path, width, height, std::move(rgb)};
+    if (workers.empty()) {
+        write(job);
+    } else {
+        auto start = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(mutex);
+        space.wait(lock, [this]() { return int(queue.size()) < max_pending; });
+        stats.stall_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        queue.push_back(std::move(job));
+        stats.max_pending = std::max(stats.max_pending, int(queue.size()));
+        lock.unlock();
+        wake.notify_one();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void AsyncImageWriter::finish() {
+    std::unique_lock<std::mutex> lock(mutex);
+    space.wait(lock, [this]() { return queue.empty() and writing == 0; });
+    if (error)
+        std::rethrow_exception(error);
+}
+
+ImageWriterStats AsyncImageWriter::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct ImageWriterStats {
+    int images = 0;
+    double encode_seconds = 0;  // png encoding and writing, summed over the threads
+    double stall_seconds = 0;   // submit waiting for a free queue slot
+    int max_pending = 0;
+};
+
+// RGB8 images encoded to png and written by background threads, so that the caller
+// can go on rendering. At most max_pending images wait in the queue, submit blocks
+// beyond that. With 0 threads submit writes the image itself.
+class AsyncImageWriter {
+private:
+    struct Job {
+        std::string path;
+        int width, height;
+        std::vector<unsigned char> rgb;
+    };
+
+    mutable std::mutex mutex;
+    std::condition_variable wake, space;
+    std::deque<Job> queue;
+    int max_pending;
+    int writing = 0;
+    bool stop = false;
+
+    ImageWriterStats stats;
+    std::exception_ptr error;
+
+    std::vector<std::thread> workers;
+
+    void work();
+    void write(const Job& job);
+
+public:
+    AsyncImageWriter(int threads, int max_pending);
+    // waits for the queued images, errors are dropped
+    ~AsyncImageWriter();
+
+    AsyncImageWriter(const AsyncImageWriter&) = delete;
+    AsyncImageWriter& operator=(const AsyncImageWriter&) = delete;
+
+    // width * height * 3 bytes, the first write error is rethrown here or by finish
+    void submit(const std::string& path, int width, int height, std::vector<unsigned char> rgb);
+
+    // waits until everything submitted is written
+    void finish();
+
+    ImageWriterStats getStats() const;
+};
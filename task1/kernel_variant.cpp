@@ -0,0 +1,76 @@
+#include "kernel_variant.h"
+
+#include <cmath>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+const char* metric_name(EscapeMetric metric) {
+    switch (metric) {
+    case EscapeMetric::Manhattan:
+        return "manhattan";
+    case EscapeMetric::Chebyshev:
+        return "chebyshev";
+    default:
+        return "euclidean";
+    }
+}
+
+const char* coloring_name(Coloring coloring) {
+    switch (coloring) {
+    case Coloring::Decomposition:
+        return "decomposition";
+    default:
+        return "iterations";
+    }
+}
+
+std::string variant_name(const KernelVariant& variant) {
+    return fmt::format("z^{} {} {}", variant.power, metric_name(variant.metric), coloring_name(variant.coloring));
+}
+
+int values_per_iteration(const KernelVariant& variant) {
+    return variant.coloring == Coloring::Decomposition ? 2 : 1;
+}
+
+int iteration_of_value(const KernelVariant& variant, int value) {
+    return variant.coloring == Coloring::Decomposition ? (value + 1) / 2 : value;
+}
+
+float capture_radius(const KernelVariant& variant, float R) {
+    return variant.metric == EscapeMetric::Chebyshev ? R * std::sqrt(2.0f) : R;
+}
+
+std::string kernel_glsl(const KernelVariant& variant, const std::string& real) {
+    if (variant.power < MIN_POWER or variant.power > MAX_POWER)
+        throw std::runtime_error(fmt::format("power {} is not in {}..{}", variant.power, MIN_POWER, MAX_POWER));
+
+    const std::string vec = real == "double" ? "dvec2" : "vec2";
+
+    // p = p * z, power - 1 times, as complex_power in fractal_cpu.cpp
+    std::string step;
+    for (int k = 1; k < variant.power; ++k)
+        step += fmt::format("    p = {}(p.x * z.x - p.y * z.y, p.x * z.y + p.y * z.x);\n", vec);
+
+    std::string captured;
+    switch (variant.metric) {
+    case EscapeMetric::Manhattan:
+        captured = "abs(z.x) + abs(z.y) <= r";
+        break;
+    case EscapeMetric::Chebyshev:
+        captured = "max(abs(z.x), abs(z.y)) <= r";
+        break;
+    default:
+        captured = "z.x * z.x + z.y * z.y <= r2";
+        break;
+    }
+
+    std::string value = variant.coloring == Coloring::Decomposition ? "2 * i - (z.y >= 0.0 ? 1 : 0)" : "i";
+
+    return fmt::format("// generated by kernel_glsl, {name}\n\n"
+                       "{vec} fractal_step({vec} z, {vec} c)\n{{\n    {vec} p = z;\n{step}    return p + c;\n}}\n\n"
+                       "bool fractal_captured({vec} z, {real} r, {real} r2)\n{{\n    return {captured};\n}}\n\n"
+                       "int fractal_value(int i, {vec} z)\n{{\n    return {value};\n}}\n",
+                       fmt::arg("name", variant_name(variant)), fmt::arg("vec", vec), fmt::arg("real", real),
+                       fmt::arg("step", step), fmt::arg("captured", captured), fmt::arg("value", value));
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+
+// What f_c and the loop around it are, fixed at compile time in the cpu kernels
+// (fractal_cpu.cpp) and in the shaders (kernel_glsl).
+
+const int MIN_POWER = 2;
+const int MAX_POWER = 6;
+
+// norm of the |z| <= R test that ends the loop
+enum class EscapeMetric {
+    Euclidean,
+    Manhattan,  // |x| + |y|
+    Chebyshev   // max(|x|, |y|)
+};
+
+// what the iteration buffer gets for an orbit that got into R at step i
+enum class Coloring {
+    Iterations,    // i
+    Decomposition  // 2 i - 1 for im z >= 0, 2 i below (binary decomposition)
+};
+
+struct KernelVariant {
+    int power = 2;  // f_c(z) = z^power + c, MIN_POWER .. MAX_POWER
+    EscapeMetric metric = EscapeMetric::Euclidean;
+    Coloring coloring = Coloring::Iterations;
+
+    bool operator==(const KernelVariant& other) const {
+        return power == other.power and metric == other.metric and coloring == other.coloring;
+    }
+
+    bool operator!=(const KernelVariant& other) const {
+        return not (*this == other);
+    }
+};
+
+const char* metric_name(EscapeMetric metric);
+const char* coloring_name(Coloring coloring);
+std::string variant_name(const KernelVariant& variant);
+
+// values an orbit can end with per step, iteration values go up to num_it times this
+int values_per_iteration(const KernelVariant& variant);
+
+// step i of a positive iteration value
+int iteration_of_value(const KernelVariant& variant, int value);
+
+// Radius |z| of the capture region at R, the metric's unit ball is inside the euclidean one
+// of this radius.
+float capture_radius(const KernelVariant& variant, float R);
+
+// GLSL functions of the variant for real = "float" or "double":
+//   vec2 fractal_step(vec2 z, vec2 c)                     z^power + c
+//   bool fractal_captured(vec2 z, float r, float r2)      |z| <= r, r2 = r * r
+//   int fractal_value(int i, vec2 z)                      iteration value for step i
+// (dvec2 and double for "double"). Appended to the iteration shaders like palette.glsl,
+// with the same operations in the same order as the cpu kernels.
+std::string kernel_glsl(const KernelVariant& variant, const std::string& real);
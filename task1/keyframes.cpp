@@ -0,0 +1,68 @@
+#include "keyframes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+std::vector<Keyframe> parse_keyframes(const std::string& path) {
+    std::ifstream file(path);
+    if (not file)
+        throw std::runtime_error("failed to open " + path);
+
+    std::vector<Keyframe> keyframes;
+    std::string line;
+    for (int number = 1; std::getline(file, line); ++number) {
+        std::istringstream fields(line);
+        std::string first;
+        if (not (fields >> first) or first[0] == '#')
+            continue;
+
+        Keyframe key;
+        fields.str(line);
+        fields.clear();
+        if (not (fields >> key.time >> key.translation[0] >> key.translation[1] >> key.scale
+                 >> key.cvec[0] >> key.cvec[1] >> key.R >> key.num_it))
+            throw std::runtime_error(fmt::format("{}:{}: expected time x y scale c_re c_im R numit", path, number));
+        if (key.scale <= 0 or key.num_it <= 0)
+            throw std::runtime_error(fmt::format("{}:{}: scale and numit must be positive", path, number));
+        if (not keyframes.empty() and key.time <= keyframes.back().time)
+            throw std::runtime_error(fmt::format("{}:{}: times must increase", path, number));
+
+        keyframes.push_back(key);
+    }
+
+    if (keyframes.empty())
+        throw std::runtime_error("no keyframes in " + path);
+    return keyframes;
+}
+
+FractalParams interpolate_keyframes(const std::vector<Keyframe>& keyframes, double time, const FractalParams& base) {
+    auto next = std::upper_bound(keyframes.begin(), keyframes.end(), time,
+                                 [](double t, const Keyframe& key) { return t < key.time; });
+    if (next == keyframes.begin())
+        next += 1;
+    if (next == keyframes.end())
+        next -= 1;
+    const Keyframe& b = *next;
+    const Keyframe& a = next == keyframes.begin() ? b : *(next - 1);
+
+    double u = b.time > a.time ? (time - a.time) / (b.time - a.time) : 0;
+    u = std::max(0.0, std::min(u, 1.0));
+    auto mix = [&](double x, double y) {
+        return x + (y - x) * u;
+    };
+
+    FractalParams params = base;
+    for (int i = 0; i < 2; ++i) {
+        params.translation[i] = mix(a.translation[i], b.translation[i]);
+        params.cvec[i] = float(mix(a.cvec[i], b.cvec[i]));
+    }
+    params.scale = std::exp(mix(std::log(a.scale), std::log(b.scale)));
+    params.R = float(mix(a.R, b.R));
+    params.num_it = int(std::lround(mix(a.num_it, b.num_it)));
+    return params;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "fractal_cpu.h"
+
+// View and fractal at a point in time of an animation.
+struct Keyframe {
+    double time = 0;  // seconds
+    double translation[2] = {0, 0};
+    double scale = 0.5;
+    float cvec[2] = {0, 0};
+    float R = 0;
+    int num_it = 0;
+};
+
+// One keyframe per line, "time x y scale c_re c_im R numit", times increasing.
+// Empty lines and lines starting with # are skipped.
+std::vector<Keyframe> parse_keyframes(const std::string& path);
+
+// base with the view and the fractal at time, between the two keyframes around it:
+// scale is interpolated geometrically (constant zoom speed), the rest linearly, numit
+// rounded. Times outside the keyframes are clamped.
+FractalParams interpolate_keyframes(const std::vector<Keyframe>& keyframes, double time, const FractalParams& base);
@@ -1,6 +1,10 @@
 #include <iostream>
+#include <memory>
 #include <vector>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <future>
 
 #include <fmt/format.h>
 
@@ -18,9 +22,18 @@
 #include <glm/gtc/constants.hpp>
 
 #include "opengl_shader.h"
+#include "antialias.h"
+#include "atlas.h"
+#include "fractal_cpu.h"
+#include "deep_zoom.h"
+#include "headless.h"
+#include "tile_cache.h"
+#include "tile_render.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
 
 static void glfw_error_callback(int error, const char *description) {
     std::cerr << fmt::format("Glfw Error {}: {}\n", error, description);
@@ -140,6 +153,10 @@ public:
         y = 1 - 2 * y;
     }
 
+    void get_framebuffer_size(int& width, int& height) {
+        glfwGetFramebufferSize(window, &width, &height);
+    }
+
     GLFWwindow* get_window() {
         return window;
     }
@@ -255,19 +272,773 @@ public:
 
 class Fractal {
 private:
-    GLuint vbo, ebo, vao;
+    static const int orbit_texture_width = 1024;
 
-    shader_t fractal_shader;
+    GLuint vbo, ebo, vao;
+    GLuint orbit_texture;
+
+    // iteration buffers, colored by color_shader every frame. Two of them, so that
+    // panning can copy the still visible part from the previous one.
+    GLuint iterations_fbo[2], iterations_texture[2];
+    int current = 0;
+    int iterations_width = 0, iterations_height = 0;
+
+    // float, fp64 and compute iteration shaders are built for kernel_variant by
+    // buildKernelShaders, double-float and deep zoom are z^2 only
+    std::unique_ptr<shader_t> fractal_shader;
+    shader_t color_shader;
+    KernelVariant kernel_variant;
+
+    // Precision::Double and DoubleFloat, the fp64 one is null without ARB_gpu_shader_fp64
+    std::unique_ptr<shader_t> fp64_shader;
+    shader_t df_shader;
+    bool has_fp64 = false;
+
+    // Mariani-Silver compute path, null without compute shaders
+    std::unique_ptr<shader_t> subdivide_shader;
+    bool has_compute = false;
+    bool subdivide = false;
+
+    // gpu time of the last timed iteration pass
+    GLuint timer_query;
+    bool timer_pending = false;
+    double iteration_ms = 0;
+
+    // gpu time per recomputed pixel of the last timed pass in any mode, 0 until measured
+    double last_pixel_ns = 0;
+
+    // gpu time per recomputed pixel in every precision, 0 until measured. Deep
+    // and compute passes do not count.
+    double pixel_ns[3] = {0, 0, 0};
+    int timed_precision = -1;
+    long long timed_pixels = 0;
+
+    FractalParams params;
+    float palette_offset = 0, palette_repeat = 1;
+
+    bool deep = false;
+    DeepView deep_view;
+    ReferenceOrbit orbit;
+    double orbit_seconds = 0;
+
+    // what the current orbit was computed for, the view may have moved away since
+    bool orbit_valid = false;
+    DeepView orbit_view;
+    FractalParams orbit_params;
+
+    // the orbit for where the view moved, computed on a worker while the current one
+    // is drawn with the offset, see updateOrbit
+    struct ComputedOrbit {
+        ReferenceOrbit orbit;
+        double seconds;
+        DeepView view;
+        FractalParams params;
+    };
+    std::future<ComputedOrbit> next_orbit;
+
+    // offset of the view center from the orbit start, in view half widths, past which
+    // the float deltas lose too much and the orbit is computed again
+    static constexpr double max_orbit_offset = 2;
+
+    // what the iteration buffer holds
+    bool iterations_valid = false;
+    bool iterations_deep = false;
+    bool iterations_subdivided = false;
+    bool iterations_cached = false;
+    DeepView iterations_view;
+    FractalParams iterations_params;
+    int iteration_passes = 0, frames = 0;
+
+    bool pan_reprojection = true;
+    long long recomputed_pixels = 0;  // in the last frame
+
+    // f_c evaluations in the iteration buffer: what the plain loop needs and what was done,
+    // read back after every iteration pass while enabled
+    bool iteration_stats = false;
+    long long plain_iterations = 0, done_iterations = 0;
+
+    // in gl window coordinates, y goes up
+    struct Rect {
+        int x, y, w, h;
+    };
 
-    float R = 2, scale = 1, aspect_ratio = 1;
-    float coordinates[2] = {0, 0};
-    float cvec[2] = {0, 0};
-    int num_it = 1;
+    // edge pixels supersampled by the refine pass (refine.glsl) with alpha 1, 0 elsewhere.
+    // Ping-pong like the iteration buffers. The colors depend on the palette.
+    GLuint refine_fbo[2], refined_texture[2];
+    int antialias = 0;  // samples per side, 0 or 1 is off
+    bool refined_valid = false;
+    int refined_samples = 0;
+    float refined_palette[2] = {0, 0};
+    std::vector<Rect> unrefined;  // iterated since the last refine pass
+
+    // samples passed and gpu time of the last timed refine pass
+    GLuint refine_queries[2];
+    bool refine_pending = false;
+    long long refined_pixels = 0;
+    double refine_ms = 0;
+
+    // Dynamic resolution: while interacting the iteration buffer is scaled down, so that a
+    // full pass (every scroll step is one) fits the frame budget, and upscaled by the color
+    // pass. Once input stops it doubles every frame back to the window size.
+    static const int max_resolution_level = 6;  // levels are 1/8 .. 1 per side in steps of sqrt(2)
+    int resolution_level = max_resolution_level;
+    bool dynamic_resolution = true;
+    bool interactive = false;
+    double frame_budget_ms = 16;
+
+    // Iteration values resampled from the tile cache, the gpu only iterates tiles that are
+    // missing. Not for deep zoom. Complete once every tile came from its own level or
+    // its children, until then the buffer is composed again whenever tiles arrive.
+    TileCache* tile_cache = nullptr;
+    bool cache_complete = false;
+    uint64_t cache_generation = 0;
+    int cached_tiles = 0, fallback_tiles = 0, missing_tiles = 0;
+
+    // for prefetching where the view is heading
+    std::chrono::steady_clock::time_point compose_time;
+    double compose_translation[2] = {0, 0}, compose_scale = 1;
+    double pan_velocity[2] = {0, 0}, zoom_velocity = 0;  // world units and log scale per second
 
     const Texture& texture;
+
+    static double levelResolution(int level) {
+        return std::pow(2.0, (level - max_resolution_level) / 2.0);
+    }
+
+    void updateResolution(int width, int height) {
+        if (not dynamic_resolution) {
+            resolution_level = max_resolution_level;
+            return;
+        }
+
+        // progressive refinement
+        if (not interactive) {
+            resolution_level = std::min(resolution_level + 2, max_resolution_level);
+            return;
+        }
+
+        if (last_pixel_ns <= 0)
+            return;
+
+        auto full_pass_ms = [&](int level) {
+            double r = levelResolution(level);
+            return last_pixel_ns * (width * r) * (height * r) / 1e6;
+        };
+
+        // up only with some margin, every change costs a full pass and ends pan reprojection
+        while (resolution_level > 0 and full_pass_ms(resolution_level) > frame_budget_ms)
+            resolution_level -= 1;
+        if (resolution_level < max_resolution_level and full_pass_ms(resolution_level + 1) < 0.75 * frame_budget_ms)
+            resolution_level += 1;
+    }
+
+    static bool sameIterations(const FractalParams& a, const FractalParams& b) {
+        return a.translation[0] == b.translation[0] and a.translation[1] == b.translation[1]
+            and a.scale == b.scale and a.aspect_ratio == b.aspect_ratio
+            and a.cvec[0] == b.cvec[0] and a.cvec[1] == b.cvec[1]
+            and a.R == b.R and a.num_it == b.num_it and a.periodicity == b.periodicity
+            and a.precision == b.precision and a.variant == b.variant;
+    }
+
+    bool iterationsChanged() const {
+        if (not iterations_valid or iterations_deep != deep or not sameIterations(iterations_params, params)
+            or iterations_subdivided != useSubdivision() or iterations_cached != useTileCache())
+            return true;
+
+        return deep and (iterations_view.scale != deep_view.scale
+                         or iterations_view.center[0] != deep_view.center[0]
+                         or iterations_view.center[1] != deep_view.center[1]);
+    }
+
+    void resizeIterations(int width, int height) {
+        if (width == iterations_width and height == iterations_height)
+            return;
+
+        for (GLuint tex: iterations_texture) {
+            glBindTexture(GL_TEXTURE_2D, tex);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32I, width, height, 0, GL_RG_INTEGER, GL_INT, nullptr);
+        }
+
+        for (GLuint tex: refined_texture) {
+            glBindTexture(GL_TEXTURE_2D, tex);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+
+        iterations_width = width;
+        iterations_height = height;
+        iterations_valid = false;
+        refined_valid = false;
+    }
+
+    // Pixel shift between the iteration buffer and the current view when only the
+    // position changed, the new pixel (x, y) is the old (x + shift_x, y + shift_y).
+    bool panShift(int& shift_x, int& shift_y) const {
+        if (not iterations_valid or not pan_reprojection or iterations_deep != deep
+            or iterations_subdivided != useSubdivision() or iterations_cached)
+            return false;
+
+        FractalParams old_params = iterations_params;
+        std::copy(params.translation, params.translation + 2, old_params.translation);
+        if (not sameIterations(old_params, params) or (deep and iterations_view.scale != deep_view.scale))
+            return false;
+
+        // same for x and y, as y is scaled by the aspect ratio
+        double pixels_per_unit = (deep ? deep_view.scale : params.scale) * iterations_width / 2;
+        double dx, dy;
+        if (deep) {
+            dx = (deep_view.center[0] - iterations_view.center[0]).to_double();
+            dy = (deep_view.center[1] - iterations_view.center[1]).to_double();
+        } else {
+            dx = params.translation[0] - iterations_params.translation[0];
+            dy = params.translation[1] - iterations_params.translation[1];
+        }
+
+        dx *= pixels_per_unit, dy *= pixels_per_unit;
+        if (std::abs(dx) >= iterations_width or std::abs(dy) >= iterations_height)
+            return false;
+
+        shift_x = int(std::lround(dx));
+        shift_y = int(std::lround(dy));
+        return true;
+    }
+
+    // Moves the view to exactly shift_x, shift_y pixels from the iteration buffer, so that
+    // old pixels stay valid. The picture lags the pointer by less than a pixel.
+    void snapToPixels(int shift_x, int shift_y) {
+        double pixels_per_unit = (deep ? deep_view.scale : params.scale) * iterations_width / 2;
+
+        if (deep) {
+            int prec = BigFixed::limbs_for_scale(deep_view.scale);
+            deep_view.center[0] = iterations_view.center[0] + BigFixed(shift_x / pixels_per_unit, prec);
+            deep_view.center[1] = iterations_view.center[1] + BigFixed(shift_y / pixels_per_unit, prec);
+            params.translation[0] = deep_view.center[0].to_double();
+            params.translation[1] = deep_view.center[1].to_double();
+        } else {
+            params.translation[0] = iterations_params.translation[0] + shift_x / pixels_per_unit;
+            params.translation[1] = iterations_params.translation[1] + shift_y / pixels_per_unit;
+        }
+    }
+
+    // copies the part still on screen and iterates only the exposed strips
+    void reprojectIterations(int shift_x, int shift_y) {
+        const int w = iterations_width, h = iterations_height;
+        int next = 1 - current;
+
+        int src_x0 = std::max(0, shift_x), src_x1 = std::min(w, w + shift_x);
+        int src_y0 = std::max(0, shift_y), src_y1 = std::min(h, h + shift_y);
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, iterations_fbo[current]);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, iterations_fbo[next]);
+        glBlitFramebuffer(src_x0, src_y0, src_x1, src_y1,
+                          src_x0 - shift_x, src_y0 - shift_y, src_x1 - shift_x, src_y1 - shift_y,
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+        if (refined_valid) {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, refine_fbo[current]);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, refine_fbo[next]);
+            glBlitFramebuffer(src_x0, src_y0, src_x1, src_y1,
+                              src_x0 - shift_x, src_y0 - shift_y, src_x1 - shift_x, src_y1 - shift_y,
+                              GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        current = next;
+
+        // full height columns first, then rows between them
+        std::vector<Rect> exposed;
+        int kept_x0 = src_x0 - shift_x, kept_x1 = src_x1 - shift_x;
+        if (kept_x0 > 0)
+            exposed.push_back(Rect {0, 0, kept_x0, h});
+        if (kept_x1 < w)
+            exposed.push_back(Rect {kept_x1, 0, w - kept_x1, h});
+
+        int kept_y0 = src_y0 - shift_y, kept_y1 = src_y1 - shift_y;
+        if (kept_y0 > 0)
+            exposed.push_back(Rect {kept_x0, 0, kept_x1 - kept_x0, kept_y0});
+        if (kept_y1 < h)
+            exposed.push_back(Rect {kept_x0, kept_y1, kept_x1 - kept_x0, h - kept_y1});
+
+        renderIterations(exposed);
+    }
+
+    bool useSubdivision() const {
+        return subdivide and subdivide_shader and not deep and params.precision == Precision::Float;
+    }
+
+    // the whole buffer at once, work groups of subdivide.cs own 64 x 64 pixels
+    void subdivideIterations() {
+        subdivide_shader->use();
+        subdivide_shader->set_uniform("u_size", iterations_width, iterations_height);
+
+        subdivide_shader->set_uniform("u_translation", float(params.translation[0]), float(params.translation[1]));
+        subdivide_shader->set_uniform("u_scale", float(params.scale));
+        subdivide_shader->set_uniform("u_aspect_ratio", params.aspect_ratio);
+
+        subdivide_shader->set_uniform("u_cvec", params.cvec[0], params.cvec[1]);
+        subdivide_shader->set_uniform("u_R", params.R);
+        subdivide_shader->set_uniform("u_num_it", params.num_it);
+        subdivide_shader->set_uniform("u_periodicity", params.periodicity);
+        subdivide_shader->set_uniform("u_bailout", orbit_bailout(params));
+
+        glBindImageTexture(0, iterations_texture[current], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32I);
+        glDispatchCompute((iterations_width + 63) / 64, (iterations_height + 63) / 64, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+    }
+
+    // the expensive part, only done for the given rects and when something but the palette changes
+    void renderIterations(const std::vector<Rect>& rects) {
+        bool timed = not timer_pending;
+        if (timed)
+            glBeginQuery(GL_TIME_ELAPSED, timer_query);
+
+        long long pixels = recomputed_pixels;
+
+        if (useSubdivision() and rects.size() == 1 and rects[0].w == iterations_width
+            and rects[0].h == iterations_height) {
+            subdivideIterations();
+            recomputed_pixels = (long long)iterations_width * iterations_height;
+        } else {
+            fragmentIterations(rects);
+        }
+
+        if (timed) {
+            glEndQuery(GL_TIME_ELAPSED);
+            timer_pending = true;
+            timed_precision = deep or useSubdivision() ? -1 : int(params.precision);
+            timed_pixels = recomputed_pixels - pixels;
+        }
+
+        iterated(rects);
+    }
+
+    // the rects of the iteration buffer now hold the current view
+    void iterated(const std::vector<Rect>& rects) {
+        iterations_valid = true;
+        iterations_deep = deep;
+        iterations_subdivided = useSubdivision();
+        iterations_cached = useTileCache();
+        iterations_view = deep_view;
+        iterations_params = params;
+        iteration_passes += 1;
+        unrefined.insert(unrefined.end(), rects.begin(), rects.end());
+    }
+
+    int cacheLevel() const {
+        return tile_level(params.scale, iterations_width);
+    }
+
+    bool useTileCache() const {
+        return tile_cache and not deep and cacheLevel() <= MAX_CACHE_LEVEL;
+    }
+
+    // the tiles this view needs now first, then a guard band, where the view is heading
+    // in half a second and the parents for zooming out
+    void prefetchTiles(int level) {
+        auto now = std::chrono::steady_clock::now();
+        double dt = std::chrono::duration<double>(now - compose_time).count();
+        if (dt > 0.5) {
+            pan_velocity[0] = pan_velocity[1] = zoom_velocity = 0;
+        } else if (dt > 0) {
+            // smoothed, frames with and without input alternate while dragging
+            const double a = 0.5;
+            for (int i = 0; i < 2; ++i)
+                pan_velocity[i] = a * pan_velocity[i] + (1 - a) * (params.translation[i] - compose_translation[i]) / dt;
+            zoom_velocity = a * zoom_velocity + (1 - a) * std::log(params.scale / compose_scale) / dt;
+        }
+        compose_time = now;
+        std::copy(params.translation, params.translation + 2, compose_translation);
+        compose_scale = params.scale;
+
+        const double lookahead = 0.5;
+        FractalParams ahead = params;
+        for (int i = 0; i < 2; ++i)
+            ahead.translation[i] += pan_velocity[i] * lookahead;
+        ahead.scale *= std::exp(zoom_velocity * lookahead);
+        int ahead_level = tile_level(ahead.scale, iterations_width);
+
+        std::vector<TileKey> keys = view_tiles(params, level, 0);
+        if (ahead_level <= MAX_CACHE_LEVEL) {
+            auto more = view_tiles(ahead, ahead_level, 0);
+            keys.insert(keys.end(), more.begin(), more.end());
+        }
+        auto guard = view_tiles(params, level, 1);
+        keys.insert(keys.end(), guard.begin(), guard.end());
+        if (level > 0) {
+            auto parents = view_tiles(params, level - 1, 0);
+            keys.insert(keys.end(), parents.begin(), parents.end());
+        }
+
+        tile_cache->request(keys);
+    }
+
+    // where a tile of the view gets its values from
+    struct TileSource {
+        int level = -1;   // -1: missing, iterated on the gpu
+        int x = 0, y = 0;  // of the source tile, the top left child for children
+        TileData data[4];  // one tile, or the 2 x 2 children
+    };
+
+    TileSource findSource(int level, int x, int y) {
+        TileSource source;
+        if (TileData data = tile_cache->find(tile_key(params, level, x, y))) {
+            source.level = level, source.x = x, source.y = y;
+            source.data[0] = data;
+            return source;
+        }
+
+        if (level < MAX_CACHE_LEVEL) {
+            TileData children[4];
+            bool all = true;
+            for (int i = 0; i < 4 and all; ++i)
+                all = bool(children[i] = tile_cache->find(tile_key(params, level + 1, 2 * x + i % 2, 2 * y + i / 2)));
+            if (all) {
+                source.level = level + 1, source.x = 2 * x, source.y = 2 * y;
+                std::copy(children, children + 4, source.data);
+                return source;
+            }
+        }
+
+        for (int l = level - 1; l >= 0; --l) {
+            int shift = level - l;
+            if (TileData data = tile_cache->find(tile_key(params, l, x >> shift, y >> shift))) {
+                source.level = l, source.x = x >> shift, source.y = y >> shift;
+                source.data[0] = data;
+                return source;
+            }
+        }
+        return source;
+    }
+
+    // Fills the iteration buffer from the cache (nearest sample of the closest finer or equal
+    // level) and iterates only missing tiles. The y channel, evaluations, is 0 for cached pixels.
+    void composeFromCache() {
+        const int w = iterations_width, h = iterations_height;
+        const int level = cacheLevel();
+        const double tiles = std::ldexp(1.0, level);
+        cache_generation = tile_cache->generation();
+
+        // u, v of pixel centers in tiles of level from the top left of the quad, same
+        // world coordinates as world_x and world_y in fractal_cpu.cpp
+        std::vector<double> u(w), v(h);
+        for (int x = 0; x < w; ++x)
+            u[x] = (((2 * x + 1) / double(w) - 1) / params.scale + params.translation[0] + 1) / 2 * tiles;
+        for (int y = 0; y < h; ++y)
+            v[y] = (1 - ((1 - (2 * y + 1) / double(h)) * params.aspect_ratio / params.scale + params.translation[1])) / 2 * tiles;
+
+        auto tile_of = [&](double t) {
+            return t >= 0 and t < tiles ? int(t) : -1;
+        };
+        int tx0 = -1, tx1 = -1, ty0 = -1, ty1 = -1;
+        for (int x = 0; x < w; ++x)
+            if (tile_of(u[x]) >= 0) {
+                tx0 = tx0 < 0 ? tile_of(u[x]) : tx0;
+                tx1 = tile_of(u[x]);
+            }
+        for (int y = 0; y < h; ++y)
+            if (tile_of(v[y]) >= 0) {
+                ty0 = ty0 < 0 ? tile_of(v[y]) : ty0;
+                ty1 = tile_of(v[y]);
+            }
+
+        const int cols = tx0 < 0 ? 0 : tx1 - tx0 + 1, rows = ty0 < 0 ? 0 : ty1 - ty0 + 1;
+        std::vector<TileSource> sources(size_t(cols) * rows);
+        cached_tiles = fallback_tiles = missing_tiles = 0;
+        for (int ty = 0; ty < rows; ++ty)
+            for (int tx = 0; tx < cols; ++tx) {
+                TileSource& source = sources[size_t(ty) * cols + tx];
+                source = findSource(level, tx0 + tx, ty0 + ty);
+                cached_tiles += source.level >= level;
+                fallback_tiles += source.level >= 0 and source.level < level;
+                missing_tiles += source.level < 0;
+            }
+        cache_complete = fallback_tiles == 0 and missing_tiles == 0;
+
+        // gl rows go bottom to top
+        std::vector<GLint> data(size_t(w) * h * 2, 0);
+        run_work_stealing(h, default_thread_count(), [&](int y, int) {
+            GLint* row = data.data() + size_t(h - 1 - y) * w * 2;
+            int ty = tile_of(v[y]);
+            for (int x = 0; x < w; ++x) {
+                int tx = tile_of(u[x]);
+                int value = ITER_OUTSIDE;
+                if (tx >= 0 and ty >= 0) {
+                    const TileSource& source = sources[size_t(ty - ty0) * cols + tx - tx0];
+                    if (source.level >= 0) {
+                        double k = std::ldexp(1.0, source.level - level);
+                        double su = u[x] * k, sv = v[y] * k;
+                        int sx = source.x, sy = source.y;
+                        if (source.level > level) {
+                            sx = std::max(source.x, std::min(int(su), source.x + 1));
+                            sy = std::max(source.y, std::min(int(sv), source.y + 1));
+                        }
+                        const TileData& tile = source.data[(sx - source.x) + 2 * (sy - source.y)];
+                        int px = std::max(0, std::min(int((su - sx) * CACHE_TILE_SIZE), CACHE_TILE_SIZE - 1));
+                        int py = std::max(0, std::min(int((sv - sy) * CACHE_TILE_SIZE), CACHE_TILE_SIZE - 1));
+                        value = (*tile)[size_t(py) * CACHE_TILE_SIZE + px];
+                    }
+                }
+                row[2 * x] = value;
+            }
+        });
+
+        glBindTexture(GL_TEXTURE_2D, iterations_texture[current]);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_RG_INTEGER, GL_INT, data.data());
+
+        // screen rects of missing tiles, u and v only grow with x and y
+        std::vector<Rect> missing;
+        for (int ty = 0; ty < rows; ++ty)
+            for (int tx = 0; tx < cols; ++tx) {
+                if (sources[size_t(ty) * cols + tx].level >= 0)
+                    continue;
+
+                int x0 = 0, x1 = 0, y0 = 0, y1 = 0;
+                while (x0 < w and tile_of(u[x0]) != tx0 + tx) ++x0;
+                for (x1 = x0; x1 < w and tile_of(u[x1]) == tx0 + tx; ++x1);
+                while (y0 < h and tile_of(v[y0]) != ty0 + ty) ++y0;
+                for (y1 = y0; y1 < h and tile_of(v[y1]) == ty0 + ty; ++y1);
+                missing.push_back(Rect {x0, h - y1, x1 - x0, y1 - y0});
+            }
+        if (not missing.empty())
+            fragmentIterations(missing);
+
+        prefetchTiles(level);
+        iterated({Rect {0, 0, w, h}});
+    }
+
+    void fragmentIterations(const std::vector<Rect>& rects) {
+        glBindFramebuffer(GL_FRAMEBUFFER, iterations_fbo[current]);
+        glEnable(GL_SCISSOR_TEST);
+
+        const GLint outside[] = {ITER_OUTSIDE, 0, 0, 0};
+        for (const Rect& r: rects) {
+            glScissor(r.x, r.y, r.w, r.h);
+            glClearBufferiv(GL_COLOR, 0, outside);
+            recomputed_pixels += (long long)r.w * r.h;
+        }
+
+        useIterationShader();
+
+        glBindVertexArray(vao);
+        for (const Rect& r: rects) {
+            glScissor(r.x, r.y, r.w, r.h);
+            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        }
+        glBindVertexArray(0);
+
+        glDisable(GL_SCISSOR_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // Supersamples the edge pixels in rects, grown by a pixel as their neighbours changed
+    // too. Uses the shader and uniforms of the iteration pass.
+    void refineIterations(const std::vector<Rect>& rects) {
+        bool timed = not refine_pending;
+        if (timed) {
+            glBeginQuery(GL_SAMPLES_PASSED, refine_queries[0]);
+            glBeginQuery(GL_TIME_ELAPSED, refine_queries[1]);
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, refine_fbo[current]);
+        glEnable(GL_SCISSOR_TEST);
+
+        std::vector<Rect> grown;
+        const GLfloat unrefined_color[] = {0, 0, 0, 0};
+        for (const Rect& r: rects) {
+            int x0 = std::max(r.x - 1, 0), y0 = std::max(r.y - 1, 0);
+            int x1 = std::min(r.x + r.w + 1, iterations_width), y1 = std::min(r.y + r.h + 1, iterations_height);
+            grown.push_back(Rect {x0, y0, x1 - x0, y1 - y0});
+
+            glScissor(x0, y0, x1 - x0, y1 - y0);
+            glClearBufferfv(GL_COLOR, 1, unrefined_color);
+        }
+
+        shader_t& shader = useIterationShader();
+        shader.set_uniform("u_refine", true);
+        shader.set_uniform("u_refine_samples", antialias);
+        shader.set_uniform("u_max_value", max_value(params));
+        shader.set_uniform("u_iterations", 2);
+        shader.set_uniform("grad", 0);
+        shader.set_uniform("u_palette_offset", palette_offset);
+        shader.set_uniform("u_palette_repeat", palette_repeat);
+
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, iterations_texture[current]);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texture.get());
+
+        glBindVertexArray(vao);
+        for (const Rect& r: grown) {
+            glScissor(r.x, r.y, r.w, r.h);
+            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        }
+        glBindVertexArray(0);
+
+        glDisable(GL_SCISSOR_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        if (timed) {
+            glEndQuery(GL_TIME_ELAPSED);
+            glEndQuery(GL_SAMPLES_PASSED);
+            refine_pending = true;
+        }
+
+        refined_valid = true;
+        refined_samples = antialias;
+        refined_palette[0] = palette_offset;
+        refined_palette[1] = palette_repeat;
+    }
+
+    // binds the iteration shader of the current mode and sets everything it needs
+    shader_t& useIterationShader() {
+        shader_t& shader = deep ? *fractal_shader : precisionShader(params.precision);
+        shader.use();
+        shader.set_uniform("u_refine", false);
+
+        shader.set_uniform("u_translation", float(params.translation[0]), float(params.translation[1]));
+        shader.set_uniform("u_scale", float(params.scale));
+        shader.set_uniform("u_aspect_ratio", params.aspect_ratio);
+
+        shader.set_uniform("u_cvec", params.cvec[0], params.cvec[1]);
+        shader.set_uniform("u_R", params.R);
+        shader.set_uniform("u_num_it", params.num_it);
+        shader.set_uniform("u_periodicity", params.periodicity);
+        shader.set_uniform("u_bailout", orbit_bailout(params));
+
+        // fullscreen for all but the float shader, see frac-shader.vs
+        shader.set_uniform("u_deep", deep or params.precision != Precision::Float);
+        shader.set_uniform("u_size", float(iterations_width), float(iterations_height));
+
+        if (not deep and params.precision == Precision::Double) {
+            shader.set_uniform("u_translation_d", params.translation[0], params.translation[1]);
+            shader.set_uniform("u_scale_d", params.scale);
+        } else if (not deep and params.precision == Precision::DoubleFloat) {
+            float hi[2], lo[2];
+            for (int i = 0; i < 2; ++i) {
+                hi[i] = float(params.translation[i]);
+                lo[i] = float(params.translation[i] - hi[i]);
+            }
+            shader.set_uniform("u_translation_hi", hi[0], hi[1]);
+            shader.set_uniform("u_translation_lo", lo[0], lo[1]);
+        }
+
+        if (deep) {
+            glActiveTexture(GL_TEXTURE1);
+            updateOrbit();
+            glBindTexture(GL_TEXTURE_2D, orbit_texture);
+            glActiveTexture(GL_TEXTURE0);
+
+            float mantissa, exponent;
+            split_inv_scale(deep_view.scale, mantissa, exponent);
+
+            shader.set_uniform("u_orbit", 1);
+            shader.set_uniform("u_orbit_len", orbit.length());
+            shader.set_uniform("u_orbit_width", orbit_texture_width);
+            shader.set_uniform("u_delta_mant", mantissa);
+            shader.set_uniform("u_delta_exp", exponent);
+
+            float offset[2];
+            orbit_offset(deep_view, orbit, exponent, offset[0], offset[1]);
+            shader.set_uniform("u_orbit_offset", offset[0], offset[1]);
+        }
+
+        return shader;
+    }
+
+    // the refine pass is part of every iteration shader
+    static std::vector<std::string> iterationShaderFiles(const std::string& main_file) {
+        return {main_file, "palette.glsl", "refine.glsl"};
+    }
+
+    shader_t& precisionShader(Precision precision) {
+        if (precision == Precision::Double and fp64_shader)
+            return *fp64_shader;
+        if (precision != Precision::Float)
+            return df_shader;
+        return *fractal_shader;
+    }
+
+    void buildKernelShaders(const KernelVariant& variant) {
+        fractal_shader.reset(new shader_t("frac-shader.vs", iterationShaderFiles("frac-shader.fs"),
+                                          kernel_glsl(variant, "float")));
+        if (has_compute)
+            subdivide_shader.reset(new shader_t(std::vector<std::string> {"subdivide.cs"}, kernel_glsl(variant, "float")));
+        if (has_fp64)
+            fp64_shader.reset(new shader_t("frac-shader.vs", iterationShaderFiles("frac-shader-fp64.fs"),
+                                           kernel_glsl(variant, "double")));
+        kernel_variant = variant;
+    }
+
+    static bool sameOrbitParams(const FractalParams& a, const FractalParams& b) {
+        return a.cvec[0] == b.cvec[0] and a.cvec[1] == b.cvec[1] and a.R == b.R and a.num_it == b.num_it;
+    }
+
+    // an orbit of another c, R or iteration count can not be drawn at all
+    bool orbitUsable() const {
+        return orbit_valid and sameOrbitParams(orbit_params, params);
+    }
+
+    // Still drawn, but worth computing again: not precise enough for the scale, the view
+    // moved too far from the orbit start, or it moved and the orbit escapes early, which
+    // rebases the pixels against the start over and over and glitches.
+    bool orbitOutdated() const {
+        if (BigFixed::limbs_for_scale(orbit_view.scale) < BigFixed::limbs_for_scale(deep_view.scale))
+            return true;
+
+        double dx = (deep_view.center[0] - orbit.center[0]).to_double() * deep_view.scale;
+        double dy = (deep_view.center[1] - orbit.center[1]).to_double() * deep_view.scale;
+        if (std::max(std::abs(dx), std::abs(dy)) > max_orbit_offset)
+            return true;
+        return (dx != 0 or dy != 0) and orbit.length() <= params.num_it;
+    }
+
+    std::future<ComputedOrbit> computeOrbitAsync() const {
+        return std::async(std::launch::async, [view = deep_view, params = params]() {
+            auto start = std::chrono::steady_clock::now();
+            ReferenceOrbit orbit = compute_reference_orbit(view, params);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return ComputedOrbit {std::move(orbit), seconds, view, params};
+        });
+    }
+
+    // Panning and zooming keep drawing the current orbit with the offset of the view.
+    // An outdated one is computed again on a worker and swapped in when it is done, only
+    // without a usable one the frame waits for it.
+    void updateOrbit() {
+        if (next_orbit.valid() and (not orbitUsable()
+                                    or next_orbit.wait_for(std::chrono::seconds(0)) == std::future_status::ready)) {
+            ComputedOrbit computed = next_orbit.get();
+            if (sameOrbitParams(computed.params, params))
+                setOrbit(std::move(computed));
+        }
+
+        if (orbitUsable() and not orbitOutdated())
+            return;
+        if (not next_orbit.valid())
+            next_orbit = computeOrbitAsync();
+        if (not orbitUsable())
+            setOrbit(next_orbit.get());
+    }
+
+    void setOrbit(ComputedOrbit&& computed) {
+        orbit = std::move(computed.orbit);
+        orbit_seconds = computed.seconds;
+
+        orbit_valid = true;
+        orbit_view = computed.view;
+        orbit_params = computed.params;
+
+        int rows = (orbit.length() + orbit_texture_width - 1) / orbit_texture_width;
+        std::vector<float> data(size_t(rows) * orbit_texture_width * 2, 0);
+        std::copy(orbit.points.begin(), orbit.points.end(), data.begin());
+
+        glBindTexture(GL_TEXTURE_2D, orbit_texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, orbit_texture_width, rows, 0, GL_RG, GL_FLOAT, data.data());
+    }
     
 public:
-    Fractal(const Texture& texture): fractal_shader("frac-shader.vs", "frac-shader.fs"), texture(texture) {
+    Fractal(const Texture& texture)
+        : color_shader("color-shader.vs", std::vector<std::string> {"color-shader.fs", "palette.glsl"}),
+          df_shader("frac-shader.vs", iterationShaderFiles("frac-shader-df.fs")), texture(texture) {
         float vertices[] = {
             -1, -1, 0, // left-btm
             -1, +1, 0,
@@ -292,54 +1063,716 @@ public:
 
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         glBindVertexArray(0);
+
+        // reference orbit, read with texelFetch only
+        glGenTextures(1, &orbit_texture);
+        glBindTexture(GL_TEXTURE_2D, orbit_texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        // integer textures can not be filtered
+        glGenTextures(2, iterations_texture);
+        for (GLuint tex: iterations_texture) {
+            glBindTexture(GL_TEXTURE_2D, tex);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+        glGenTextures(2, refined_texture);
+        for (GLuint tex: refined_texture) {
+            glBindTexture(GL_TEXTURE_2D, tex);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+        resizeIterations(1, 1);
+
+        glGenFramebuffers(2, iterations_fbo);
+        for (int i = 0; i < 2; ++i) {
+            glBindFramebuffer(GL_FRAMEBUFFER, iterations_fbo[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, iterations_texture[i], 0);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                throw std::runtime_error("iteration framebuffer is incomplete");
+        }
+
+        // o_color of the iteration shaders goes to attachment 1, the iteration buffer is read as a texture
+        const GLenum refine_buffers[] = {GL_NONE, GL_COLOR_ATTACHMENT1};
+        glGenFramebuffers(2, refine_fbo);
+        for (int i = 0; i < 2; ++i) {
+            glBindFramebuffer(GL_FRAMEBUFFER, refine_fbo[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, refined_texture[i], 0);
+            glDrawBuffers(2, refine_buffers);
+            glReadBuffer(GL_COLOR_ATTACHMENT1);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                throw std::runtime_error("refine framebuffer is incomplete");
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        glGenQueries(1, &timer_query);
+        glGenQueries(2, refine_queries);
+
+        // compute shaders are 4.3, the window asks for 3.3 only
+        has_compute = GLEW_ARB_compute_shader and GLEW_ARB_shader_image_load_store;
+        has_fp64 = GLEW_ARB_gpu_shader_fp64;
+        buildKernelShaders(kernel_variant);
     }
 
+    // iterates only when the view or the fractal changed, then colors the iteration buffer
     void draw() {
-        fractal_shader.set_uniform("u_translation", coordinates[0], coordinates[1]);
-        fractal_shader.set_uniform("u_scale", scale);
-        fractal_shader.set_uniform("u_aspect_ratio", aspect_ratio);
+        if (params.variant != kernel_variant)
+            buildKernelShaders(params.variant);
+
+        if (timer_pending) {
+            GLint available = 0;
+            glGetQueryObjectiv(timer_query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint64 ns = 0;
+                glGetQueryObjectui64v(timer_query, GL_QUERY_RESULT, &ns);
+                iteration_ms = ns / 1e6;
+                timer_pending = false;
+
+                if (timed_pixels > 0)
+                    last_pixel_ns = double(ns) / timed_pixels;
+                if (timed_precision >= 0 and timed_pixels > 0)
+                    pixel_ns[timed_precision] = double(ns) / timed_pixels;
+            }
+        }
 
-        fractal_shader.set_uniform("u_cvec", cvec[0], cvec[1]);
-        fractal_shader.set_uniform("u_R", R);
-        fractal_shader.set_uniform("u_num_it", num_it);
+        if (refine_pending) {
+            GLint available = 0;
+            glGetQueryObjectiv(refine_queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint passed = 0;
+                GLuint64 ns = 0;
+                glGetQueryObjectuiv(refine_queries[0], GL_QUERY_RESULT, &passed);
+                glGetQueryObjectui64v(refine_queries[1], GL_QUERY_RESULT, &ns);
+                refined_pixels = passed;
+                refine_ms = ns / 1e6;
+                refine_pending = false;
+            }
+        }
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        updateResolution(viewport[2], viewport[3]);
+        double r = levelResolution(resolution_level);
+        resizeIterations(std::max(1, int(std::lround(viewport[2] * r))), std::max(1, int(std::lround(viewport[3] * r))));
+        glViewport(0, 0, iterations_width, iterations_height);
+
+        recomputed_pixels = 0;
+        if (useTileCache()) {
+            if (iterationsChanged() or (not cache_complete and tile_cache->generation() != cache_generation))
+                composeFromCache();
+        } else if (iterationsChanged()) {
+            int passes = iteration_passes;
+            int shift_x, shift_y;
+            if (panShift(shift_x, shift_y)) {
+                snapToPixels(shift_x, shift_y);
+                if (shift_x != 0 or shift_y != 0)
+                    reprojectIterations(shift_x, shift_y);
+            } else {
+                renderIterations({Rect {0, 0, iterations_width, iterations_height}});
+            }
+
+            if (iteration_stats and passes != iteration_passes)
+                updateIterationStats();
+        }
 
+        // edges are refined at full resolution only
+        if (antialias > 1 and isFullResolution()) {
+            if (not refined_valid or refined_samples != antialias or refined_palette[0] != palette_offset
+                or refined_palette[1] != palette_repeat)
+                unrefined = {Rect {0, 0, iterations_width, iterations_height}};
+            if (not unrefined.empty())
+                refineIterations(unrefined);
+        } else {
+            refined_valid = false;
+        }
+        unrefined.clear();
+        frames += 1;
+
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+        color_shader.use();
+        color_shader.set_uniform("u_iterations", 2);
+        color_shader.set_uniform("grad", 0);
+        color_shader.set_uniform("u_max_value", max_value(iterations_params));
+        color_shader.set_uniform("u_palette_offset", palette_offset);
+        color_shader.set_uniform("u_palette_repeat", palette_repeat);
+        color_shader.set_uniform("u_antialias", antialias > 1 and isFullResolution());
+        color_shader.set_uniform("u_viewport", float(viewport[2]), float(viewport[3]));
+        color_shader.set_uniform("u_refined", 3);
+
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, refined_texture[current]);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, iterations_texture[current]);
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, texture.get());
         
-        fractal_shader.use();
         glBindVertexArray(vao);
         glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
         glBindVertexArray(0);
     }
 
-    void setPosition(float x0, float y0, float scale, float aspect_ratio) {
-        coordinates[0] = x0;
-        coordinates[1] = y0;
+    // iteration buffer of the last draw(), top row first like iterate_region
+    void updateIterationStats() {
+        std::vector<GLint> data(size_t(iterations_width) * iterations_height * 2);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, iterations_fbo[current]);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, iterations_width, iterations_height, GL_RG_INTEGER, GL_INT, data.data());
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+        plain_iterations = done_iterations = 0;
+        for (size_t i = 0; i < data.size(); i += 2) {
+            int value = data[i];
+            plain_iterations += value == ITER_NEVER ? iterations_params.num_it
+                                                    : std::max(iteration_of_value(iterations_params.variant, value), 0);
+            done_iterations += data[i + 1];
+        }
+    }
 
-        this->scale = scale;
-        this->aspect_ratio = aspect_ratio;
+    void readIterations(std::vector<int>& out, int& width, int& height) const {
+        width = iterations_width, height = iterations_height;
+        out.resize(size_t(width) * height);
+
+        std::vector<int> rows(out.size());
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, iterations_fbo[current]);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, width, height, GL_RED_INTEGER, GL_INT, rows.data());
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+        // gl rows go bottom to top
+        for (int y = 0; y < height; ++y)
+            std::copy(rows.begin() + size_t(height - 1 - y) * width, rows.begin() + size_t(height - y) * width,
+                      out.begin() + size_t(y) * width);
     }
 
-    void setParameters(float c_real, float c_imag, float r, int num_it) {
-        cvec[0] = c_real;
-        cvec[1] = c_imag;
-        R = r;
-        this->num_it = num_it;
+    // palette only, does not cause iterating
+    void setPalette(float offset, float repeat) {
+        palette_offset = offset;
+        palette_repeat = repeat;
+    }
+
+    int getIterationPasses() const {
+        return iteration_passes;
+    }
+
+    int getFrames() const {
+        return frames;
+    }
+
+    // reuse the iteration buffer when only the position changes
+    void setPanReprojection(bool enabled) {
+        pan_reprojection = enabled;
+    }
+
+    long long getRecomputedPixels() const {
+        return recomputed_pixels;
+    }
+
+    void setIterationStats(bool enabled) {
+        if (enabled and not iteration_stats and iterations_valid)
+            updateIterationStats();
+        iteration_stats = enabled;
+    }
+
+    void getIterationStats(long long& plain, long long& done) const {
+        plain = plain_iterations;
+        done = done_iterations;
+    }
+
+    // Mariani-Silver for full iteration passes, not for deep zoom
+    void setSubdivision(bool enabled) {
+        subdivide = enabled;
+    }
+
+    bool hasSubdivision() const {
+        return bool(subdivide_shader);
+    }
+
+    double getIterationMs() const {
+        return iteration_ms;
+    }
+
+    // the pointer drags or zooms, or a ui control is being changed
+    void setInteractive(bool enabled) {
+        interactive = enabled;
+    }
+
+    void setDynamicResolution(bool enabled, double budget_ms) {
+        dynamic_resolution = enabled;
+        frame_budget_ms = budget_ms;
+    }
+
+    // the iteration buffer matches the window, also after progressive refinement finished
+    bool isFullResolution() const {
+        return resolution_level == max_resolution_level;
+    }
+
+    // null turns the cache off
+    void setTileCache(TileCache* cache) {
+        tile_cache = cache;
+    }
+
+    // tiles of the last composed view: from the cache, from a coarser level and iterated
+    void getCacheTiles(int& cached, int& fallback, int& missing) const {
+        cached = cached_tiles, fallback = fallback_tiles, missing = missing_tiles;
+    }
+
+    void getIterationSize(int& width, int& height) const {
+        width = iterations_width, height = iterations_height;
+    }
+
+    // edge supersampling with samples x samples per edge pixel, 0 or 1 is off
+    void setAntialias(int samples) {
+        antialias = samples;
+    }
+
+    int getAntialias() const {
+        return antialias;
+    }
+
+    // of the last timed refine pass
+    long long getRefinedPixels() const {
+        return refined_pixels;
+    }
+
+    double getRefineMs() const {
+        return refine_ms;
+    }
+
+    void setPosition(double x0, double y0, double scale, float aspect_ratio) {
+        params.translation[0] = x0;
+        params.translation[1] = y0;
+
+        params.scale = scale;
+        params.aspect_ratio = aspect_ratio;
+    }
+
+    // deep zoom uses this view instead of translation and scale of setPosition,
+    // they are still used (approximately) to cut the fractal quad
+    void setDeepView(bool enabled, const DeepView& view) {
+        deep = enabled;
+        deep_view = view;
+    }
+
+    // Double falls back to DoubleFloat without ARB_gpu_shader_fp64, so that the cpu
+    // comparison uses what the gpu does
+    void setPrecision(Precision precision) {
+        if (precision == Precision::Double and not fp64_shader)
+            precision = Precision::DoubleFloat;
+        params.precision = precision;
+    }
+
+    // After setPrecision and setDeepView: deep zoom keeps the default variant and
+    // double-float, which is z^2 only, becomes double (or float without fp64).
+    void setVariant(const KernelVariant& variant) {
+        params.variant = deep ? KernelVariant() : variant;
+        if (params.variant != KernelVariant() and params.precision == Precision::DoubleFloat)
+            params.precision = fp64_shader ? Precision::Double : Precision::Float;
+    }
+
+    bool hasNativeDouble() const {
+        return bool(fp64_shader);
+    }
+
+    // auto_precision, but double-float where it is exact enough and measured to be faster
+    // than native double (fp64 is 1/32 rate or less on consumer gpus)
+    Precision autoPrecision(double scale) const {
+        Precision precision = auto_precision(scale, hasNativeDouble());
+        double fp64 = pixel_ns[int(Precision::Double)], df = pixel_ns[int(Precision::DoubleFloat)];
+
+        if (precision == Precision::Double and scale < DOUBLE_FLOAT_SCALE_LIMIT and df > 0 and df < fp64)
+            return Precision::DoubleFloat;
+        return precision;
+    }
+
+    double getPixelNs(Precision precision) const {
+        return pixel_ns[int(precision)];
+    }
+
+    void setParameters(float c_real, float c_imag, float r, int num_it, bool periodicity) {
+        params.cvec[0] = c_real;
+        params.cvec[1] = c_imag;
+        params.R = r;
+        params.num_it = num_it;
+        params.periodicity = periodicity;
+    }
+
+    const FractalParams& getParams() const {
+        return params;
+    }
+
+    bool isDeep() const {
+        return deep;
+    }
+
+    const ReferenceOrbit& getOrbit() const {
+        return orbit;
+    }
+
+    double getOrbitSeconds() const {
+        return orbit_seconds;
+    }
+
+    // the cpu counterpart of what draw() shows, top row first
+    TileIterator cpuIterator(int width, int height) const {
+        if (deep)
+            return [this, width, height](const Tile& t, int* out, int stride) {
+                return iterate_region_deep(params, deep_view, orbit, width, height, t.x0, t.y0, t.x1, t.y1, out, stride);
+            };
+
+        return [this, width, height](const Tile& t, int* out, int stride) {
+            return iterate_region(params, width, height, t.x0, t.y0, t.x1, t.y1, out, stride, best_kernel());
+        };
+    }
+
+    // samples of the refine pass, see refine_edges
+    PixelIterator cpuSampleIterator(int width, int height, int samples) const {
+        if (deep)
+            return [this, width, height, samples](const int* xs, const int* ys, int n, int* out) {
+                return iterate_pixels_deep(params, deep_view, orbit, width * samples, height * samples, xs, ys, n, out);
+            };
+
+        return [this, width, height, samples](const int* xs, const int* ys, int n, int* out) {
+            return iterate_pixels(params, width * samples, height * samples, xs, ys, n, out, best_kernel());
+        };
+    }
+};
+
+// Parameter atlas on the gpu: the overview and every cell in one instanced draw, see
+// atlas.h. Drawn into a texture only when the parameters or the layout change.
+class Atlas {
+private:
+    GLuint vao, vbo, ebo, instance_vbo;
+    GLuint fbo, color_texture;
+    int width = 0, height = 0;
+
+    std::unique_ptr<shader_t> shader;
+    KernelVariant shader_variant;
+
+    const Texture& texture;
+
+    bool valid = false;
+    FractalParams drawn_params;
+    AtlasLayout drawn_layout;
+    float drawn_palette[2] = {0, 1};
+
+    GLuint timer_query;
+    bool timer_pending = false;
+    double draw_ms = 0;
+
+    void buildShader(const KernelVariant& variant) {
+        shader.reset(new shader_t("atlas.vs", std::vector<std::string> {"atlas.fs", "palette.glsl"},
+                                  kernel_glsl(variant, "float")));
+        shader_variant = variant;
+    }
+
+    bool changed(const FractalParams& params, const AtlasLayout& layout, float offset, float repeat) const {
+        return not valid or params.R != drawn_params.R or params.num_it != drawn_params.num_it
+            or params.periodicity != drawn_params.periodicity or params.variant != drawn_params.variant
+            or layout.cols != drawn_layout.cols or layout.rows != drawn_layout.rows
+            or layout.center[0] != drawn_layout.center[0] or layout.center[1] != drawn_layout.center[1]
+            or layout.span != drawn_layout.span or layout.overview != drawn_layout.overview
+            or offset != drawn_palette[0] or repeat != drawn_palette[1];
+    }
+
+    void resize(int w, int h) {
+        if (w == width and h == height)
+            return;
+
+        glBindTexture(GL_TEXTURE_2D, color_texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        width = w, height = h;
+        valid = false;
+    }
+
+    void render(const FractalParams& params, const AtlasLayout& layout, float offset, float repeat) {
+        const AtlasGeometry geometry = atlas_geometry(layout, width, height);
+        const int cells = layout.cols * layout.rows;
+
+        // instance 0 is the overview, its c is not used
+        std::vector<float> cs(size_t(cells + 1) * 2, 0);
+        for (int row = 0; row < layout.rows; ++row)
+            for (int col = 0; col < layout.cols; ++col) {
+                FractalParams cell = atlas_cell_params(params, layout, col, row);
+                size_t k = size_t(row * layout.cols + col + 1) * 2;
+                cs[k] = cell.cvec[0], cs[k + 1] = cell.cvec[1];
+            }
+        glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+        glBufferData(GL_ARRAY_BUFFER, cs.size() * sizeof(float), cs.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        bool timed = not timer_pending;
+        if (timed)
+            glBeginQuery(GL_TIME_ELAPSED, timer_query);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, width, height);
+        // glClearColor in OpenGL::main_loop
+        const float background[] = {0.30f, 0.55f, 0.60f, 1.00f};
+        glClearBufferfv(GL_COLOR, 0, background);
+
+        FractalParams no_c = params;
+        no_c.cvec[0] = no_c.cvec[1] = 0;
+        double step = layout.span / layout.cols;
+
+        shader->use();
+        shader->set_uniform("u_viewport", float(width), float(height));
+        shader->set_uniform("u_cols", layout.cols);
+        shader->set_uniform("u_overview", float(geometry.overview_x), float(geometry.overview_y),
+                            float(geometry.overview_size));
+        shader->set_uniform("u_grid", float(geometry.grid_x), float(geometry.grid_y), float(geometry.cell));
+        shader->set_uniform("u_R", params.R);
+        shader->set_uniform("u_num_it", params.num_it);
+        shader->set_uniform("u_periodicity", params.periodicity);
+        shader->set_uniform("u_escape_radius", orbit_bailout(no_c));
+        shader->set_uniform("u_sweep_min", float(layout.center[0] - layout.span / 2),
+                            float(layout.center[1] - step * layout.rows / 2));
+        shader->set_uniform("u_sweep_max", float(layout.center[0] + layout.span / 2),
+                            float(layout.center[1] + step * layout.rows / 2));
+        shader->set_uniform("u_overview_pixel", float(2 * OVERVIEW_EXTENT / std::max(geometry.overview_size, 1)));
+        shader->set_uniform("u_max_value", max_value(params));
+        shader->set_uniform("grad", 0);
+        shader->set_uniform("u_palette_offset", offset);
+        shader->set_uniform("u_palette_repeat", repeat);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texture.get());
+
+        // without the overview instance 0 is an empty square
+        glBindVertexArray(vao);
+        glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, cells + 1);
+        glBindVertexArray(0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (timed) {
+            glEndQuery(GL_TIME_ELAPSED);
+            timer_pending = true;
+        }
+
+        valid = true;
+        drawn_params = params;
+        drawn_layout = layout;
+        drawn_palette[0] = offset, drawn_palette[1] = repeat;
+    }
+
+public:
+    Atlas(const Texture& texture) : texture(texture) {
+        float vertices[] = {
+            -1, -1, 0,
+            -1, +1, 0,
+            +1, +1, 0,
+            +1, -1, 0
+        };
+        unsigned int indices[] = {0, 1, 2, 2, 3, 0};
+
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+        glGenBuffers(1, &ebo);
+        glGenBuffers(1, &instance_vbo);
+
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+        glEnableVertexAttribArray(0);
+
+        // c of the cell, once per instance
+        glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribDivisor(1, 1);
+
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+
+        glGenTextures(1, &color_texture);
+        glBindTexture(GL_TEXTURE_2D, color_texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        width = height = 1;
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color_texture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            throw std::runtime_error("atlas framebuffer is incomplete");
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        glGenQueries(1, &timer_query);
+        buildShader(shader_variant);
+    }
+
+    Atlas(const Atlas&) = delete;
+    Atlas& operator=(const Atlas&) = delete;
+
+    // params gives R, num_it, periodicity and the variant, layout the c of the cells
+    void draw(const FractalParams& params, const AtlasLayout& layout, float palette_offset, float palette_repeat) {
+        if (timer_pending) {
+            GLint available = 0;
+            glGetQueryObjectiv(timer_query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint64 ns = 0;
+                glGetQueryObjectui64v(timer_query, GL_QUERY_RESULT, &ns);
+                draw_ms = ns / 1e6;
+                timer_pending = false;
+            }
+        }
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        resize(viewport[2], viewport[3]);
+
+        if (params.variant != shader_variant) {
+            buildShader(params.variant);
+            valid = false;
+        }
+        if (changed(params, layout, palette_offset, palette_repeat))
+            render(params, layout, palette_offset, palette_repeat);
+
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+        glBlitFramebuffer(0, 0, width, height, viewport[0], viewport[1], viewport[0] + width, viewport[1] + height,
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    }
+
+    // gpu time of the last timed atlas pass
+    double getDrawMs() const {
+        return draw_ms;
     }
 };
 
-int main(int, char **) {
+
+// Reads back what the shader has drawn and compares it with the cpu renderer,
+// both the iteration buffer and the colors (those match with the default palette only),
+// refined edges included.
+std::string compare_with_cpu(const Fractal& fractal, const Gradient& gradient) {
+    std::vector<int> gpu_iterations;
+    int width, height;
+    fractal.readIterations(gpu_iterations, width, height);
+
+    std::vector<unsigned char> gpu(size_t(width) * height * 3), cpu(gpu.size());
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, gpu.data());
+
+    std::vector<int> cpu_iterations(gpu_iterations.size());
+    auto tiles = make_tiles(width, height, TiledRenderOptions().tile_size);
+    auto iterate = fractal.cpuIterator(width, height);
+    std::atomic<uint64_t> iterations(0);
+
+    auto start = std::chrono::steady_clock::now();
+    run_work_stealing(int(tiles.size()), default_thread_count(), [&](int t, int) {
+        iterations += iterate(tiles[t], cpu_iterations.data() + size_t(tiles[t].y0) * width + tiles[t].x0, width);
+    });
+    CpuRenderStats stats;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.iterations = iterations;
+
+    colorize(cpu_iterations.data(), int(cpu_iterations.size()), max_value(fractal.getParams()), gradient, cpu.data());
+
+    const int samples = fractal.getAntialias();
+    if (samples > 1) {
+        auto iterate_samples = fractal.cpuSampleIterator(width, height, samples);
+        run_work_stealing(int(tiles.size()), default_thread_count(), [&](int t, int) {
+            const Tile& tile = tiles[t];
+            const Tile grown = grow_tile(tile, width, height);
+            refine_edges(iterate_samples, samples, tile, width, height,
+                         cpu_iterations.data() + size_t(grown.y0) * width + grown.x0, width,
+                         max_value(fractal.getParams()), gradient, cpu.data() + (size_t(tile.y0) * width + tile.x0) * 3, width);
+        });
+    }
+
+    size_t differ_iterations = 0;
+    for (size_t i = 0; i < cpu_iterations.size(); ++i)
+        differ_iterations += cpu_iterations[i] != gpu_iterations[i];
+
+    // gl rows go bottom to top
+    size_t differ = 0;
+    double total = 0;
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < 3 * width; ++x) {
+            int d = std::abs(int(gpu[size_t(height - 1 - y) * width * 3 + x]) - int(cpu[size_t(y) * width * 3 + x]));
+            total += d;
+            differ += d > 8;
+        }
+
+    return fmt::format("cpu {}{}: {:.1f} ms, {:.1f} Mpixel*it/s\n{:.3f}% pixels with other iteration count\n"
+                       "mean diff {:.3f}, {:.3f}% channels off by > 8",
+                       fractal.isDeep() ? "deep " : fmt::format("{} ", precision_name(fractal.getParams().precision)),
+                       kernel_name(best_kernel()), stats.seconds * 1000, stats.mpix_it_per_second(),
+                       100.0 * differ_iterations / cpu_iterations.size(), total / gpu.size(), 100.0 * differ / gpu.size());
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1)
+        return run_headless(argc, argv);
+
     OpenGL opengl;
     // Triangle triangle;
     Texture gradient("grad.png");    
     Fractal fractal(gradient);
+    Atlas atlas(gradient);
+    Gradient cpu_gradient("grad.png");
+    // leaves a core to the ui thread
+    TileCache tile_cache(size_t(256) << 20, std::max(1, default_thread_count() - 1));
+    bool cpu_check = false;
+    std::string cpu_check_result;
     
     // GUI
-    static float translation[] = { 0.0, 0.0 };
+    static double translation[] = { 0.0, 0.0 };
     static float cvec[] = {0.069, -0.644};
-    static float R = 0.178, scale = 0.5;
+    static float R = 0.178;
+    static double scale = 0.5;
     static int numiter = 35;
+    static float palette_offset = 0, palette_repeat = 1;
+    static bool animate_palette = false;
+    static bool pan_reprojection = true;
+    static bool subdivide = false;
+    static bool periodicity = false, iteration_stats = false;
+    // 0 is auto_precision, then Precision values
+    static int precision_mode = 0;
+    // 0 is off, then 2x2 .. 4x4 samples for edge pixels
+    static int antialias_mode = 0;
+    static bool dynamic_resolution = true;
+    static float frame_budget_ms = 16;
+    static bool use_tile_cache = false;
+    static int cache_budget_mb = 256;
+    // KernelVariant, EscapeMetric and Coloring values
+    static int power = 2, metric_mode = 0, coloring_mode = 0;
+
+    // deep zoom keeps its own center and scale, see DeepView
+    static bool deep = false;
+    DeepView deep_view;
+
+    // a grid of julia sets around atlas_layout.center instead of the view, see atlas.h
+    static bool show_atlas = false;
+    static AtlasLayout atlas_layout;
+
+    // what of the atlas is under the pointer, c gets the c there
+    auto get_atlas_under_pointer = [&](double* c) {
+        double x, y;
+        int width, height;
+        opengl.get_mouse_coordinates(x, y);
+        opengl.get_framebuffer_size(width, height);
+        return atlas_hit(atlas_layout, width, height, (x + 1) / 2 * width, (1 - y) / 2 * height, c);
+    };
     
+    auto get_ndc_under_pointer = [&](double& x, double& y) {
+        opengl.get_mouse_coordinates(x, y);
+        y *= opengl.aspect_ratio();
+    };
+
+    // moves the deep center by a world offset, keeping enough precision for the scale
+    auto move_deep_center = [&](double dx, double dy) {
+        int prec = BigFixed::limbs_for_scale(deep_view.scale);
+        deep_view.center[0] += BigFixed(dx, prec);
+        deep_view.center[1] += BigFixed(dy, prec);
+    };
+
     auto get_world_coordinates_under_pointer = [&](double& x, double& y) {
         opengl.get_mouse_coordinates(x, y);
 
@@ -349,12 +1782,38 @@ int main(int, char **) {
 
     bool is_dragged = false;
     double drag_point_x, drag_point_y;
+
+    // scroll events are discrete, zooming counts as interaction for a moment after each
+    double last_scroll_time = -1;
+    bool ui_active = false;
     
     opengl.set_on_mouse_button([&](int button, int action, int mods) {
+        // a cell picks its c and goes back to the view, the overview moves the sweep
+        if (show_atlas) {
+            double c[2];
+            if (button != GLFW_MOUSE_BUTTON_LEFT or action != GLFW_PRESS)
+                return;
+            switch (get_atlas_under_pointer(c)) {
+            case AtlasHit::Cell:
+                cvec[0] = float(c[0]), cvec[1] = float(c[1]);
+                show_atlas = false;
+                break;
+            case AtlasHit::Overview:
+                atlas_layout.center[0] = c[0], atlas_layout.center[1] = c[1];
+                break;
+            default:
+                break;
+            }
+            return;
+        }
+
         if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
             is_dragged = true;
 
-            get_world_coordinates_under_pointer(drag_point_x, drag_point_y);
+            if (deep)
+                get_ndc_under_pointer(drag_point_x, drag_point_y);
+            else
+                get_world_coordinates_under_pointer(drag_point_x, drag_point_y);
         }
 
         if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_RELEASE) {
@@ -363,6 +1822,35 @@ int main(int, char **) {
     });
     
     opengl.set_on_scrool([&](double a, double b) {
+        last_scroll_time = glfwGetTime();
+
+        if (show_atlas) {
+            if (b > 0)
+                atlas_layout.span /= 1.05;
+            else if (b < 0)
+                atlas_layout.span *= 1.05;
+            atlas_layout.span = std::max(std::min(atlas_layout.span, 4.0), 1e-6);
+            return;
+        }
+
+        if (deep) {
+            double x, y;
+            get_ndc_under_pointer(x, y);
+
+            double old_scale = deep_view.scale;
+            if (b > 0)
+                deep_view.scale *= 1.05;
+            else if (b < 0)
+                deep_view.scale /= 1.05;
+
+            deep_view.scale = std::max(deep_view.scale, 0.1);
+            deep_view.scale = std::min(deep_view.scale, 1e300);
+
+            // the point under the pointer stays in place
+            move_deep_center(x / old_scale - x / deep_view.scale, y / old_scale - y / deep_view.scale);
+            return;
+        }
+
         double x, y;
         get_world_coordinates_under_pointer(x, y);
         
@@ -371,8 +1859,8 @@ int main(int, char **) {
         else if (b < 0)
             scale = scale / 1.05;
 
-        scale = std::max(scale, 0.1f);
-        scale = std::min(scale, 10.0f);
+        scale = std::max(scale, 0.1);
+        scale = std::min(scale, MAX_DOUBLE_SCALE);
         
         double newx, newy;
         get_world_coordinates_under_pointer(newx, newy);
@@ -383,7 +1871,13 @@ int main(int, char **) {
 
     
     opengl.main_loop([&]() {
-        if (is_dragged) {
+        if (is_dragged and deep) {
+            double cur_x, cur_y;
+            get_ndc_under_pointer(cur_x, cur_y);
+
+            move_deep_center((drag_point_x - cur_x) / deep_view.scale, (drag_point_y - cur_y) / deep_view.scale);
+            drag_point_x = cur_x, drag_point_y = cur_y;
+        } else if (is_dragged) {
             double cur_x, cur_y;
             get_world_coordinates_under_pointer(cur_x, cur_y);
             
@@ -391,22 +1885,178 @@ int main(int, char **) {
             translation[1] += drag_point_y - cur_y;
         }
         
-        fractal.setPosition(translation[0], translation[1], scale, opengl.aspect_ratio());
-        fractal.setParameters(cvec[0], cvec[1], R, numiter);
-        fractal.draw();
+        // deep zoom has its own arithmetic, keep the precision so it does not cause iterating
+        Precision precision = fractal.getParams().precision;
+        if (deep) {
+            translation[0] = deep_view.center[0].to_double();
+            translation[1] = deep_view.center[1].to_double();
+            fractal.setPosition(translation[0], translation[1], std::min(deep_view.scale, 1e30), float(opengl.aspect_ratio()));
+        } else {
+            fractal.setPosition(translation[0], translation[1], scale, float(opengl.aspect_ratio()));
+            precision = precision_mode == 0 ? fractal.autoPrecision(scale) : Precision(precision_mode - 1);
+        }
+        fractal.setPrecision(precision);
+        fractal.setDeepView(deep, deep_view);
+        KernelVariant variant;
+        variant.power = power;
+        variant.metric = EscapeMetric(metric_mode);
+        variant.coloring = Coloring(coloring_mode);
+        fractal.setVariant(variant);
+        fractal.setParameters(cvec[0], cvec[1], R, numiter, periodicity);
+        fractal.setIterationStats(iteration_stats);
+        fractal.setPalette(palette_offset, palette_repeat);
+        fractal.setPanReprojection(pan_reprojection);
+        fractal.setSubdivision(subdivide);
+        fractal.setAntialias(antialias_mode > 0 ? antialias_mode + 1 : 0);
+        fractal.setDynamicResolution(dynamic_resolution, frame_budget_ms);
+        tile_cache.setBudget(size_t(cache_budget_mb) << 20);
+        fractal.setTileCache(use_tile_cache ? &tile_cache : nullptr);
+        fractal.setInteractive(is_dragged or glfwGetTime() - last_scroll_time < 0.25 or ui_active);
+        if (show_atlas)
+            atlas.draw(fractal.getParams(), atlas_layout, palette_offset, palette_repeat);
+        else
+            fractal.draw();
         // triangle.draw();
+
+        // the comparison needs the window sized buffer, progressive refinement gets there soon
+        if (cpu_check and not show_atlas and fractal.isFullResolution()) {
+            cpu_check_result = compare_with_cpu(fractal, cpu_gradient);
+            cpu_check = false;
+        }
         
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
         
         ImGui::Begin("Fractal");        
-        ImGui::SliderFloat2("position", translation, -5.0, 5.0);
-        ImGui::SliderFloat("scale", &scale, 0.1, 10);
+        if (ImGui::Checkbox("deep zoom", &deep)) {
+            if (deep) {
+                deep_view.scale = scale;
+                deep_view.center[0] = BigFixed(translation[0], BigFixed::limbs_for_scale(scale));
+                deep_view.center[1] = BigFixed(translation[1], BigFixed::limbs_for_scale(scale));
+            } else {
+                scale = std::max(std::min(deep_view.scale, MAX_DOUBLE_SCALE), 0.1);
+                numiter = std::min(numiter, 100);
+            }
+        }
+
+        if (deep) {
+            // enough digits to tell pixels apart
+            int digits = int(std::log10(std::max(deep_view.scale, 1.0))) + 6;
+            ImGui::Text("x %s", deep_view.center[0].to_string(digits).c_str());
+            ImGui::Text("y %s", deep_view.center[1].to_string(digits).c_str());
+            ImGui::Text("zoom %.3g", deep_view.scale);
+            ImGui::Text("reference orbit: %d points, %d bits, %.1f ms", fractal.getOrbit().length(),
+                        32 * BigFixed::limbs_for_scale(deep_view.scale), fractal.getOrbitSeconds() * 1000);
+        } else {
+            ImGui::InputScalarN("position", ImGuiDataType_Double, translation, 2, nullptr, nullptr, "%.15g");
+            for (double& t: translation)
+                t = std::max(std::min(t, 5.0), -5.0);
+            ImGui::InputDouble("scale", &scale, 0, 0, "%.6g");
+            scale = std::max(std::min(scale, MAX_DOUBLE_SCALE), 0.1);
+
+            const char* modes[] = {"auto", "float", "double (fp64)", "double-float"};
+            ImGui::Combo("precision", &precision_mode, modes, 4);
+            ImGui::Text("iterating in %s%s", precision_name(fractal.getParams().precision),
+                        fractal.hasNativeDouble() ? "" : ", no fp64 on this gpu");
+            ImGui::Text("gpu ns/pixel: float %.2f, double %.2f, double-float %.2f",
+                        fractal.getPixelNs(Precision::Float), fractal.getPixelNs(Precision::Double),
+                        fractal.getPixelNs(Precision::DoubleFloat));
+            if (scale >= MAX_DOUBLE_SCALE)
+                ImGui::Text("zoom further with deep zoom");
+        }
         ImGui::SliderFloat2("c", cvec, -2, 2);
         ImGui::SliderFloat("R", &R, 0, 2);
-        ImGui::SliderInt("numit", &numiter, 1, 100);
+        // periodicity makes high caps affordable for the interior
+        if (deep or periodicity) {
+            ImGui::InputInt("numit", &numiter, 100, 1000);
+            numiter = std::max(1, std::min(numiter, 1000000));
+        } else {
+            ImGui::SliderInt("numit", &numiter, 1, 100);
+        }
+        if (ImGui::Checkbox("periodicity checking", &periodicity) and not periodicity and not deep)
+            numiter = std::min(numiter, 100);
+        // switching recompiles the iteration shaders, deep zoom is z^2 only
+        if (not deep) {
+            ImGui::SliderInt("power", &power, MIN_POWER, MAX_POWER, "z^%d + c");
+            const char* metrics[] = {"euclidean", "manhattan", "chebyshev"};
+            ImGui::Combo("capture metric", &metric_mode, metrics, 3);
+            const char* colorings[] = {"iterations", "binary decomposition"};
+            ImGui::Combo("coloring", &coloring_mode, colorings, 2);
+        }
+        ImGui::Checkbox("iteration statistics", &iteration_stats);
+        if (iteration_stats) {
+            long long plain, done;
+            fractal.getIterationStats(plain, done);
+            ImGui::Text("f_c evaluations: %lld of %lld, %.1f%% saved", done, plain,
+                        plain > 0 ? 100.0 * (plain - done) / plain : 0.0);
+        }
+        ImGui::SliderFloat("palette offset", &palette_offset, 0, 2);
+        ImGui::SliderFloat("palette repeat", &palette_repeat, 0.1, 10);
+        ImGui::Checkbox("animate palette", &animate_palette);
+        if (animate_palette)
+            palette_offset = std::fmod(palette_offset + 0.25f * ImGui::GetIO().DeltaTime, 2.0f);
+        ImGui::Text("iteration passes: %d of %d frames", fractal.getIterationPasses(), fractal.getFrames());
+        ImGui::Checkbox("reuse pixels when panning", &pan_reprojection);
+        if (fractal.hasSubdivision())
+            ImGui::Checkbox("mariani-silver (compute shader)", &subdivide);
+        else
+            ImGui::Text("mariani-silver needs compute shaders");
+        ImGui::Text("last iteration pass: %.2f ms on the gpu", fractal.getIterationMs());
+        const char* antialias_modes[] = {"off", "2x2", "3x3", "4x4"};
+        ImGui::Combo("edge antialiasing", &antialias_mode, antialias_modes, 4);
+        if (antialias_mode > 0)
+            ImGui::Text("last refine pass: %lld pixels, %.2f ms on the gpu", fractal.getRefinedPixels(), fractal.getRefineMs());
+        ImGui::Text("recomputed pixels: %lld", fractal.getRecomputedPixels());
+        ImGui::Checkbox("tile cache (cpu threads)", &use_tile_cache);
+        if (use_tile_cache) {
+            // the view needs up to 4 times its pixels in tiles, see tile_level
+            ImGui::SliderInt("cache budget, MB", &cache_budget_mb, 64, 2048);
+            int cached, fallback, missing;
+            fractal.getCacheTiles(cached, fallback, missing);
+            TileCacheStats stats = tile_cache.getStats();
+            ImGui::Text("view: %d tiles cached, %d coarser, %d iterated", cached, fallback, missing);
+            ImGui::Text("cache: %zu tiles, %zu MB, %zu queued, %llu rendered in %.1f s, %llu evicted",
+                        stats.tiles, stats.bytes >> 20, stats.queued, (unsigned long long)stats.rendered,
+                        stats.render_seconds, (unsigned long long)stats.evicted);
+            if (fractal.isDeep())
+                ImGui::Text("deep zoom does not use the cache");
+        }
+        ImGui::Checkbox("dynamic resolution", &dynamic_resolution);
+        if (dynamic_resolution) {
+            ImGui::SliderFloat("frame budget, ms", &frame_budget_ms, 4, 100);
+            int iterations_width, iterations_height;
+            fractal.getIterationSize(iterations_width, iterations_height);
+            ImGui::Text("iteration buffer: %dx%d", iterations_width, iterations_height);
+        }
+        if (not deep and ImGui::Checkbox("parameter atlas", &show_atlas) and show_atlas) {
+            atlas_layout.center[0] = cvec[0];
+            atlas_layout.center[1] = cvec[1];
+        }
+        if (show_atlas and not deep) {
+            ImGui::SliderInt("columns", &atlas_layout.cols, 1, MAX_ATLAS_SIDE);
+            ImGui::SliderInt("rows", &atlas_layout.rows, 1, MAX_ATLAS_SIDE);
+            ImGui::InputScalarN("sweep center", ImGuiDataType_Double, atlas_layout.center, 2, nullptr, nullptr, "%.6g");
+            ImGui::InputDouble("sweep span", &atlas_layout.span, 0, 0, "%.6g");
+            atlas_layout.span = std::max(std::min(atlas_layout.span, 4.0), 1e-6);
+            ImGui::Checkbox("c plane overview", &atlas_layout.overview);
+
+            double c[2];
+            AtlasHit hit = get_atlas_under_pointer(c);
+            if (hit != AtlasHit::None)
+                ImGui::Text("%s c = (%.6g, %.6g)", hit == AtlasHit::Cell ? "cell" : "overview", c[0], c[1]);
+            ImGui::Text("click a cell to use its c, the overview to move the sweep, scroll to zoom it");
+            ImGui::Text("last atlas pass: %d julia sets, %.2f ms on the gpu", atlas_layout.cols * atlas_layout.rows,
+                        atlas.getDrawMs());
+        }
+        if (deep)
+            show_atlas = false;
+        if (ImGui::Button("compare with cpu"))
+            cpu_check = true;
+        if (not cpu_check_result.empty())
+            ImGui::Text("%s", cpu_check_result.c_str());
         ImGui::End();
+        ui_active = ImGui::IsAnyItemActive();
         
         // Generate gui render commands
         ImGui::Render();
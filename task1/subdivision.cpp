@@ -0,0 +1,131 @@
+#include "subdivision.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    class Subdivider {
+    private:
+        const PixelIterator& iterate;
+        const Tile& tile;
+        int* out;
+        int stride;
+        int min_size;
+
+        // pixels of the current level
+        std::vector<int> xs, ys, values;
+
+        int& at(int x, int y) {
+            return out[size_t(y - tile.y0) * stride + (x - tile.x0)];
+        }
+
+        void add(int x0, int y0, int x1, int y1) {
+            for (int y = y0; y < y1; ++y)
+                for (int x = x0; x < x1; ++x) {
+                    xs.push_back(x);
+                    ys.push_back(y);
+                }
+        }
+
+        void flush() {
+            values.resize(xs.size());
+            iterations += iterate(xs.data(), ys.data(), int(xs.size()), values.data());
+
+            for (size_t i = 0; i < xs.size(); ++i)
+                at(xs[i], ys[i]) = values[i];
+
+            xs.clear();
+            ys.clear();
+        }
+
+        // value of the whole border of r or ITER_OUTSIDE when it is not the same everywhere
+        int border_value(const Tile& r) {
+            int value = at(r.x0, r.y0);
+
+            for (int x = r.x0; x < r.x1; ++x)
+                if (at(x, r.y0) != value or at(x, r.y1 - 1) != value)
+                    return ITER_OUTSIDE;
+            for (int y = r.y0; y < r.y1; ++y)
+                if (at(r.x0, y) != value or at(r.x1 - 1, y) != value)
+                    return ITER_OUTSIDE;
+
+            return value;
+        }
+
+        // the border of r is already computed, adds what has to be iterated next
+        void subdivide(const Tile& r, std::vector<Tile>& next) {
+            int w = r.x1 - r.x0, h = r.y1 - r.y0;
+            if (w <= 2 or h <= 2)
+                return;
+
+            int value = border_value(r);
+            if (value != ITER_OUTSIDE) {
+                for (int y = r.y0 + 1; y < r.y1 - 1; ++y)
+                    std::fill(&at(r.x0 + 1, y), &at(r.x1 - 1, y), value);
+                return;
+            }
+
+            if (w <= min_size and h <= min_size) {
+                add(r.x0 + 1, r.y0 + 1, r.x1 - 1, r.y1 - 1);
+                return;
+            }
+
+            // the splitting line becomes a border of both halves
+            if (w >= h) {
+                int m = r.x0 + w / 2;
+                add(m, r.y0 + 1, m + 1, r.y1 - 1);
+                next.push_back(Tile {r.x0, r.y0, m + 1, r.y1});
+                next.push_back(Tile {m, r.y0, r.x1, r.y1});
+            } else {
+                int m = r.y0 + h / 2;
+                add(r.x0 + 1, m, r.x1 - 1, m + 1);
+                next.push_back(Tile {r.x0, r.y0, r.x1, m + 1});
+                next.push_back(Tile {r.x0, m, r.x1, r.y1});
+            }
+        }
+
+    public:
+        uint64_t iterations = 0;
+
+        Subdivider(const PixelIterator& iterate, const Tile& tile, int* out, int stride, int min_size)
+            : iterate(iterate), tile(tile), out(out), stride(stride), min_size(std::max(min_size, 3)) {
+        }
+
+        void run() {
+            const Tile& r = tile;
+            add(r.x0, r.y0, r.x1, r.y0 + 1);
+            if (r.y1 - r.y0 > 1)
+                add(r.x0, r.y1 - 1, r.x1, r.y1);
+            add(r.x0, r.y0 + 1, r.x0 + 1, r.y1 - 1);
+            if (r.x1 - r.x0 > 1)
+                add(r.x1 - 1, r.y0 + 1, r.x1, r.y1 - 1);
+            flush();
+
+            std::vector<Tile> level = {tile}, next;
+            while (not level.empty()) {
+                for (const Tile& t: level)
+                    subdivide(t, next);
+                flush();
+
+                level.swap(next);
+                next.clear();
+            }
+        }
+    };
+}
+
+uint64_t iterate_subdivided(const PixelIterator& iterate, const Tile& tile, int* out, int stride, int min_size) {
+    if (tile.x0 >= tile.x1 or tile.y0 >= tile.y1)
+        return 0;
+
+    Subdivider subdivider(iterate, tile, out, stride, min_size);
+    subdivider.run();
+    return subdivider.iterations;
+}
+
+TileIterator subdivided(const PixelIterator& iterate, int min_size) {
+    return [iterate, min_size](const Tile& tile, int* out, int stride) {
+        return iterate_subdivided(iterate, tile, out, stride, min_size);
+    };
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tile_render.h"
+
+// Mariani-Silver subdivision: only the border of a rectangle is iterated, and if it has one
+// value everywhere the inside gets that value too. Otherwise the rectangle is split in two
+// along its longer side. Rectangles of at most min_size x min_size are iterated fully.
+// ITER_OUTSIDE borders are always split, a rectangle around the whole fractal quad has one too.
+// Rectangles are processed level by level, and the pixels of a level go to iterate in one
+// call, so that the simd kernels get long spans. Pixels that were filled cost nothing.
+uint64_t iterate_subdivided(const PixelIterator& iterate, const Tile& tile, int* out, int stride,
+                            int min_size = 8);
+
+// TileIterator doing the above, for render_tiled
+TileIterator subdivided(const PixelIterator& iterate, int min_size = 8);
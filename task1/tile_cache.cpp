@@ -0,0 +1,204 @@
+#include "tile_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+bool TileKey::operator==(const TileKey& other) const {
+    return level == other.level and x == other.x and y == other.y
+        and cvec[0] == other.cvec[0] and cvec[1] == other.cvec[1] and R == other.R
+        and num_it == other.num_it and periodicity == other.periodicity and variant == other.variant;
+}
+
+size_t TileKeyHash::operator()(const TileKey& key) const {
+    size_t h = std::hash<int>()(key.level);
+    auto combine = [&](size_t v) {
+        h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2);
+    };
+
+    combine(std::hash<int>()(key.x));
+    combine(std::hash<int>()(key.y));
+    combine(std::hash<float>()(key.cvec[0]));
+    combine(std::hash<float>()(key.cvec[1]));
+    combine(std::hash<float>()(key.R));
+    combine(std::hash<int>()(key.num_it));
+    combine(std::hash<bool>()(key.periodicity));
+    combine(std::hash<int>()(key.variant.power));
+    combine(std::hash<int>()(int(key.variant.metric)));
+    combine(std::hash<int>()(int(key.variant.coloring)));
+    return h;
+}
+
+TileKey tile_key(const FractalParams& params, int level, int x, int y) {
+    TileKey key;
+    key.level = level;
+    key.x = x, key.y = y;
+    std::copy(params.cvec, params.cvec + 2, key.cvec);
+    key.R = params.R;
+    key.num_it = params.num_it;
+    key.periodicity = params.periodicity;
+    key.variant = params.variant;
+    return key;
+}
+
+FractalParams tile_params(const TileKey& key) {
+    double tiles = std::ldexp(1.0, key.level);
+
+    FractalParams params;
+    params.translation[0] = -1 + (key.x + 0.5) * 2 / tiles;
+    params.translation[1] = 1 - (key.y + 0.5) * 2 / tiles;
+    params.scale = tiles;
+    params.aspect_ratio = 1;
+
+    std::copy(key.cvec, key.cvec + 2, params.cvec);
+    params.R = key.R;
+    params.num_it = key.num_it;
+    params.periodicity = key.periodicity;
+    params.variant = key.variant;
+    // auto_precision is for wider images, so it is on the safe side here
+    params.precision = auto_precision(tiles, true);
+    return params;
+}
+
+int tile_level(double scale, int width) {
+    double tiles = scale * width / CACHE_TILE_SIZE;
+    if (tiles <= 1)
+        return 0;
+    if (tiles > std::ldexp(1.0, MAX_CACHE_LEVEL))
+        return MAX_CACHE_LEVEL + 1;
+    return int(std::ceil(std::log2(tiles)));
+}
+
+std::vector<TileKey> view_tiles(const FractalParams& params, int level, int margin) {
+    const double tiles = std::ldexp(1.0, level);
+    const double half_w = 1 / params.scale, half_h = params.aspect_ratio / params.scale;
+
+    // u and v are in tiles from the top left of the quad
+    auto clamp_tile = [&](double t) {
+        return int(std::max(0.0, std::min(t, tiles - 1)));
+    };
+    double u0 = (params.translation[0] - half_w + 1) / 2 * tiles, u1 = (params.translation[0] + half_w + 1) / 2 * tiles;
+    double v0 = (1 - params.translation[1] - half_h) / 2 * tiles, v1 = (1 - params.translation[1] + half_h) / 2 * tiles;
+
+    std::vector<TileKey> keys;
+    if (u1 < 0 or v1 < 0 or u0 >= tiles or v0 >= tiles)
+        return keys;
+
+    int x0 = clamp_tile(std::floor(u0) - margin), x1 = clamp_tile(std::floor(u1) + margin);
+    int y0 = clamp_tile(std::floor(v0) - margin), y1 = clamp_tile(std::floor(v1) + margin);
+    for (int y = y0; y <= y1; ++y)
+        for (int x = x0; x <= x1; ++x)
+            keys.push_back(tile_key(params, level, x, y));
+
+    double cu = (u0 + u1) / 2, cv = (v0 + v1) / 2;
+    auto distance = [&](const TileKey& key) {
+        return std::hypot(key.x + 0.5 - cu, key.y + 0.5 - cv);
+    };
+    std::stable_sort(keys.begin(), keys.end(), [&](const TileKey& a, const TileKey& b) {
+        return distance(a) < distance(b);
+    });
+    return keys;
+}
+
+TileCache::TileCache(size_t budget_bytes, int threads) : budget_bytes(budget_bytes) {
+    for (int i = 0; i < std::max(1, threads); ++i)
+        workers.emplace_back([this]() { work(); });
+}
+
+TileCache::~TileCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    wake.notify_all();
+
+    for (auto& worker: workers)
+        worker.join();
+}
+
+void TileCache::work() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        wake.wait(lock, [this]() { return stop or not queue.empty(); });
+        if (stop)
+            return;
+
+        TileKey key = queue.front();
+        queue.pop_front();
+        if (entries.count(key) or in_progress.count(key))
+            continue;
+        in_progress.insert(key);
+
+        lock.unlock();
+        auto start = std::chrono::steady_clock::now();
+        auto data = std::make_shared<std::vector<int>>(size_t(CACHE_TILE_SIZE) * CACHE_TILE_SIZE);
+        iterate_region(tile_params(key), CACHE_TILE_SIZE, CACHE_TILE_SIZE, 0, 0, CACHE_TILE_SIZE, CACHE_TILE_SIZE,
+                       data->data(), CACHE_TILE_SIZE, best_kernel());
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        lock.lock();
+
+        in_progress.erase(key);
+        lru.push_front(key);
+        entries[key] = Entry {data, lru.begin()};
+        totals.rendered += 1;
+        totals.render_seconds += seconds;
+        tile_generation += 1;
+        evict();
+    }
+}
+
+void TileCache::evict() {
+    // tiles still in use by a caller stay alive through their shared_ptr
+    while (entries.size() * CACHE_TILE_BYTES > budget_bytes and not lru.empty()) {
+        entries.erase(lru.back());
+        lru.pop_back();
+        totals.evicted += 1;
+    }
+}
+
+TileData TileCache::find(const TileKey& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = entries.find(key);
+    if (it == entries.end())
+        return nullptr;
+
+    lru.splice(lru.begin(), lru, it->second.lru);
+    return it->second.data;
+}
+
+void TileCache::request(const std::vector<TileKey>& keys) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        queue.clear();
+        for (const TileKey& key: keys)
+            if (not entries.count(key) and not in_progress.count(key))
+                queue.push_back(key);
+    }
+    wake.notify_all();
+}
+
+void TileCache::setBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    budget_bytes = bytes;
+    evict();
+}
+
+uint64_t TileCache::generation() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return tile_generation;
+}
+
+TileCacheStats TileCache::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    TileCacheStats stats = totals;
+    stats.tiles = entries.size();
+    stats.bytes = entries.size() * CACHE_TILE_BYTES;
+    stats.queued = queue.size();
+    return stats;
+}
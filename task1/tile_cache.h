@@ -0,0 +1,112 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "fractal_cpu.h"
+
+// Quadtree of iteration value tiles. Level l splits the fractal quad [-1, 1]^2 into
+// 2^l x 2^l tiles of CACHE_TILE_SIZE^2 pixels, tile (x, y) counted from the top left
+// like image rows.
+const int CACHE_TILE_SIZE = 256;
+const size_t CACHE_TILE_BYTES = size_t(CACHE_TILE_SIZE) * CACHE_TILE_SIZE * sizeof(int);
+const int MAX_CACHE_LEVEL = 30;
+
+struct TileKey {
+    int level = 0;
+    int x = 0, y = 0;
+
+    // everything of FractalParams but the view, the precision follows from the level
+    float cvec[2] = {0, 0};
+    float R = 0;
+    int num_it = 0;
+    bool periodicity = false;
+    KernelVariant variant;
+
+    bool operator==(const TileKey& other) const;
+};
+
+struct TileKeyHash {
+    size_t operator()(const TileKey& key) const;
+};
+
+TileKey tile_key(const FractalParams& params, int level, int x, int y);
+
+// the view that renders the tile as a CACHE_TILE_SIZE^2 image
+FractalParams tile_params(const TileKey& key);
+
+// Coarsest level whose pixels are no larger than those of a width pixels wide view at
+// scale, above MAX_CACHE_LEVEL if the view is too deep for the cache.
+int tile_level(double scale, int width);
+
+// Tiles of level covering the view of params grown by margin tiles on every side,
+// nearest to the center first.
+std::vector<TileKey> view_tiles(const FractalParams& params, int level, int margin);
+
+typedef std::shared_ptr<const std::vector<int>> TileData;
+
+struct TileCacheStats {
+    size_t tiles = 0;
+    size_t bytes = 0;
+    size_t queued = 0;
+    uint64_t rendered = 0;
+    uint64_t evicted = 0;
+    double render_seconds = 0;  // summed over the workers
+};
+
+// Tiles rendered by background threads with iterate_region, kept while they fit the
+// memory budget, least recently used ones are evicted first.
+class TileCache {
+private:
+    struct Entry {
+        TileData data;
+        std::list<TileKey>::iterator lru;
+    };
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    bool stop = false;
+
+    std::unordered_map<TileKey, Entry, TileKeyHash> entries;
+    std::list<TileKey> lru;  // most recently used first
+    size_t budget_bytes;
+
+    std::deque<TileKey> queue;
+    std::unordered_set<TileKey, TileKeyHash> in_progress;
+    uint64_t tile_generation = 0;
+    TileCacheStats totals;
+
+    std::vector<std::thread> workers;
+
+    void work();
+    void evict();
+
+public:
+    TileCache(size_t budget_bytes, int threads);
+    ~TileCache();
+
+    TileCache(const TileCache&) = delete;
+    TileCache& operator=(const TileCache&) = delete;
+
+    // null if not cached, marks the tile as used otherwise
+    TileData find(const TileKey& key);
+
+    // Replaces the queue: the tiles not cached or being rendered yet are rendered in
+    // this order, earlier requests that are not repeated are dropped.
+    void request(const std::vector<TileKey>& keys);
+
+    void setBudget(size_t bytes);
+
+    // changes whenever a rendered tile is added
+    uint64_t generation() const;
+
+    TileCacheStats getStats() const;
+};
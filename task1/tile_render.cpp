@@ -0,0 +1,99 @@
+#include "tile_render.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+
+#include "antialias.h"
+#include "subdivision.h"
+
+std::vector<Tile> make_tiles(int width, int height, int tile_size) {
+    std::vector<Tile> tiles;
+
+    for (int y = 0; y < height; y += tile_size)
+        for (int x = 0; x < width; x += tile_size)
+            tiles.push_back(Tile {x, y, std::min(x + tile_size, width), std::min(y + tile_size, height)});
+
+    return tiles;
+}
+
+TiledRenderStats render_tiled(const TileIterator& iterate, int num_it, int width, int height,
+                              const TiledRenderOptions& options,
+                              const Gradient& gradient, std::vector<unsigned char>& rgb,
+                              const PixelIterator& iterate_samples) {
+    auto tiles = make_tiles(width, height, options.tile_size);
+    rgb.resize(size_t(width) * height * 3);
+
+    const bool antialias = options.antialias > 1;
+    if (antialias and not iterate_samples)
+        throw std::runtime_error("antialiasing needs a sample iterator");
+
+    // per worker scratch, reused between tiles
+    std::vector<std::vector<int>> iterations(std::max(1, options.threads));
+    std::vector<std::vector<unsigned char>> colors(iterations.size());
+    std::atomic<uint64_t> total_iterations(0);
+    std::atomic<int64_t> refined_pixels(0);
+
+    auto render_tile = [&](int t, int w) {
+        const Tile& tile = tiles[t];
+        int tw = tile.x1 - tile.x0, th = tile.y1 - tile.y0;
+
+        // the neighbours of border pixels are needed to find edges
+        const Tile grown = antialias ? grow_tile(tile, width, height) : tile;
+        int gw = grown.x1 - grown.x0, gh = grown.y1 - grown.y0;
+
+        iterations[w].resize(size_t(gw) * gh);
+        colors[w].resize(size_t(tw) * th * 3);
+
+        total_iterations += iterate(grown, iterations[w].data(), gw);
+        for (int y = 0; y < th; ++y)
+            colorize(iterations[w].data() + size_t(tile.y0 - grown.y0 + y) * gw + (tile.x0 - grown.x0), tw,
+                     num_it, gradient, colors[w].data() + size_t(y) * tw * 3);
+
+        if (antialias) {
+            EdgeRefineStats refined = refine_edges(iterate_samples, options.antialias, tile, width, height,
+                                                   iterations[w].data(), gw, num_it, gradient, colors[w].data(), tw);
+            total_iterations += refined.iterations;
+            refined_pixels += refined.pixels;
+        }
+
+        for (int y = 0; y < th; ++y)
+            std::copy(colors[w].begin() + size_t(y) * tw * 3, colors[w].begin() + size_t(y + 1) * tw * 3,
+                      rgb.begin() + (size_t(tile.y0 + y) * width + tile.x0) * 3);
+    };
+
+    TiledRenderStats stats;
+    stats.tiles = int(tiles.size());
+
+    auto start = std::chrono::steady_clock::now();
+    stats.workers = run_work_stealing(stats.tiles, options.threads, render_tile, options.work_stealing);
+    stats.total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.total.iterations = total_iterations;
+    stats.refined_pixels = refined_pixels;
+
+    return stats;
+}
+
+TiledRenderStats render_tiled(const FractalParams& params, int width, int height,
+                              const TiledRenderOptions& options,
+                              const Gradient& gradient, std::vector<unsigned char>& rgb) {
+    const int samples = options.antialias;
+    auto iterate_samples = [&](const int* xs, const int* ys, int n, int* out) {
+        return iterate_pixels(params, width * samples, height * samples, xs, ys, n, out, options.kernel);
+    };
+
+    if (options.subdivide) {
+        auto iterate = [&](const int* xs, const int* ys, int n, int* out) {
+            return iterate_pixels(params, width, height, xs, ys, n, out, options.kernel);
+        };
+
+        return render_tiled(subdivided(iterate), max_value(params), width, height, options, gradient, rgb, iterate_samples);
+    }
+
+    auto iterate = [&](const Tile& tile, int* out, int stride) {
+        return iterate_region(params, width, height, tile.x0, tile.y0, tile.x1, tile.y1, out, stride, options.kernel);
+    };
+
+    return render_tiled(iterate, max_value(params), width, height, options, gradient, rgb, iterate_samples);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "fractal_cpu.h"
+#include "work_stealing.h"
+
+struct Tile {
+    int x0, y0, x1, y1;
+};
+
+// Row-major tiles of at most tile_size x tile_size covering the image.
+std::vector<Tile> make_tiles(int width, int height, int tile_size);
+
+struct TiledRenderOptions {
+    int tile_size = 256;
+    int threads = default_thread_count();
+    CpuKernel kernel = best_kernel();
+    bool work_stealing = true;
+    bool subdivide = false;  // Mariani-Silver inside every tile, see subdivision.h
+    int antialias = 0;       // samples per side for edge pixels, see antialias.h. 0 or 1 is off
+};
+
+struct TiledRenderStats {
+    CpuRenderStats total;
+    int tiles = 0;
+    std::vector<WorkerStats> workers;
+    int64_t refined_pixels = 0;
+};
+
+// Fills iteration values of a tile, see iterate_region. Called concurrently.
+typedef std::function<uint64_t(const Tile& tile, int* out, int stride)> TileIterator;
+
+// Same for a list of pixels (xs[i], ys[i]), see iterate_pixels.
+typedef std::function<uint64_t(const int* xs, const int* ys, int n, int* out)> PixelIterator;
+
+// Multithreaded render of the whole image into width * height * 3 bytes. Tiles are
+// iterated and coloured independently, so no full size iteration buffer is kept.
+// With options.antialias tiles are iterated one pixel larger, and iterate_samples
+// iterates the options.antialias times larger image, see refine_edges.
+TiledRenderStats render_tiled(const TileIterator& iterate, int num_it, int width, int height,
+                              const TiledRenderOptions& options,
+                              const Gradient& gradient, std::vector<unsigned char>& rgb,
+                              const PixelIterator& iterate_samples = PixelIterator());
+
+// same with iterate_region (or iterate_pixels when subdividing) and options.kernel,
+// samples with iterate_pixels
+TiledRenderStats render_tiled(const FractalParams& params, int width, int height,
+                              const TiledRenderOptions& options,
+                              const Gradient& gradient, std::vector<unsigned char>& rgb);
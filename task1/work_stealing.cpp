@@ -0,0 +1,112 @@
+#include "work_stealing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    class TaskQueue {
+    private:
+        std::mutex mutex;
+        std::deque<int> tasks;
+
+    public:
+        void push(int task) {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(task);
+        }
+
+        bool pop(int& task) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (tasks.empty())
+                return false;
+            task = tasks.front();
+            tasks.pop_front();
+            return true;
+        }
+
+        bool steal(int& task) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (tasks.empty())
+                return false;
+            task = tasks.back();
+            tasks.pop_back();
+            return true;
+        }
+    };
+}
+
+int default_thread_count() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+std::vector<WorkerStats> run_work_stealing(int num_tasks, int num_threads,
+                                           const std::function<void(int, int)>& fn,
+                                           bool steal) {
+    num_threads = std::max(1, std::min(num_threads, num_tasks));
+
+    std::vector<std::unique_ptr<TaskQueue>> queues;
+    for (int w = 0; w < num_threads; ++w) {
+        queues.emplace_back(new TaskQueue());
+
+        int begin = int(int64_t(num_tasks) * w / num_threads);
+        int end = int(int64_t(num_tasks) * (w + 1) / num_threads);
+        for (int t = begin; t < end; ++t)
+            queues[w]->push(t);
+    }
+
+    std::vector<WorkerStats> stats(num_threads);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto worker = [&](int w) {
+        auto next_task = [&](int& task) {
+            if (queues[w]->pop(task))
+                return true;
+
+            if (steal) {
+                for (int i = 1; i < num_threads; ++i)
+                    if (queues[(w + i) % num_threads]->steal(task)) {
+                        stats[w].stolen += 1;
+                        return true;
+                    }
+            }
+            return false;
+        };
+
+        int task;
+        while (next_task(task)) {
+            auto start = std::chrono::steady_clock::now();
+
+            try {
+                fn(task, w);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (not error)
+                    error = std::current_exception();
+            }
+
+            stats[w].tasks += 1;
+            stats[w].busy_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int w = 1; w < num_threads; ++w)
+        threads.emplace_back(worker, w);
+    worker(0);
+
+    for (auto& thread: threads)
+        thread.join();
+
+    if (error)
+        std::rethrow_exception(error);
+
+    return stats;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+struct WorkerStats {
+    int tasks = 0;
+    int stolen = 0;
+    double busy_seconds = 0;
+};
+
+// Runs fn(task, worker) for every task in [0, num_tasks) on num_threads threads.
+// Tasks are first split into contiguous blocks, one per worker, in order. A worker
+// takes tasks from the front of its own block and, once that is empty, steals
+// from the back of other workers' blocks. With steal = false this is the plain
+// static split. The first exception thrown by fn is rethrown after all threads joined.
+std::vector<WorkerStats> run_work_stealing(int num_tasks, int num_threads,
+                                           const std::function<void(int, int)>& fn,
+                                           bool steal = true);
+
+// std::thread::hardware_concurrency(), but at least 1
+int default_thread_count();
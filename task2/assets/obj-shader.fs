@@ -11,6 +11,14 @@ uniform float u_base_color_weight;
 uniform float u_refract_coeff;
 uniform samplerCube u_tex;
 
+// the prefiltered skybox, level roughness * u_env_max_lod of u_env_specular is the GGX
+// lobe of that roughness, u_env_irradiance the cosine convolution
+uniform bool u_environment_ready;
+uniform float u_roughness;
+uniform float u_env_max_lod;
+uniform samplerCube u_env_specular;
+uniform samplerCube u_env_irradiance;
+
 // partially based on paper by Bram de Greve
 
 float sqr(float a) {
@@ -47,6 +55,12 @@ float sqr(float a) {
     //         coeff_reflect = 1;
     // }
 
+vec4 environment(vec3 direction) {
+    if (!u_environment_ready || u_roughness <= 0)
+        return texture(u_tex, direction);
+    return textureLod(u_env_specular, direction, u_roughness * u_env_max_lod);
+}
+
 void main() {
     vec3 ray = normalize(coordinates - u_camera);
     vec3 normal = normalize(normal_);
@@ -80,7 +94,12 @@ void main() {
         coeff_reflectance = r0 + (1.0 - r0) * x * x * x * x * x;
     }
 
-    o_frag_color = (1. - u_base_color_weight) * coeff_reflectance * texture(u_tex, reflected_ray)
-                 + (1. - u_base_color_weight) * (1 - coeff_reflectance) * texture(u_tex, refracted_ray)
-                 + (u_base_color_weight) * u_color;
+    // lit by the irradiance together with the rough reflections, roughness 0 is the plain color
+    vec4 base_color = u_color;
+    if (u_environment_ready && u_roughness > 0)
+        base_color.rgb *= texture(u_env_irradiance, normal).rgb;
+
+    o_frag_color = (1. - u_base_color_weight) * coeff_reflectance * environment(reflected_ray)
+                 + (1. - u_base_color_weight) * (1 - coeff_reflectance) * environment(refracted_ray)
+                 + (u_base_color_weight) * base_color;
 }
@@ -0,0 +1,359 @@
+#include "env_prefilter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "file_hash.h"
+#include "parallel_for.h"
+
+namespace
+{
+    const float PI = 3.14159265358979f;
+    const int SPECULAR_SAMPLES = 128;
+    const int IRRADIANCE_SAMPLES = 512;
+
+    struct Vec3 {
+        float x, y, z;
+
+        Vec3 operator+(Vec3 o) const { return {x + o.x, y + o.y, z + o.z}; }
+        Vec3 operator-(Vec3 o) const { return {x - o.x, y - o.y, z - o.z}; }
+        Vec3 operator*(float s) const { return {x * s, y * s, z * s}; }
+    };
+
+    float dot(Vec3 a, Vec3 b) {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    Vec3 cross(Vec3 a, Vec3 b) {
+        return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+    }
+
+    Vec3 normalize(Vec3 v) {
+        return v * (1.0f / std::sqrt(dot(v, v)));
+    }
+
+    // the direction of the texel center (x, y) of a face, as the GL cube map spec maps them
+    Vec3 texel_direction(int face, int x, int y, int size) {
+        float s = 2.0f * (x + 0.5f) / size - 1.0f;
+        float t = 2.0f * (y + 0.5f) / size - 1.0f;
+        switch (face) {
+        case 0: return normalize({1, -t, -s});
+        case 1: return normalize({-1, -t, s});
+        case 2: return normalize({s, 1, t});
+        case 3: return normalize({s, -1, -t});
+        case 4: return normalize({s, -t, 1});
+        default: return normalize({-s, -t, -1});
+        }
+    }
+
+    // box filtered levels of the base faces down to 1x1, the source of the filtering
+    class CubeChain {
+    private:
+        // [level][face], 3 floats per texel
+        std::vector<std::vector<std::vector<float>>> levels;
+
+        Vec3 texel(int level, int face, int x, int y) const {
+            const int size = ENV_BASE_SIZE >> level;
+            x = std::min(std::max(x, 0), size - 1);
+            y = std::min(std::max(y, 0), size - 1);
+            const float* p = &levels[level][face][3 * (size_t(y) * size + x)];
+            return {p[0], p[1], p[2]};
+        }
+
+    public:
+        explicit CubeChain(std::vector<std::vector<float>> base) {
+            levels.push_back(std::move(base));
+            for (int size = ENV_BASE_SIZE / 2; size > 0; size /= 2) {
+                const auto& above = levels.back();
+                std::vector<std::vector<float>> level(6, std::vector<float>(3 * size * size));
+                for (int f = 0; f < 6; ++f)
+                    for (int y = 0; y < size; ++y)
+                        for (int x = 0; x < size; ++x)
+                            for (int c = 0; c < 3; ++c) {
+                                auto at = [&](int dx, int dy) {
+                                    return above[f][3 * (size_t(2 * y + dy) * 2 * size + 2 * x + dx) + c];
+                                };
+                                level[f][3 * (size_t(y) * size + x) + c] = (at(0, 0) + at(1, 0) + at(0, 1) + at(1, 1)) / 4;
+                            }
+                levels.push_back(std::move(level));
+            }
+        }
+
+        int level_count() const {
+            return int(levels.size());
+        }
+
+        // bilinear in the face the direction hits, on the level nearest to lod
+        Vec3 sample(Vec3 d, float lod) const {
+            const int level = std::min(std::max(int(lod + 0.5f), 0), level_count() - 1);
+            const int size = ENV_BASE_SIZE >> level;
+
+            float ax = std::fabs(d.x), ay = std::fabs(d.y), az = std::fabs(d.z);
+            int face;
+            float sc, tc, ma;
+            if (ax >= ay and ax >= az) {
+                face = d.x > 0 ? 0 : 1;
+                sc = d.x > 0 ? -d.z : d.z;
+                tc = -d.y;
+                ma = ax;
+            } else if (ay >= az) {
+                face = d.y > 0 ? 2 : 3;
+                sc = d.x;
+                tc = d.y > 0 ? d.z : -d.z;
+                ma = ay;
+            } else {
+                face = d.z > 0 ? 4 : 5;
+                sc = d.z > 0 ? d.x : -d.x;
+                tc = -d.y;
+                ma = az;
+            }
+
+            float u = (sc / ma + 1) / 2 * size - 0.5f;
+            float v = (tc / ma + 1) / 2 * size - 0.5f;
+            int x = int(std::floor(u)), y = int(std::floor(v));
+            float fx = u - x, fy = v - y;
+            return (texel(level, face, x, y) * (1 - fx) + texel(level, face, x + 1, y) * fx) * (1 - fy)
+                + (texel(level, face, x, y + 1) * (1 - fx) + texel(level, face, x + 1, y + 1) * fx) * fy;
+        }
+    };
+
+    // point i of n of the Hammersley set
+    void hammersley(unsigned i, unsigned n, float& u, float& v) {
+        unsigned bits = i;
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        u = float(i) / n;
+        v = float(bits) * 2.3283064365386963e-10f;
+    }
+
+    // the direction (sin theta cos phi, sin theta sin phi, cos theta) around n
+    Vec3 around(Vec3 n, float cos_theta, float phi) {
+        Vec3 up = std::fabs(n.z) < 0.999f ? Vec3 {0, 0, 1} : Vec3 {1, 0, 0};
+        Vec3 tangent = normalize(cross(up, n));
+        Vec3 bitangent = cross(n, tangent);
+        float sin_theta = std::sqrt(std::max(0.0f, 1 - cos_theta * cos_theta));
+        return tangent * (sin_theta * std::cos(phi)) + bitangent * (sin_theta * std::sin(phi)) + n * cos_theta;
+    }
+
+    // source level with texels about the solid angle of a sample of probability density pdf,
+    // after Krivanek and Colbert, "Real-time Shading with Filtered Importance Sampling"
+    float source_lod(float pdf, int samples) {
+        const float texel_angle = 4 * PI / (6.0f * ENV_BASE_SIZE * ENV_BASE_SIZE);
+        const float sample_angle = 1.0f / (samples * pdf + 1e-6f);
+        return std::max(0.0f, 0.5f * std::log2(sample_angle / texel_angle) + 1);
+    }
+
+    // GGX lobe of roughness around n, with n = v = r as in Karis, "Real Shading in Unreal Engine 4"
+    Vec3 prefilter_specular(const CubeChain& chain, Vec3 n, float roughness) {
+        const float a = roughness * roughness;
+        Vec3 sum {0, 0, 0};
+        float weight = 0;
+        for (int i = 0; i < SPECULAR_SAMPLES; ++i) {
+            float u, v;
+            hammersley(i, SPECULAR_SAMPLES, u, v);
+            float cos_theta = std::sqrt((1 - v) / (1 + (a * a - 1) * v));
+            Vec3 h = around(n, cos_theta, 2 * PI * u);
+            Vec3 l = h * (2 * dot(n, h)) - n;
+
+            float n_dot_l = dot(n, l);
+            if (n_dot_l <= 0)
+                continue;
+
+            float d = a * a / (PI * std::pow(cos_theta * cos_theta * (a * a - 1) + 1, 2.0f));
+            sum = sum + chain.sample(l, source_lod(d / 4, SPECULAR_SAMPLES)) * n_dot_l;
+            weight += n_dot_l;
+        }
+        return sum * (1 / weight);
+    }
+
+    // the cosine weighted mean over the hemisphere of n, radiance to irradiance / pi
+    Vec3 convolve_irradiance(const CubeChain& chain, Vec3 n) {
+        Vec3 sum {0, 0, 0};
+        for (int i = 0; i < IRRADIANCE_SAMPLES; ++i) {
+            float u, v;
+            hammersley(i, IRRADIANCE_SAMPLES, u, v);
+            float cos_theta = std::sqrt(1 - v);
+            Vec3 l = around(n, cos_theta, 2 * PI * u);
+            sum = sum + chain.sample(l, source_lod(cos_theta / PI, IRRADIANCE_SAMPLES));
+        }
+        return sum * (1.0f / IRRADIANCE_SAMPLES);
+    }
+
+    unsigned char to_byte(float value) {
+        return (unsigned char)std::min(255.0f, std::max(0.0f, value * 255.0f + 0.5f));
+    }
+
+    // the faces of size, every texel f(direction), in parallel over rows
+    void fill_cube(unsigned char* out, int size, const std::function<Vec3(Vec3)>& f) {
+        parallel_for(6 * size, default_thread_count(), [&](int row) {
+            const int face = row / size, y = row % size;
+            unsigned char* p = out + 3 * (size_t(face) * size * size + size_t(y) * size);
+            for (int x = 0; x < size; ++x) {
+                Vec3 c = f(texel_direction(face, x, y, size));
+                *p++ = to_byte(c.x);
+                *p++ = to_byte(c.y);
+                *p++ = to_byte(c.z);
+            }
+        });
+    }
+
+    EnvironmentMaps prefilter(std::vector<std::vector<float>> base) {
+        EnvironmentMaps maps;
+        maps.specular_size = ENV_BASE_SIZE;
+        maps.specular_levels = ENV_LEVELS;
+        maps.irradiance_size = ENV_IRRADIANCE_SIZE;
+        maps.specular.resize(maps.specular_offset(ENV_LEVELS));
+        maps.irradiance.resize(3 * 6 * ENV_IRRADIANCE_SIZE * ENV_IRRADIANCE_SIZE);
+
+        // level 0 is the mirror, the base itself
+        for (int f = 0; f < 6; ++f)
+            for (size_t i = 0; i < base[f].size(); ++i)
+                maps.specular[f * base[f].size() + i] = to_byte(base[f][i]);
+
+        const CubeChain chain(std::move(base));
+        for (int level = 1; level < ENV_LEVELS; ++level) {
+            const float roughness = float(level) / (ENV_LEVELS - 1);
+            fill_cube(&maps.specular[maps.specular_offset(level)], ENV_BASE_SIZE >> level,
+                      [&](Vec3 n) { return prefilter_specular(chain, n, roughness); });
+        }
+        fill_cube(maps.irradiance.data(), ENV_IRRADIANCE_SIZE, [&](Vec3 n) { return convolve_irradiance(chain, n); });
+        return maps;
+    }
+
+    uint64_t hash_faces(const std::vector<std::string>& paths) {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        std::string content;
+        for (const auto& path: paths) {
+            if (not read_file(path, content))
+                throw std::runtime_error("failed to load cubemap texture " + path);
+            hash = hash_bytes(content, hash);
+        }
+        return hash;
+    }
+
+    bool read_cache(const std::string& path, uint64_t source_hash, EnvironmentMaps& maps) {
+        std::string content;
+        if (not read_file(path, content) or content.size() < sizeof(EnvCacheHeader))
+            return false;
+
+        EnvCacheHeader header;
+        std::memcpy(&header, content.data(), sizeof(header));
+        maps.specular_size = header.specular_size;
+        maps.specular_levels = header.specular_levels;
+        maps.irradiance_size = header.irradiance_size;
+        const size_t irradiance_bytes = 3 * 6 * size_t(header.irradiance_size) * header.irradiance_size;
+
+        if (std::memcmp(header.magic, ENV_CACHE_MAGIC, sizeof(header.magic)) != 0 or header.version != ENV_CACHE_VERSION
+            or header.source_hash != source_hash or header.size != content.size()
+            or header.specular_size != uint32_t(ENV_BASE_SIZE) or header.specular_levels != uint32_t(ENV_LEVELS)
+            or sizeof(header) + maps.specular_offset(ENV_LEVELS) + irradiance_bytes != content.size())
+            return false;
+
+        const char* data = content.data() + sizeof(header);
+        maps.specular.assign(data, data + maps.specular_offset(ENV_LEVELS));
+        data += maps.specular.size();
+        maps.irradiance.assign(data, data + irradiance_bytes);
+        return true;
+    }
+
+    // written aside and renamed, so that a reader never sees half a file
+    void write_cache(const std::string& path, uint64_t source_hash, const EnvironmentMaps& maps) {
+        EnvCacheHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, ENV_CACHE_MAGIC, sizeof(header.magic));
+        header.version = ENV_CACHE_VERSION;
+        header.specular_size = maps.specular_size;
+        header.specular_levels = maps.specular_levels;
+        header.irradiance_size = maps.irradiance_size;
+        header.source_hash = source_hash;
+        header.size = sizeof(header) + maps.specular.size() + maps.irradiance.size();
+
+        const std::string temp_path = path + ".tmp";
+        std::ofstream file(temp_path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(maps.specular.data()), maps.specular.size());
+        file.write(reinterpret_cast<const char*>(maps.irradiance.data()), maps.irradiance.size());
+        file.close();
+        if (not file or std::rename(temp_path.c_str(), path.c_str()) != 0) {
+            std::remove(temp_path.c_str());
+            fprintf(stderr, "failed to write environment cache %s\n", path.c_str());
+        }
+    }
+}
+
+size_t EnvironmentMaps::specular_offset(int level) const {
+    size_t offset = 0;
+    for (int l = 0; l < level; ++l)
+        offset += 3 * 6 * size_t(specular_size >> l) * (specular_size >> l);
+    return offset;
+}
+
+std::vector<float> downsample_face(const unsigned char* rgb, int size) {
+    std::vector<float> face(3 * ENV_BASE_SIZE * ENV_BASE_SIZE, 0.0f);
+
+    // a smaller face would leave texels without a source pixel, it is sampled bilinearly instead
+    if (size < ENV_BASE_SIZE) {
+        auto texel = [&](int x, int y, int c) { return float(rgb[3 * (size_t(y) * size + x) + c]); };
+        for (int ty = 0; ty < ENV_BASE_SIZE; ++ty) {
+            const float sy = std::max(0.0f, (ty + 0.5f) * size / ENV_BASE_SIZE - 0.5f);
+            const int y0 = std::min(int(sy), size - 1), y1 = std::min(y0 + 1, size - 1);
+            const float fy = sy - y0;
+            for (int tx = 0; tx < ENV_BASE_SIZE; ++tx) {
+                const float sx = std::max(0.0f, (tx + 0.5f) * size / ENV_BASE_SIZE - 0.5f);
+                const int x0 = std::min(int(sx), size - 1), x1 = std::min(x0 + 1, size - 1);
+                const float fx = sx - x0;
+                for (int c = 0; c < 3; ++c) {
+                    float top = texel(x0, y0, c) * (1 - fx) + texel(x1, y0, c) * fx;
+                    float bottom = texel(x0, y1, c) * (1 - fx) + texel(x1, y1, c) * fx;
+                    face[3 * (size_t(ty) * ENV_BASE_SIZE + tx) + c] = (top * (1 - fy) + bottom * fy) / 255.0f;
+                }
+            }
+        }
+        return face;
+    }
+
+    std::vector<int> counts(ENV_BASE_SIZE * ENV_BASE_SIZE, 0);
+    for (int y = 0; y < size; ++y) {
+        const int ty = int(int64_t(y) * ENV_BASE_SIZE / size);
+        for (int x = 0; x < size; ++x) {
+            const int t = ty * ENV_BASE_SIZE + int(int64_t(x) * ENV_BASE_SIZE / size);
+            for (int c = 0; c < 3; ++c)
+                face[3 * t + c] += rgb[3 * (size_t(y) * size + x) + c];
+            counts[t] += 1;
+        }
+    }
+    for (size_t t = 0; t < counts.size(); ++t)
+        for (int c = 0; c < 3; ++c)
+            face[3 * t + c] /= 255.0f * counts[t];
+    return face;
+}
+
+std::string environment_cache_path(const std::vector<std::string>& paths) {
+    return paths.at(0) + ".envcache";
+}
+
+EnvironmentMaps load_environment(const std::vector<std::string>& paths,
+                                 const std::function<std::vector<std::vector<float>>()>& base_faces) {
+    auto start = std::chrono::steady_clock::now();
+    const uint64_t source_hash = hash_faces(paths);
+    const std::string cache_path = environment_cache_path(paths);
+
+    EnvironmentMaps maps;
+    if (read_cache(cache_path, source_hash, maps)) {
+        maps.from_cache = true;
+    } else {
+        maps = prefilter(base_faces());
+        write_cache(cache_path, source_hash, maps);
+    }
+
+    maps.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return maps;
+}
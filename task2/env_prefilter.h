@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Prefiltered environment of a skybox, for textureLod instead of filtering per
+// fragment: a GGX specular chain, roughness level / (ENV_LEVELS - 1) at mip level,
+// level 0 being the mirror, and a cosine convolved irradiance cube. Both are RGB8
+// with faces in GL order, +X -X +Y -Y +Z -Z.
+//
+// They are computed once and cached as <first face>.envcache:
+//   EnvCacheHeader
+//   the specular levels, largest first, 6 faces each
+//   the irradiance faces
+// The header has a hash of the face files, so another skybox is filtered again.
+
+const int ENV_BASE_SIZE = 256;  // of specular level 0, the faces are resampled to it
+const int ENV_LEVELS = 6;
+const int ENV_IRRADIANCE_SIZE = 32;
+
+const char ENV_CACHE_MAGIC[8] = {'E', 'N', 'V', 'C', 'A', 'C', 'H', 'E'};
+const uint32_t ENV_CACHE_VERSION = 2;
+
+struct EnvCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t specular_size, specular_levels, irradiance_size;
+    uint64_t source_hash;
+    uint64_t size;
+};
+
+struct EnvironmentMaps {
+    int specular_size = 0, specular_levels = 0, irradiance_size = 0;
+    std::vector<unsigned char> specular;
+    std::vector<unsigned char> irradiance;
+    bool from_cache = false;
+    double seconds = 0;  // hashing and either reading the cache or filtering and writing it
+
+    // of the first face of the level in specular
+    size_t specular_offset(int level) const;
+};
+
+// ENV_BASE_SIZE face, 3 floats per texel, from a size x size RGB8 one: box filtered
+// when it is larger, sampled bilinearly when it is smaller
+std::vector<float> downsample_face(const unsigned char* rgb, int size);
+
+// The maps of the skybox of the face files, from the cache when it is for them.
+// Otherwise base_faces gives the six downsample_face results and they are filtered
+// on threads, then the cache is written.
+EnvironmentMaps load_environment(const std::vector<std::string>& paths,
+                                 const std::function<std::vector<std::vector<float>>()>& base_faces);
+
+// where load_environment keeps the cache of paths
+std::string environment_cache_path(const std::vector<std::string>& paths);
@@ -0,0 +1,29 @@
+#include "file_hash.h"
+
+#include <cstring>
+#include <fstream>
+
+bool read_file(const std::string& path, std::string& content) {
+    std::ifstream file(path, std::ios::binary);
+    if (not file)
+        return false;
+
+    file.seekg(0, std::ios::end);
+    content.resize(size_t(file.tellg()));
+    file.seekg(0);
+    file.read(&content[0], content.size());
+    return bool(file);
+}
+
+uint64_t hash_bytes(const std::string& bytes, uint64_t hash) {
+    size_t i = 0;
+    for (; i + 8 <= bytes.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes.data() + i, 8);
+        hash = (hash ^ word) * 0x100000001b3ull;
+        hash ^= hash >> 32;
+    }
+    for (; i < bytes.size(); ++i)
+        hash = (hash ^ (unsigned char)bytes[i]) * 0x100000001b3ull;
+    return hash ^ bytes.size();
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// whole file into content, false when it can't be read
+bool read_file(const std::string& path, std::string& content);
+
+// FNV-1a style over 8 byte words, chained through hash. The mesh and environment caches
+// hash their sources with it on every load.
+uint64_t hash_bytes(const std::string& bytes, uint64_t hash = 0xcbf29ce484222325ull);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <tuple>
+
+#include <GL/glew.h>
+
+// The binding state the draws change: program, vertex array, and the texture and
+// sampler of every unit. A bind of what is bound already is left out, so the draws bind
+// what they need and never unbind. Everything that binds these goes through gl_state;
+// the ImGui renderer restores what it changes. Units are GL_TEXTURE0 + i, as for
+// glActiveTexture.
+class GLState {
+private:
+    static const int UNITS = 16;
+    static const GLuint UNKNOWN = ~0u;
+
+    GLuint program = UNKNOWN;
+    GLuint vertex_array = UNKNOWN;
+    GLenum active_unit = 0;
+    GLuint textures[UNITS][2];  // GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP
+    GLuint samplers[UNITS];
+
+    // immutable, by min filter, mag filter and wrap
+    std::map<std::tuple<GLint, GLint, GLint>, GLuint> sampler_objects;
+
+public:
+    struct Stats {
+        size_t issued = 0;
+        size_t elided = 0;
+    };
+
+private:
+    Stats stats;
+
+    bool changed(GLuint& bound, GLuint value);
+    void activate(GLenum unit);
+
+public:
+    GLState();
+
+    void use_program(GLuint program);
+    void bind_vertex_array(GLuint vertex_array);
+    // target is GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP
+    void bind_texture(GLenum unit, GLenum target, GLuint texture);
+    // the texture with a sampler from sampler(), or 0 for the parameters of the texture
+    void bind_texture(GLenum unit, GLenum target, GLuint texture, GLuint sampler);
+
+    // shared sampler object of the parameters, made on first use and never changed
+    GLuint sampler(GLint min_filter, GLint mag_filter, GLint wrap);
+
+    // forgets everything, after GL code that binds on its own
+    void invalidate();
+
+    // the calls since the last take, once per frame
+    Stats take_stats();
+};
+
+extern GLState gl_state;
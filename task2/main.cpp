@@ -1,6 +1,8 @@
 #include <iostream>
 #include <vector>
 #include <chrono>
+#include <cstring>
+#include <future>
 #include <fmt/format.h>
 #include <GL/glew.h>
 
@@ -27,7 +29,10 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 
+#include "gl_state.h"
 #include "opengl_shader.h"
+#include "mesh_cache.h"
+#include "env_prefilter.h"
 
 
 static void glfw_error_callback(int error, const char *description) {
@@ -189,7 +194,7 @@ public:
 class Texture {
 private:
     int width, height;
-    GLuint texture;
+    GLuint texture, sampler;
     
 public:
     Texture(const Texture& other) = delete;
@@ -207,10 +212,11 @@ public:
             throw std::runtime_error(std::string("failed to load texture ") + path);
         
         glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
+        gl_state.bind_texture(GL_TEXTURE0, GL_TEXTURE_2D, texture);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
         
         glGenerateMipmap(GL_TEXTURE_2D);
+        sampler = gl_state.sampler(GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE);
         
         stbi_image_free(data);
     }
@@ -220,60 +226,182 @@ public:
     }
 
     void bind(GLuint slot = GL_TEXTURE0) {
-        glActiveTexture(slot);
-        glBindTexture(GL_TEXTURE_2D, texture);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    }
-
-    static void unbind(GLuint slot=GL_TEXTURE0) {
-        glActiveTexture(slot);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        gl_state.bind_texture(slot, GL_TEXTURE_2D, texture, sampler);
     }
 };
 
+// The faces are decoded on threads straight into a mapped pixel buffer, and uploaded
+// from it once all of them are there, so that the first frames don't wait for the
+// jpgs. Until then the texture is incomplete and ready() is false. RGB8 with mipmaps.
+//
+// Next to it the prefiltered environment, see env_prefilter.h: read from its cache,
+// or filtered from the faces the workers box filter to ENV_BASE_SIZE on the way, and
+// uploaded as two more cubemaps when environment_ready().
 class CubemapTexture {
 private:
-    GLuint texture;
+    GLuint texture, pbo;
+    int size, levels = 0;
+    bool uploaded = false;
+    std::shared_future<std::vector<float>> faces[6];
+
+    GLuint specular = 0, irradiance = 0;
+    bool environment_uploaded = false;
+    std::future<EnvironmentMaps> environment;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int frames = 0;
 
 public:
-    CubemapTexture(std::vector<std::string> faces) {
-        stbi_set_flip_vertically_on_load(false);
+    CubemapTexture(const CubemapTexture& other) = delete;
+    CubemapTexture& operator=(const CubemapTexture& other) = delete;
+
+    CubemapTexture(std::vector<std::string> paths) {
+        // the size from the headers, all faces the same square
+        for (int i = 0; i < 6; i++) {
+            int width, height, comps;
+            if (not stbi_info(paths[i].c_str(), &width, &height, &comps))
+                throw std::runtime_error(std::string("failed to load cubemap texture ") + paths[i].c_str());
+            if (width != height or (i > 0 and width != size))
+                throw std::runtime_error(std::string("cubemap faces are not squares of one size: ") + paths[i].c_str());
+            size = width;
+        }
 
         glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+        gl_state.bind_texture(GL_TEXTURE0, GL_TEXTURE_CUBE_MAP, texture);
+        for (int s = size; s > 0; s /= 2, ++levels)
+            for (int i = 0; i < 6; i++)
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, levels, GL_RGB8, s, s, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+        const size_t face_bytes = size_t(size) * size * 3;
+        glGenBuffers(1, &pbo);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, 6 * face_bytes, nullptr, GL_STREAM_DRAW);
+        auto* mapped = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, 6 * face_bytes,
+                                                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (not mapped)
+            throw std::runtime_error("failed to map the cubemap pixel buffer");
+
+        for (int i = 0; i < 6; i++)
+            faces[i] = std::async(std::launch::async, [path = paths[i], dst = mapped + i * face_bytes, face_bytes, size = size]() {
+                // stbi_set_flip_vertically_on_load is global, Texture sets it on the main thread
+                stbi_set_flip_vertically_on_load_thread(false);
+                int width, height, comps;
+                unsigned char* data = stbi_load(path.c_str(), &width, &height, &comps, STBI_rgb);
+                if (not data)
+                    throw std::runtime_error("failed to load cubemap texture " + path);
+
+                std::memcpy(dst, data, face_bytes);
+                std::vector<float> base = downsample_face(data, size);
+                stbi_image_free(data);
+                return base;
+            });
+
+        // a copy of the futures, upload() reads them on the main thread at the same time
+        std::vector<std::shared_future<std::vector<float>>> base_faces(faces, faces + 6);
+        environment = std::async(std::launch::async, [paths, base_faces]() {
+            return load_environment(paths, [&]() {
+                std::vector<std::vector<float>> base;
+                for (const auto& face: base_faces)
+                    base.push_back(face.get());
+                return base;
+            });
+        });
+    }
 
-        for (int i = 0; i < 6; i++) {
-            int width, height, nrChannels;
+    bool ready() const {
+        return uploaded;
+    }
 
-            unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
+    bool environment_ready() const {
+        return environment_uploaded;
+    }
 
-            if (not data)
-                throw std::runtime_error(std::string("failed to load cubemap texture ") + faces[i].c_str());
+    // Once every frame: when all faces are decoded, uploads them from the pixel buffer
+    // and builds the mipmaps, and when the environment is there, uploads it. Returns ready().
+    bool upload() {
+        upload_environment();
+        if (uploaded)
+            return true;
+
+        frames += 1;
+        for (auto& face: faces)
+            if (face.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                return false;
+        for (auto& face: faces)
+            face.get();
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        gl_state.bind_texture(GL_TEXTURE0, GL_TEXTURE_CUBE_MAP, texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        const size_t face_bytes = size_t(size) * size * 3;
+        for (int i = 0; i < 6; i++)
+            glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, 0, 0, size, size, GL_RGB, GL_UNSIGNED_BYTE,
+                            (void *)(i * face_bytes));
+        glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &pbo);
+        uploaded = true;
+
+        // the mip chain adds a third
+        const double megabytes = 6.0 * face_bytes * 4 / 3 / (1 << 20);
+        std::cerr << fmt::format("cubemap: 6 x {}x{} ready after {:.0f} ms and {} frames, {:.1f} MB as RGB8 with mipmaps "
+                                 "(was {:.1f} MB as RGB16F without)\n", size, size,
+                                 std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+                                 frames, megabytes, 12.0 * face_bytes / (1 << 20));
+        return true;
+    }
 
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
+    void upload_environment() {
+        if (environment_uploaded or environment.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return;
+
+        const EnvironmentMaps maps = environment.get();
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
+        glGenTextures(1, &specular);
+        gl_state.bind_texture(GL_TEXTURE0, GL_TEXTURE_CUBE_MAP, specular);
+        for (int level = 0; level < maps.specular_levels; ++level) {
+            const int s = maps.specular_size >> level;
+            for (int i = 0; i < 6; i++)
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, level, GL_RGB8, s, s, 0, GL_RGB, GL_UNSIGNED_BYTE,
+                             &maps.specular[maps.specular_offset(level) + 3 * size_t(i) * s * s]);
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, maps.specular_levels - 1);
+
+        const int s = maps.irradiance_size;
+        glGenTextures(1, &irradiance);
+        gl_state.bind_texture(GL_TEXTURE0, GL_TEXTURE_CUBE_MAP, irradiance);
+        for (int i = 0; i < 6; i++)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB8, s, s, 0, GL_RGB, GL_UNSIGNED_BYTE,
+                         &maps.irradiance[3 * size_t(i) * s * s]);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, 0);
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        environment_uploaded = true;
+
+        std::cerr << fmt::format("environment: {} levels from {}x{}, irradiance {}x{}, {} in {:.0f} ms\n",
+                                 maps.specular_levels, maps.specular_size, maps.specular_size, s, s,
+                                 maps.from_cache ? "read from cache" : "filtered, cache written", maps.seconds * 1000);
     }
 
     void bind(GLuint slot = GL_TEXTURE0) {
-        glActiveTexture(slot);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
-
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        gl_state.bind_texture(slot, GL_TEXTURE_CUBE_MAP, texture,
+                              gl_state.sampler(GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE));
     }
 
-    static void unbind(GLuint slot=GL_TEXTURE0) {
-        glActiveTexture(slot);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    // the specular chain and the irradiance, once environment_ready()
+    void bind_environment(GLuint specular_slot, GLuint irradiance_slot) {
+        gl_state.bind_texture(specular_slot, GL_TEXTURE_CUBE_MAP, specular,
+                              gl_state.sampler(GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE));
+        gl_state.bind_texture(irradiance_slot, GL_TEXTURE_CUBE_MAP, irradiance,
+                              gl_state.sampler(GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE));
     }
 };
 
@@ -297,130 +425,104 @@ public:
 
 class ObjModel: public ModelBase {
 private:
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-
     shader_t shader = std::move(shader_t("obj-shader.vs", "obj-shader.fs"));
+    struct {
+        uniform_t<glm::mat4> mvp;
+        uniform_t<glm::vec4> color;
+        uniform_t<glm::vec3> camera;
+        uniform_t<float> base_color_weight, refract_coeff, roughness, env_max_lod;
+        uniform_t<int> is_schlick, environment_ready, tex, env_specular, env_irradiance;
+    } u;
     Texture texture = std::move(Texture("checkers.jpg"));
-    CubemapTexture skybox;
+    CubemapTexture& skybox;
     glm::vec3 camera;
-    float u_base_color_weight = 0.2, u_refract_coeff = 1.5;
+    float u_base_color_weight = 0.2, u_refract_coeff = 1.5, u_roughness = 0;
     int u_is_schlick;
     
     GLuint vbo, vao, ebo;
     int num_triangles = 0;
 
-    void init_opengl_objects() {
-        for (int tp = 0; tp < 3; ++tp) {
-            float mn = 1e9, mx = -1e9;
-
-            for (int i = tp; i < attrib.vertices.size(); i += 3) {
-                mn = std::min(mn, attrib.vertices[i]);
-                mx = std::max(mx, attrib.vertices[i]);
-            }
-
-            float mid = mn + (mx - mn) / 2;
-            for (int i = tp; i < attrib.vertices.size(); i += 3) {
-                attrib.vertices[i] -= mid;
-            }
-        }
-
-        std::vector<float> vertices;
-        std::vector<unsigned int> triangle_indices;
-
-        std::map<std::pair<int, int>, int> idmap;
-        auto get_vertex_id = [&](int vertex, int normal) {
-            if (not idmap.count(std::make_pair(vertex, normal))) {
-                int new_id = idmap.size();
-                idmap[std::make_pair(vertex, normal)] = new_id;
-
-                vertices.push_back(attrib.vertices[3 * vertex]);
-                vertices.push_back(attrib.vertices[3 * vertex + 1]);
-                vertices.push_back(attrib.vertices[3 * vertex + 2]);
-
-                vertices.push_back(attrib.normals[3 * normal]);
-                vertices.push_back(attrib.normals[3 * normal + 1]);
-                vertices.push_back(attrib.normals[3 * normal + 2]);
-            }
-
-            return idmap[std::make_pair(vertex, normal)];
-        };
-
-        for (int s = 0; s < shapes.size(); ++s) {
-            assert(shapes[s].mesh.indices.size() % 3 == 0);
-
-            for (int v = 0; v < shapes[s].mesh.indices.size(); ++v) {
-                tinyobj::index_t idx = shapes[s].mesh.indices[v];
-                triangle_indices.push_back(get_vertex_id(idx.vertex_index, idx.normal_index));
-            }
-        }
-
-        num_triangles = triangle_indices.size() / 3;
+    void init_opengl_objects(const MeshBuffers& mesh) {
+        num_triangles = mesh.index_count() / 3;
 
         glGenVertexArrays(1, &vao);
         glGenBuffers(1, &vbo);
         glGenBuffers(1, &ebo);
 
-        glBindVertexArray(vao);
+        gl_state.bind_vertex_array(vao);
 
         glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices[0]) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(float) * mesh.floats_per_vertex() * mesh.vertex_count(), mesh.vertices(), GL_STATIC_DRAW);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(triangle_indices[0]) * triangle_indices.size(), triangle_indices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * mesh.index_count(), mesh.indices(), GL_STATIC_DRAW);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
         glEnableVertexAttribArray(1);
 
         glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+        gl_state.bind_vertex_array(0);
     }
     
 protected:
     virtual void render_mvp(glm::mat4 mvp) {
         shader.use();
-        shader.set_uniform("u_mvp", glm::value_ptr(mvp));
-        shader.set_uniform("u_tex", int(0));
-        shader.set_uniformv("u_color", glm::vec4 {0.8f, 0.8f, 0.f, 1.0f});
-        shader.set_uniformv("u_camera", camera);
-        shader.set_uniform("u_base_color_weight", u_base_color_weight);
-        shader.set_uniform("u_refract_coeff", u_refract_coeff);
-        shader.set_uniform("u_is_schlick", u_is_schlick);
+        shader.set(u.mvp, mvp);
+        shader.set(u.tex, 0);
+        shader.set(u.color, glm::vec4 {0.8f, 0.8f, 0.f, 1.0f});
+        shader.set(u.camera, camera);
+        shader.set(u.base_color_weight, u_base_color_weight);
+        shader.set(u.refract_coeff, u_refract_coeff);
+        shader.set(u.is_schlick, u_is_schlick);
+        shader.set(u.roughness, u_roughness);
+        shader.set(u.environment_ready, skybox.environment_ready());
+        shader.set(u.env_max_lod, float(ENV_LEVELS - 1));
+        shader.set(u.env_specular, 1);
+        shader.set(u.env_irradiance, 2);
         skybox.bind();
+        if (skybox.environment_ready())
+            skybox.bind_environment(GL_TEXTURE1, GL_TEXTURE2);
 
-        glBindVertexArray(vao);
+        gl_state.bind_vertex_array(vao);
         glDrawElements(GL_TRIANGLES, num_triangles * 3, GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        skybox.unbind();
     }
 
 public:
     ObjModel(const char* filename, CubemapTexture& skybox): skybox(skybox) {
-        std::string err;
-        bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, filename);
-        
-        if (!err.empty())
-            fprintf(stderr, "loading %s, error: %s\n", filename, err.c_str());
-        
-        if (!ret) {
-            fprintf(stderr, "failed to load %s\n", filename);
-            throw std::runtime_error(std::string("failed to load ") + filename);
-        }
-
-        init_opengl_objects();
+        u.mvp = shader.uniform<glm::mat4>("u_mvp");
+        u.color = shader.uniform<glm::vec4>("u_color");
+        u.camera = shader.uniform<glm::vec3>("u_camera");
+        u.base_color_weight = shader.uniform<float>("u_base_color_weight");
+        u.refract_coeff = shader.uniform<float>("u_refract_coeff");
+        u.roughness = shader.uniform<float>("u_roughness");
+        u.env_max_lod = shader.uniform<float>("u_env_max_lod");
+        u.is_schlick = shader.uniform<int>("u_is_schlick");
+        u.environment_ready = shader.uniform<int>("u_environment_ready");
+        u.tex = shader.uniform<int>("u_tex");
+        u.env_specular = shader.uniform<int>("u_env_specular");
+        u.env_irradiance = shader.uniform<int>("u_env_irradiance");
+
+        MeshLoadStats stats;
+        MeshBuffers mesh(filename, false, &stats);
+        std::cerr << fmt::format("loading {}: {} in {:.1f} ms\n", filename,
+                                 stats.from_cache ? "mapped cache" : "parsed, cache written", stats.total_seconds * 1000);
+        if (not stats.from_cache)
+            std::cerr << fmt::format("  vertex cache ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}\n", stats.cache_before.acmr,
+                                     stats.cache_after.acmr, stats.cache_before.atvr, stats.cache_after.atvr);
+
+        init_opengl_objects(mesh);
     }
 
     void set_camera(glm::vec3 camera) {
         this->camera = camera;
     }
 
-    void set_light(float u_base_color_weight, float u_refract_coeff, int u_is_schlick) {
+    void set_light(float u_base_color_weight, float u_refract_coeff, int u_is_schlick, float u_roughness) {
         this->u_base_color_weight = u_base_color_weight;
         this->u_refract_coeff = u_refract_coeff;
         this->u_is_schlick = u_is_schlick;
+        this->u_roughness = u_roughness;
     }
 
     glm::mat4 model_matrix() {
@@ -434,11 +536,16 @@ private:
     GLuint vbo, ebo, vao;
 
     shader_t shader;
+    uniform_t<glm::mat4> u_mvp;
+    uniform_t<int> u_tex;
     CubemapTexture& cubemap;
     int num_triangles;
 
 public:
     Skybox(CubemapTexture &cubemap) : shader("skybox-shader.vs", "skybox-shader.fs"), cubemap(cubemap) {
+        u_mvp = shader.uniform<glm::mat4>("u_mvp");
+        u_tex = shader.uniform<int>("u_tex");
+
         float vertices[] = {
                 -1, -1, -1,
                 -1, -1, +1,
@@ -463,7 +570,7 @@ public:
         glGenBuffers(1, &vbo);
         glGenBuffers(1, &ebo);
 
-        glBindVertexArray(vao);
+        gl_state.bind_vertex_array(vao);
         glBindBuffer(GL_ARRAY_BUFFER, vbo);
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
@@ -475,20 +582,21 @@ public:
         glEnableVertexAttribArray(0);
 
         glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+        gl_state.bind_vertex_array(0);
     }
 protected:
     virtual void render_mvp(glm::mat4 mvp) {
+        // the clear color until the faces are there
+        if (not cubemap.ready())
+            return;
+
         shader.use();
-        shader.set_uniform("u_mvp", glm::value_ptr(mvp));
-        shader.set_uniform("u_tex", int(0));
+        shader.set(u_mvp, mvp);
+        shader.set(u_tex, 0);
         cubemap.bind();
 
-        glBindVertexArray(vao);
+        gl_state.bind_vertex_array(vao);
         glDrawElements(GL_TRIANGLES, num_triangles * 3, GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        cubemap.unbind();
     }
 };
 
@@ -548,9 +656,14 @@ int main(int, char **) {
     float u_base_color_weight = 0.2;
     float u_refract_coeff = 1.5;
     int u_is_schlick = 0;
+    float u_roughness = 0;
     
     opengl.main_loop([&]() {
         process_drag();
+        cubemap.upload();
+        // of the last frame
+        const uniform_stats_t uniform_stats = shader_t::take_uniform_stats();
+        const GLState::Stats bind_stats = gl_state.take_stats();
 
         auto camera = glm::rotate<float>(glm::rotate<float>(glm::vec3 {0, 0, distance}, ang_y, glm::vec3 {1, 0, 0}),
                                          ang_xz, glm::vec3 {0, 1, 0});
@@ -576,6 +689,10 @@ int main(int, char **) {
         ImGui::SliderFloat("basecolor", &u_base_color_weight, 0, 1);
         ImGui::SliderFloat("refract_coeff", &u_refract_coeff, 1, 2);
         ImGui::SliderInt("is_schlick", &u_is_schlick, 0, 1);
+        ImGui::SliderFloat("roughness", &u_roughness, 0, 1);
+        ImGui::Text("uniforms: %zu glUniform, %zu unchanged left out, %zu location lookups saved",
+                    uniform_stats.issued, uniform_stats.unchanged, uniform_stats.lookups);
+        ImGui::Text("binds: %zu issued, %zu already bound left out", bind_stats.issued, bind_stats.elided);
         ImGui::End();
 
         // Generate gui render commands
@@ -584,7 +701,7 @@ int main(int, char **) {
         // Execute gui render commands using OpenGL backend
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
-        model.set_light(u_base_color_weight, u_refract_coeff, u_is_schlick);
+        model.set_light(u_base_color_weight, u_refract_coeff, u_is_schlick, u_roughness);
     });
 
     return 0;
@@ -0,0 +1,262 @@
+#include "mesh_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "file_hash.h"
+#include "mesh_optimize.h"
+#include "tiny_obj_loader.h"
+#include "vertex_dedup.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    double seconds_since(Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    size_t align16(size_t n) {
+        return (n + 15) & ~size_t(15);
+    }
+
+    // the obj and the mtllib files it names, which tinyobj opens relative to the working directory
+    uint64_t hash_sources(const std::string& obj_path) {
+        std::string obj;
+        if (not read_file(obj_path, obj))
+            throw std::runtime_error("failed to load " + obj_path);
+        uint64_t hash = hash_bytes(obj);
+
+        std::istringstream lines(obj);
+        std::string line;
+        while (std::getline(lines, line)) {
+            if (line.compare(0, 7, "mtllib ") != 0)
+                continue;
+
+            std::istringstream names(line.substr(7));
+            std::string name, mtl;
+            while (names >> name) {
+                hash = hash_bytes(name, hash);
+                if (read_file(name, mtl))
+                    hash = hash_bytes(mtl, hash);
+            }
+        }
+        return hash;
+    }
+
+    // triangles reordered for the vertex cache, then clusters of them for overdraw, then
+    // the vertices in order of first use
+    void optimize_order(DedupedMesh& mesh, const tinyobj::attrib_t& attrib, MeshLoadStats& stats) {
+        auto start = Clock::now();
+        stats.cache_before = analyze_vertex_cache(mesh.indices, mesh.vertices.size());
+
+        std::vector<float> positions;
+        positions.reserve(3 * mesh.vertices.size());
+        for (const VertexKey& key: mesh.vertices)
+            positions.insert(positions.end(), attrib.vertices.begin() + 3 * key.vertex,
+                             attrib.vertices.begin() + 3 * key.vertex + 3);
+
+        std::vector<size_t> clusters = optimize_vertex_cache(mesh.indices, mesh.vertices.size());
+        optimize_overdraw(mesh.indices, clusters, positions);
+
+        std::vector<VertexKey> vertices;
+        for (unsigned int v: optimize_vertex_fetch(mesh.indices, mesh.vertices.size()))
+            vertices.push_back(mesh.vertices[v]);
+        mesh.vertices.swap(vertices);
+
+        stats.cache_after = analyze_vertex_cache(mesh.indices, mesh.vertices.size());
+        stats.optimize_seconds = seconds_since(start);
+    }
+
+    // the cache file contents for obj_path, see mesh_cache.h
+    std::vector<unsigned char> build_cache(const std::string& obj_path, bool with_material, uint64_t source_hash,
+                                           MeshLoadStats& stats) {
+        auto start = Clock::now();
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string err;
+        bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, obj_path.c_str());
+
+        if (!err.empty())
+            fprintf(stderr, "loading %s, error: %s\n", obj_path.c_str(), err.c_str());
+
+        if (!ret)
+            throw std::runtime_error("failed to load " + obj_path);
+        stats.parse_seconds = seconds_since(start);
+
+        start = Clock::now();
+        for (int tp = 0; tp < 3; ++tp) {
+            float mn = 1e9, mx = -1e9;
+
+            for (size_t i = tp; i < attrib.vertices.size(); i += 3) {
+                mn = std::min(mn, attrib.vertices[i]);
+                mx = std::max(mx, attrib.vertices[i]);
+            }
+
+            float mid = mn + (mx - mn) / 2;
+            for (size_t i = tp; i < attrib.vertices.size(); i += 3) {
+                attrib.vertices[i] -= mid;
+            }
+        }
+
+        DedupedMesh mesh = dedup_vertices(shapes, with_material);
+        optimize_order(mesh, attrib, stats);
+
+        MeshCacheHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+        header.version = MESH_CACHE_VERSION;
+        header.floats_per_vertex = with_material ? 9 : 6;
+        header.source_hash = source_hash;
+        header.vertex_count = uint32_t(mesh.vertices.size());
+        header.index_count = uint32_t(mesh.indices.size());
+        header.material_count = uint32_t(materials.size());
+        header.vertices_offset = align16(sizeof(header));
+        header.indices_offset = align16(header.vertices_offset + sizeof(float) * header.floats_per_vertex * header.vertex_count);
+        header.materials_offset = align16(header.indices_offset + sizeof(unsigned int) * header.index_count);
+        header.size = header.materials_offset + sizeof(MeshCacheMaterial) * header.material_count;
+
+        std::vector<unsigned char> data(header.size, 0);
+        std::memcpy(data.data(), &header, sizeof(header));
+
+        float* vertices = reinterpret_cast<float*>(data.data() + header.vertices_offset);
+        for (const VertexKey& key: mesh.vertices) {
+            for (int i = 0; i < 3; ++i)
+                *vertices++ = attrib.vertices[3 * key.vertex + i];
+            // no normal is a zero one
+            for (int i = 0; i < 3; ++i)
+                *vertices++ = key.normal >= 0 ? attrib.normals[3 * key.normal + i] : 0.0f;
+            // faces without a material (a missing mtl file) are light grey
+            bool has_material = key.material >= 0 and key.material < int(materials.size());
+            if (with_material)
+                for (int i = 0; i < 3; ++i)
+                    *vertices++ = has_material ? materials[key.material].diffuse[i] : 0.8f;
+        }
+        std::memcpy(data.data() + header.indices_offset, mesh.indices.data(), sizeof(unsigned int) * mesh.indices.size());
+
+        auto* table = reinterpret_cast<MeshCacheMaterial*>(data.data() + header.materials_offset);
+        for (size_t m = 0; m < materials.size(); ++m) {
+            std::strncpy(table[m].name, materials[m].name.c_str(), sizeof(table[m].name) - 1);
+            std::copy(materials[m].diffuse, materials[m].diffuse + 3, table[m].diffuse);
+        }
+
+        stats.build_seconds = seconds_since(start);
+        return data;
+    }
+
+    // header fits the file and was written for these sources and layout
+    bool valid_cache(const unsigned char* data, size_t size, bool with_material, uint64_t source_hash) {
+        if (size < sizeof(MeshCacheHeader))
+            return false;
+
+        MeshCacheHeader header;
+        std::memcpy(&header, data, sizeof(header));
+        if (not (std::memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) == 0
+                 and header.version == MESH_CACHE_VERSION
+                 and header.floats_per_vertex == (with_material ? 9u : 6u)
+                 and header.source_hash == source_hash
+                 and header.size == size
+                 and header.index_count % 3 == 0
+                 and header.vertices_offset + sizeof(float) * header.floats_per_vertex * header.vertex_count <= header.indices_offset
+                 and header.indices_offset + sizeof(unsigned int) * header.index_count <= header.materials_offset
+                 and header.materials_offset + sizeof(MeshCacheMaterial) * header.material_count <= size))
+            return false;
+
+        // a damaged file can have a good header and still index past the vertices
+        const unsigned int* indices = reinterpret_cast<const unsigned int*>(data + header.indices_offset);
+        for (size_t i = 0; i < header.index_count; ++i)
+            if (indices[i] >= header.vertex_count)
+                return false;
+        return true;
+    }
+}
+
+std::string mesh_cache_path(const std::string& obj_path) {
+    return obj_path + ".meshcache";
+}
+
+MeshBuffers::MeshBuffers(const std::string& obj_path, bool with_material, MeshLoadStats* stats_out) {
+    MeshLoadStats stats;
+    auto start = Clock::now();
+    const uint64_t source_hash = hash_sources(obj_path);
+    stats.hash_seconds = seconds_since(start);
+
+    const std::string cache_path = mesh_cache_path(obj_path);
+    auto io_start = Clock::now();
+
+#ifdef _WIN32
+    std::string content;
+    if (read_file(cache_path, content)
+        and valid_cache(reinterpret_cast<const unsigned char*>(content.data()), content.size(), with_material, source_hash)) {
+        owned.assign(content.begin(), content.end());
+        data = owned.data();
+        stats.from_cache = true;
+    }
+#else
+    int fd = open(cache_path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 and st.st_size > 0) {
+            void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                if (valid_cache(static_cast<const unsigned char*>(mapped), st.st_size, with_material, source_hash)) {
+                    data = static_cast<const unsigned char*>(mapped);
+                    mapped_size = st.st_size;
+                    stats.from_cache = true;
+                } else {
+                    munmap(mapped, st.st_size);
+                }
+            }
+        }
+        close(fd);
+    }
+#endif
+
+    if (stats.from_cache) {
+        stats.io_seconds = seconds_since(io_start);
+    } else {
+        owned = build_cache(obj_path, with_material, source_hash, stats);
+        data = owned.data();
+
+        // written aside and renamed, so that a reader never maps half a file
+        io_start = Clock::now();
+        const std::string temp_path = cache_path + ".tmp";
+        std::ofstream file(temp_path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(owned.data()), owned.size());
+        file.close();
+        if (not file or std::rename(temp_path.c_str(), cache_path.c_str()) != 0) {
+            std::remove(temp_path.c_str());
+            fprintf(stderr, "failed to write mesh cache %s\n", cache_path.c_str());
+        }
+        stats.io_seconds = seconds_since(io_start);
+    }
+
+    stats.total_seconds = seconds_since(start);
+    if (stats_out)
+        *stats_out = stats;
+}
+
+MeshBuffers::~MeshBuffers() {
+#ifndef _WIN32
+    if (mapped_size)
+        munmap(const_cast<unsigned char*>(data), mapped_size);
+#endif
+}
+
+std::vector<MeshCacheMaterial> MeshBuffers::materials() const {
+    const auto* table = reinterpret_cast<const MeshCacheMaterial*>(data + header().materials_offset);
+    return std::vector<MeshCacheMaterial>(table, table + header().material_count);
+}
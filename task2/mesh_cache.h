@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mesh_optimize.h"
+
+// Binary cache of the buffers ObjModel uploads, written next to the obj as
+// <file.obj>.meshcache after it was parsed once:
+//   MeshCacheHeader
+//   vertex_count * floats_per_vertex floats, interleaved as in the vao
+//   index_count unsigned ints, three per triangle
+//   material_count MeshCacheMaterial
+// each part 16 byte aligned. The header has a hash of the obj and its mtllib files,
+// so an edited source is parsed again. Little endian, as written.
+
+const char MESH_CACHE_MAGIC[8] = {'M', 'E', 'S', 'H', 'C', 'A', 'C', 'H'};
+const uint32_t MESH_CACHE_VERSION = 3;
+
+struct MeshCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t floats_per_vertex;
+    uint64_t source_hash;
+    uint32_t vertex_count, index_count, material_count, reserved;
+    uint64_t vertices_offset, indices_offset, materials_offset, size;
+};
+
+struct MeshCacheMaterial {
+    char name[64];
+    float diffuse[3];
+    float reserved;
+};
+
+struct MeshLoadStats {
+    bool from_cache = false;
+    double hash_seconds = 0;      // of the sources, on every load
+    double parse_seconds = 0;     // tinyobj
+    double build_seconds = 0;     // centering, dedup and interleaving
+    double optimize_seconds = 0;  // triangle and vertex order, part of build
+    double io_seconds = 0;        // mapping the cache, or writing it
+    double total_seconds = 0;
+    VertexCacheStats cache_before, cache_after;  // of the file order and the optimized one, when built
+};
+
+// An obj file as interleaved position, normal and, with materials, diffuse color,
+// centered like ObjModel does it, with triangles and vertices in the order of
+// mesh_optimize.h. Either a mapping of the cache file or the same bytes
+// in memory when the cache was just built.
+class MeshBuffers {
+private:
+    const unsigned char* data = nullptr;
+    std::vector<unsigned char> owned;
+    size_t mapped_size = 0;
+
+    const MeshCacheHeader& header() const {
+        return *reinterpret_cast<const MeshCacheHeader*>(data);
+    }
+
+public:
+    // with_material gives 9 floats per vertex instead of 6, with the diffuse color
+    MeshBuffers(const std::string& obj_path, bool with_material, MeshLoadStats* stats = nullptr);
+    ~MeshBuffers();
+
+    MeshBuffers(const MeshBuffers& other) = delete;
+    MeshBuffers& operator=(const MeshBuffers& other) = delete;
+
+    int floats_per_vertex() const {
+        return header().floats_per_vertex;
+    }
+
+    size_t vertex_count() const {
+        return header().vertex_count;
+    }
+
+    size_t index_count() const {
+        return header().index_count;
+    }
+
+    const float* vertices() const {
+        return reinterpret_cast<const float*>(data + header().vertices_offset);
+    }
+
+    const unsigned int* indices() const {
+        return reinterpret_cast<const unsigned int*>(data + header().indices_offset);
+    }
+
+    std::vector<MeshCacheMaterial> materials() const;
+};
+
+// where MeshBuffers keeps the cache of obj_path
+std::string mesh_cache_path(const std::string& obj_path);
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Triangle and vertex order of an indexed triangle list, for the post-transform
+// vertex cache, overdraw and vertex fetch, after Sander, Nehab and Barczak, "Fast
+// Triangle Reordering for Vertex Locality and Reduced Overdraw" (Tipsify).
+
+// entries of the simulated FIFO post-transform cache
+const int VERTEX_CACHE_SIZE = 16;
+
+struct VertexCacheStats {
+    double acmr = 0;  // vertex shader runs per triangle, 0.5 at best, 3 at worst
+    double atvr = 0;  // vertex shader runs per vertex, 1 at best
+};
+
+// runs of the indices through a FIFO cache of cache_size vertices
+VertexCacheStats analyze_vertex_cache(const std::vector<unsigned int>& indices, size_t vertex_count,
+                                      int cache_size = VERTEX_CACHE_SIZE);
+
+// Reorders the triangles with Tipsify. Returns where the triangles are cut into
+// clusters for optimize_overdraw, as offsets into indices, starting with 0. With every
+// cluster drawn from an empty cache, the clusters up to any cut miss at most threshold
+// times what their triangles miss in the Tipsify order, and all of them together do too.
+std::vector<size_t> optimize_vertex_cache(std::vector<unsigned int>& indices, size_t vertex_count,
+                                          int cache_size = VERTEX_CACHE_SIZE, float threshold = 1.05f);
+
+// Reorders the clusters so that the ones facing out of the mesh come first, which
+// draws the occluders before what they hide. positions are 3 floats per vertex. The
+// order is kept, and false returned, when the sorted one would have an ACMR above
+// threshold times that of indices.
+bool optimize_overdraw(std::vector<unsigned int>& indices, const std::vector<size_t>& clusters,
+                       const std::vector<float>& positions, int cache_size = VERTEX_CACHE_SIZE,
+                       float threshold = 1.05f);
+
+// Renumbers the vertices in order of first use. Returns the old vertex of every new
+// one, unused vertices are dropped.
+std::vector<unsigned int> optimize_vertex_fetch(std::vector<unsigned int>& indices, size_t vertex_count);
@@ -1,9 +1,13 @@
 #include "opengl_shader.h"
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+#include "gl_state.h"
+
 namespace
 {
    std::string read_shader_code(const std::string & fname)
@@ -21,8 +25,75 @@ namespace
       return file_stream.str();
 
    }
+
+   // the type set() takes for a uniform declared as type
+   GLenum value_type(GLenum type)
+   {
+      switch (type)
+      {
+      case GL_FLOAT: case GL_FLOAT_VEC2: case GL_FLOAT_VEC3: case GL_FLOAT_VEC4:
+      case GL_FLOAT_MAT2: case GL_FLOAT_MAT3: case GL_FLOAT_MAT4:
+      case GL_DOUBLE: case GL_DOUBLE_VEC2: case GL_DOUBLE_VEC3: case GL_DOUBLE_VEC4:
+      case GL_INT_VEC2: case GL_INT_VEC3: case GL_INT_VEC4:
+      case GL_UNSIGNED_INT: case GL_UNSIGNED_INT_VEC2: case GL_UNSIGNED_INT_VEC3: case GL_UNSIGNED_INT_VEC4:
+         return type;
+      case GL_BOOL_VEC2: return GL_INT_VEC2;
+      case GL_BOOL_VEC3: return GL_INT_VEC3;
+      case GL_BOOL_VEC4: return GL_INT_VEC4;
+      default:
+         return GL_INT;  // int, bool, samplers and images
+      }
+   }
+
+   size_t value_bytes(GLenum type)
+   {
+      switch (type)
+      {
+      case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_UNSIGNED_INT_VEC2: case GL_DOUBLE: return 8;
+      case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_UNSIGNED_INT_VEC3: return 12;
+      case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_UNSIGNED_INT_VEC4: case GL_FLOAT_MAT2: case GL_DOUBLE_VEC2: return 16;
+      case GL_DOUBLE_VEC3: return 24;
+      case GL_DOUBLE_VEC4: return 32;
+      case GL_FLOAT_MAT3: return 36;
+      case GL_FLOAT_MAT4: return 64;
+      default: return 4;
+      }
+   }
+
+   // double uniforms need GL 4.0 or ARB_gpu_shader_fp64
+   void upload(GLint location, GLenum type, const void* values, int count)
+   {
+      auto f = static_cast<const GLfloat*>(values);
+      auto i = static_cast<const GLint*>(values);
+      auto u = static_cast<const GLuint*>(values);
+      auto d = static_cast<const GLdouble*>(values);
+      switch (type)
+      {
+      case GL_FLOAT: glUniform1fv(location, count, f); break;
+      case GL_FLOAT_VEC2: glUniform2fv(location, count, f); break;
+      case GL_FLOAT_VEC3: glUniform3fv(location, count, f); break;
+      case GL_FLOAT_VEC4: glUniform4fv(location, count, f); break;
+      case GL_FLOAT_MAT2: glUniformMatrix2fv(location, count, GL_FALSE, f); break;
+      case GL_FLOAT_MAT3: glUniformMatrix3fv(location, count, GL_FALSE, f); break;
+      case GL_FLOAT_MAT4: glUniformMatrix4fv(location, count, GL_FALSE, f); break;
+      case GL_DOUBLE: glUniform1dv(location, count, d); break;
+      case GL_DOUBLE_VEC2: glUniform2dv(location, count, d); break;
+      case GL_DOUBLE_VEC3: glUniform3dv(location, count, d); break;
+      case GL_DOUBLE_VEC4: glUniform4dv(location, count, d); break;
+      case GL_INT_VEC2: glUniform2iv(location, count, i); break;
+      case GL_INT_VEC3: glUniform3iv(location, count, i); break;
+      case GL_INT_VEC4: glUniform4iv(location, count, i); break;
+      case GL_UNSIGNED_INT: glUniform1uiv(location, count, u); break;
+      case GL_UNSIGNED_INT_VEC2: glUniform2uiv(location, count, u); break;
+      case GL_UNSIGNED_INT_VEC3: glUniform3uiv(location, count, u); break;
+      case GL_UNSIGNED_INT_VEC4: glUniform4uiv(location, count, u); break;
+      default: glUniform1iv(location, count, i); break;
+      }
+   }
 }
 
+uniform_stats_t shader_t::stats_;
+
 shader_t::shader_t(const std::string& vertex_code_fname, const std::string& fragment_code_fname)
 {
    const auto vertex_code = read_shader_code(vertex_code_fname);
@@ -56,45 +127,133 @@ void shader_t::link() {
    check_linking_error();
    glDeleteShader(vertex_id_);
    glDeleteShader(fragment_id_);
+   list_uniforms();
+}
+
+// uniform block members have no location and are left out
+void shader_t::list_uniforms() {
+   GLint count = 0, max_length = 0;
+   glGetProgramiv(program_id_, GL_ACTIVE_UNIFORMS, &count);
+   glGetProgramiv(program_id_, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+   std::vector<char> buffer(max_length + 1);
+
+   for (GLint u = 0; u < count; ++u)
+   {
+      GLsizei length;
+      GLint size;
+      GLenum type;
+      glGetActiveUniform(program_id_, u, GLsizei(buffer.size()), &length, &size, &type, buffer.data());
+      std::string name(buffer.data(), length);
+
+      // arrays are listed as name[0], their elements may not have consecutive locations
+      const bool is_array = name.size() > 3 and name.compare(name.size() - 3, 3, "[0]") == 0;
+      if (is_array)
+         name.resize(name.size() - 3);
+      for (GLint e = 0; e < size; ++e)
+      {
+         const std::string element = is_array ? name + "[" + std::to_string(e) + "]" : name;
+         const GLint location = glGetUniformLocation(program_id_, element.c_str());
+         if (location < 0)
+            continue;
+
+         if (e == 0)
+            slots_[name] = int(uniforms_.size());
+         slots_[element] = int(uniforms_.size());
+         uniforms_.push_back(uniform_slot_t {location, value_type(type), size - e, {}});
+      }
+   }
+}
+
+int shader_t::find_slot(const std::string& name, GLenum type) const {
+   auto found = slots_.find(name);
+   if (found == slots_.end() or uniforms_[found->second].type != type)
+      return -1;
+   return found->second;
+}
+
+int shader_t::handle_slot(const std::string& name, GLenum type) const {
+   const int slot = find_slot(name, type);
+   if (slot < 0 and slots_.count(name))
+      std::cerr << "Uniform " << name << " is declared with another type" << std::endl;
+   return slot;
+}
+
+// one glUniform for count elements from slot, unless all of them have the values
+void shader_t::store(int slot, GLenum type, const void* values, int count) {
+   ++stats_.lookups;
+   if (slot < 0)
+      return;
+
+   const size_t bytes = value_bytes(type);
+   count = std::min(count, uniforms_[slot].array_left);
+   auto data = static_cast<const unsigned char*>(values);
+
+   bool changed = false;
+   for (int e = 0; e < count; ++e)
+   {
+      auto& value = uniforms_[slot + e].value;
+      if (value.size() != bytes or std::memcmp(value.data(), data + e * bytes, bytes) != 0)
+      {
+         value.assign(data + e * bytes, data + (e + 1) * bytes);
+         changed = true;
+      }
+   }
+   if (not changed)
+   {
+      ++stats_.unchanged;
+      return;
+   }
+
+   upload(uniforms_[slot].location, type, values, count);
+   ++stats_.issued;
+}
+
+uniform_stats_t shader_t::take_uniform_stats() {
+   uniform_stats_t stats = stats_;
+   stats_ = uniform_stats_t();
+   return stats;
 }
 
 void shader_t::use() {
-   glUseProgram(program_id_);
+   gl_state.use_program(program_id_);
 }
 
 template<>
 void shader_t::set_uniform<int>(const std::string& name, int val) {
-   glUniform1i(glGetUniformLocation(program_id_, name.c_str()), val);
+   store(name, GL_INT, &val);
 }
 
 template<>
 void shader_t::set_uniform<bool>(const std::string& name, bool val) {
-   glUniform1i(glGetUniformLocation(program_id_, name.c_str()), val);
+   set_uniform(name, int(val));
 }
 
 template<>
 void shader_t::set_uniform<float>(const std::string& name, float val) {
-   glUniform1f(glGetUniformLocation(program_id_, name.c_str()), val);
+   store(name, GL_FLOAT, &val);
 }
 
 template<>
 void shader_t::set_uniform<float>(const std::string& name, float val1, float val2) {
-   glUniform2f(glGetUniformLocation(program_id_, name.c_str()), val1, val2);
+   const float values[] = {val1, val2};
+   store(name, GL_FLOAT_VEC2, values);
 }
 
 template<>
 void shader_t::set_uniform<float>(const std::string& name, float val1, float val2, float val3) {
-   glUniform3f(glGetUniformLocation(program_id_, name.c_str()), val1, val2, val3);
+   const float values[] = {val1, val2, val3};
+   store(name, GL_FLOAT_VEC3, values);
 }
 
 template<>
 void shader_t::set_uniform<float>(const std::string& name, float val1, float val2, float val3, float val4) {
-    glUniform4f(glGetUniformLocation(program_id_, name.c_str()), val1, val2, val3, val4);
+   const float values[] = {val1, val2, val3, val4};
+   store(name, GL_FLOAT_VEC4, values);
 }
 
 template<>
 void shader_t::set_uniform<float*>(const std::string& name, float* val) {
-    glUniformMatrix4fv(glGetUniformLocation(program_id_, name.c_str()), 1, GL_FALSE, val);
+   store(name, GL_FLOAT_MAT4, val);
 }
 
 template <> void shader_t::set_uniformv(const std::string& name, glm::vec3 vec) {
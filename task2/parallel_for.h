@@ -0,0 +1,28 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+inline int default_thread_count() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// call(i) for i in 0 .. n - 1 on up to threads threads, this one included, each
+// taking the next i when it is done with the last
+template <typename Call>
+void parallel_for(int n, int threads, Call call) {
+    std::atomic<int> next {0};
+    auto work = [&]() {
+        for (int i = next++; i < n; i = next++)
+            call(i);
+    };
+
+    std::vector<std::thread> workers;
+    for (int t = 1; t < std::min(threads, n); ++t)
+        workers.emplace_back(work);
+    work();
+    for (auto& worker: workers)
+        worker.join();
+}
@@ -0,0 +1,103 @@
+#include "vertex_dedup.h"
+
+#include <cstdint>
+
+#include "parallel_for.h"
+
+namespace
+{
+    // indices per chunk, large enough that merging the chunks costs little
+    const size_t CHUNK_SIZE = 1 << 13;
+
+    size_t hash_key(const VertexKey& key) {
+        uint64_t h = uint32_t(key.vertex) * 0x9e3779b97f4a7c15ull;
+        h ^= uint32_t(key.normal) * 0xc2b2ae3d27d4eb4full;
+        h ^= uint32_t(key.material) * 0x165667b19e3779f9ull;
+        return size_t(h ^ (h >> 29));
+    }
+
+    struct Chunk {
+        const tinyobj::shape_t* shape;
+        size_t begin, end;
+        DedupedMesh local;
+        std::vector<unsigned int> remap;  // local vertex -> merged vertex
+        size_t offset;                    // of its indices in the merged mesh
+    };
+}
+
+VertexKeyMap::VertexKeyMap(size_t max_keys) {
+    // at most half full
+    size_t capacity = 16;
+    while (capacity < 2 * max_keys)
+        capacity *= 2;
+
+    keys.resize(capacity);
+    ids.assign(capacity, -1);
+    mask = capacity - 1;
+}
+
+int VertexKeyMap::find_or_insert(const VertexKey& key, int id) {
+    for (size_t slot = hash_key(key) & mask; ; slot = (slot + 1) & mask) {
+        if (ids[slot] < 0) {
+            keys[slot] = key;
+            ids[slot] = id;
+            count += 1;
+            return id;
+        }
+        if (keys[slot] == key)
+            return ids[slot];
+    }
+}
+
+DedupedMesh dedup_vertices(const std::vector<tinyobj::shape_t>& shapes, bool with_material, int threads) {
+    std::vector<Chunk> chunks;
+    size_t total = 0;
+    for (const auto& shape: shapes) {
+        const size_t n = shape.mesh.indices.size();
+        for (size_t begin = 0; begin < n; begin += CHUNK_SIZE)
+            chunks.push_back(Chunk {&shape, begin, std::min(n, begin + CHUNK_SIZE), {}, {}, total + begin});
+        total += n;
+    }
+
+    parallel_for(int(chunks.size()), threads, [&](int c) {
+        Chunk& chunk = chunks[c];
+        const tinyobj::mesh_t& mesh = chunk.shape->mesh;
+        VertexKeyMap ids(chunk.end - chunk.begin);
+
+        chunk.local.indices.reserve(chunk.end - chunk.begin);
+        for (size_t v = chunk.begin; v < chunk.end; ++v) {
+            const tinyobj::index_t& idx = mesh.indices[v];
+            VertexKey key {idx.vertex_index, idx.normal_index, with_material ? mesh.material_ids[v / 3] : 0};
+
+            int id = ids.find_or_insert(key, int(chunk.local.vertices.size()));
+            if (id == int(chunk.local.vertices.size()))
+                chunk.local.vertices.push_back(key);
+            chunk.local.indices.push_back(id);
+        }
+    });
+
+    // in chunk order, so that ids are those of a sequential pass
+    size_t local_vertices = 0;
+    for (const auto& chunk: chunks)
+        local_vertices += chunk.local.vertices.size();
+
+    DedupedMesh merged;
+    VertexKeyMap ids(local_vertices);
+    for (auto& chunk: chunks) {
+        chunk.remap.reserve(chunk.local.vertices.size());
+        for (const VertexKey& key: chunk.local.vertices) {
+            int id = ids.find_or_insert(key, int(merged.vertices.size()));
+            if (id == int(merged.vertices.size()))
+                merged.vertices.push_back(key);
+            chunk.remap.push_back(id);
+        }
+    }
+
+    merged.indices.resize(total);
+    parallel_for(int(chunks.size()), threads, [&](int c) {
+        const Chunk& chunk = chunks[c];
+        for (size_t i = 0; i < chunk.local.indices.size(); ++i)
+            merged.indices[chunk.offset + i] = chunk.remap[chunk.local.indices[i]];
+    });
+    return merged;
+}
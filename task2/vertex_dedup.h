@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "parallel_for.h"
+#include "tiny_obj_loader.h"
+
+// One vertex of the interleaved buffer: indices into attrib_t and the material table.
+struct VertexKey {
+    int vertex, normal, material;
+
+    bool operator==(const VertexKey& other) const {
+        return vertex == other.vertex and normal == other.normal and material == other.material;
+    }
+};
+
+// VertexKey -> vertex id with open addressing and linear probing. The table is
+// reserved for max_keys up front, so inserting never rehashes.
+class VertexKeyMap {
+private:
+    std::vector<VertexKey> keys;
+    std::vector<int> ids;  // -1 is an empty slot
+    size_t mask = 0, count = 0;
+
+public:
+    explicit VertexKeyMap(size_t max_keys);
+
+    // id of key, inserting it with id when it is new
+    int find_or_insert(const VertexKey& key, int id);
+
+    size_t size() const {
+        return count;
+    }
+};
+
+struct DedupedMesh {
+    std::vector<VertexKey> vertices;    // unique, in order of first use
+    std::vector<unsigned int> indices;  // into vertices, three per triangle
+};
+
+// Unique (vertex, normal, material) combinations of the triangles of all shapes, with
+// the same ids as one pass over the shapes in order gives. The indices are cut into
+// chunks which are deduplicated on threads, then the chunks are merged in order.
+// Without with_material every material is 0.
+DedupedMesh dedup_vertices(const std::vector<tinyobj::shape_t>& shapes, bool with_material,
+                           int threads = default_thread_count());
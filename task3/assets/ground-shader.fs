@@ -4,22 +4,28 @@ in vec3 coordinates;
 in vec3 normal_;
 out vec4 o_frag_color;
 
-uniform vec4 u_color;
-uniform vec4 u_water_color;
+// FrameBlock and MaterialBlock in uniform_blocks.h
+layout(std140) uniform Frame {
+    mat4 u_lightmat;
+    vec3 u_camera;
+    vec3 u_sun_location;
+};
+
+layout(std140) uniform Material {
+    vec4 u_color;
+    vec4 u_water_color;
+    vec3 u_light;
+    float u_water_level;
+    vec3 u_light_wat;
+};
 //#define u_color vec4(0.0, 0.8, 0.1, 1.0)
 //#define u_water_color vec4(0.1, 0.3, 1.0, 1.0)
 
-uniform float u_water_level;
-uniform vec3 u_sun_location;
 uniform float u_light_ambient;
-uniform vec3 u_light;
-uniform vec3 u_light_wat;
-uniform vec3 u_camera;
 
 uniform vec3 u_lighthouse_flash_dir;
 uniform vec3 u_lighthouse_location;
 
-uniform mat4 u_lightmat;
 uniform sampler2D u_shadowmap;
 uniform sampler2D u_flashtex;
 
@@ -6,10 +6,12 @@ out vec3 normal_;
 out vec3 coordinates;
 
 uniform mat4 u_mvp;
+uniform mat4 u_position_dequant;  // packed positions are 0..1 in the bounding box
 
 void main() {
+    vec3 position = (u_position_dequant * vec4(in_position, 1.0)).xyz;
     normal_ = in_normal;
-    coordinates = in_position;
+    coordinates = position;
 
-    gl_Position = u_mvp * vec4(in_position.x, in_position.y, in_position.z, 1.0);
+    gl_Position = u_mvp * vec4(position, 1.0);
 }
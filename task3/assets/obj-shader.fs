@@ -5,11 +5,21 @@ in vec3 normal_;
 in vec3 vs_color;
 out vec4 o_frag_color;
 
-uniform vec3 u_camera;
-uniform vec3 u_sun_location;
-uniform vec4 u_color;
-uniform vec3 u_light;
-uniform mat4 u_lightmat;
+// FrameBlock and MaterialBlock in uniform_blocks.h
+layout(std140) uniform Frame {
+    mat4 u_lightmat;
+    vec3 u_camera;
+    vec3 u_sun_location;
+};
+
+layout(std140) uniform Material {
+    vec4 u_color;
+    vec4 u_water_color;
+    vec3 u_light;
+    float u_water_level;
+    vec3 u_light_wat;
+};
+
 uniform sampler2D u_shadowmap;
 
 vec3 get_shininess(vec3 normal, vec3 light_direction, vec3 to_camera, bool shadow) {
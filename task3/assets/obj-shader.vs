@@ -8,11 +8,15 @@ out vec3 coordinates;
 out vec3 vs_color;
 
 uniform mat4 u_mvp;
+uniform mat4 u_position_dequant;  // packed positions are 0..1 in the bounding box
+uniform bool u_palette_colors;    // in_color.x is an index with packed vertices
+uniform vec3 u_palette[64];
 
 void main() {
+    vec3 position = (u_position_dequant * vec4(in_position, 1.0)).xyz;
     normal_ = in_normal;
-    coordinates = in_position;
-    vs_color = in_color;
+    coordinates = position;
+    vs_color = u_palette_colors ? u_palette[int(in_color.x)] : in_color;
 
-    gl_Position = u_mvp * vec4(in_position.x, in_position.y, in_position.z, 1.0);
+    gl_Position = u_mvp * vec4(position, 1.0);
 }
@@ -0,0 +1,83 @@
+#include "gl_state.h"
+
+GLState gl_state;
+
+GLState::GLState() {
+    invalidate();
+}
+
+bool GLState::changed(GLuint& bound, GLuint value) {
+    if (bound == value) {
+        ++stats.elided;
+        return false;
+    }
+    bound = value;
+    ++stats.issued;
+    return true;
+}
+
+void GLState::activate(GLenum unit) {
+    if (active_unit == unit) {
+        ++stats.elided;
+        return;
+    }
+    active_unit = unit;
+    ++stats.issued;
+    glActiveTexture(unit);
+}
+
+void GLState::use_program(GLuint program) {
+    if (changed(this->program, program))
+        glUseProgram(program);
+}
+
+void GLState::bind_vertex_array(GLuint vertex_array) {
+    if (changed(this->vertex_array, vertex_array))
+        glBindVertexArray(vertex_array);
+}
+
+void GLState::bind_texture(GLenum unit, GLenum target, GLuint texture) {
+    GLuint& bound = textures[unit - GL_TEXTURE0][target == GL_TEXTURE_CUBE_MAP];
+    if (bound == texture) {
+        ++stats.elided;
+        return;
+    }
+    activate(unit);
+    changed(bound, texture);
+    glBindTexture(target, texture);
+}
+
+void GLState::bind_texture(GLenum unit, GLenum target, GLuint texture, GLuint sampler) {
+    bind_texture(unit, target, texture);
+    if (changed(samplers[unit - GL_TEXTURE0], sampler))
+        glBindSampler(unit - GL_TEXTURE0, sampler);
+}
+
+GLuint GLState::sampler(GLint min_filter, GLint mag_filter, GLint wrap) {
+    GLuint& sampler = sampler_objects[std::make_tuple(min_filter, mag_filter, wrap)];
+    if (sampler == 0) {
+        glGenSamplers(1, &sampler);
+        glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, min_filter);
+        glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, mag_filter);
+        glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, wrap);
+        glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, wrap);
+        glSamplerParameteri(sampler, GL_TEXTURE_WRAP_R, wrap);
+    }
+    return sampler;
+}
+
+void GLState::invalidate() {
+    program = UNKNOWN;
+    vertex_array = UNKNOWN;
+    active_unit = 0;
+    for (int u = 0; u < UNITS; ++u) {
+        textures[u][0] = textures[u][1] = UNKNOWN;
+        samplers[u] = UNKNOWN;
+    }
+}
+
+GLState::Stats GLState::take_stats() {
+    Stats taken = stats;
+    stats = Stats();
+    return taken;
+}
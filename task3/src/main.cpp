@@ -21,9 +21,13 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "stb_image.h"
-#include "tiny_obj_loader.h"
+#include "gl_state.h"
 #include "opengl_shader.h"
 #include "miniconfig.h"
+#include "mesh_bench.h"
+#include "mesh_cache.h"
+#include "uniform_blocks.h"
+#include "vertex_format.h"
 
 #define SZ(obj) int((obj).size())
 
@@ -44,7 +48,7 @@ float seconds() {
 }
 
 GLuint shadowmap_tex; // messy, create a subclass for that later
-glm::mat4 last_light_matrix;  // messy, create a subclass for that later
+GLuint shadowmap_sampler;
 
 class OpenGL {
 private:
@@ -240,7 +244,7 @@ public:
 class Texture {
 private:
     int width, height;
-    GLuint texture;
+    GLuint texture, sampler;
     
 public:
     Texture(const Texture& other) = delete;
@@ -258,10 +262,11 @@ public:
             throw std::runtime_error(std::string("failed to load texture ") + path);
         
         glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
+        gl_state.bind_texture(GL_TEXTURE0, GL_TEXTURE_2D, texture);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
         
         glGenerateMipmap(GL_TEXTURE_2D);
+        sampler = gl_state.sampler(GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE);
         
         stbi_image_free(data);
     }
@@ -271,18 +276,7 @@ public:
     }
 
     void bind(GLuint slot = GL_TEXTURE0) {
-        glActiveTexture(slot);
-        glBindTexture(GL_TEXTURE_2D, texture);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    }
-
-    static void unbind(GLuint slot=GL_TEXTURE0) {
-        glActiveTexture(slot);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        gl_state.bind_texture(slot, GL_TEXTURE_2D, texture, sampler);
     }
 };
 
@@ -305,114 +299,101 @@ public:
 
 class ObjModel: public ModelBase {
 private:
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-
     shader_t shader;
+    bool shader_loaded = false;
+    struct {
+        uniform_t<glm::mat4> mvp, position_dequant;
+        uniform_t<glm::vec3> palette;
+        uniform_t<int> shadowmap, palette_colors;
+    } u;
+    uniform_buffer_t<MaterialBlock> material;
     
     GLuint vbo, vao, ebo;
     int num_triangles = 0;
+    GLenum index_type = GL_UNSIGNED_INT;
+    glm::mat4 position_dequant = glm::mat4(1.0f);
+    std::vector<glm::vec3> palette;  // empty with float colors
 
     glm::vec3 offset = glm::vec3 {0,0,0};
     float scale = 1.0;
 
     Camera& camera;
     
-    void init_opengl_objects() {
-        for (int tp = 0; tp < 3; ++tp) {
-            float mn = 1e9, mx = -1e9;
-
-            for (int i = tp; i < attrib.vertices.size(); i += 3) {
-                mn = std::min(mn, attrib.vertices[i]);
-                mx = std::max(mx, attrib.vertices[i]);
-            }
-
-            float mid = mn + (mx - mn) / 2;
-            for (int i = tp; i < attrib.vertices.size(); i += 3) {
-                attrib.vertices[i] -= mid;
-            }
-        }
-
-        std::vector<float> vertices;
-        std::vector<unsigned int> triangle_indices;
-
-        std::map<std::tuple<int, int, int>, int> idmap;
-        auto get_vertex_id = [&](int vertex, int normal, int material) {
-            auto desc = std::make_tuple(vertex, normal, material);
-            if (not idmap.count(desc)) {
-                int new_id = idmap.size();
-                idmap[desc] = new_id;
-
-                vertices.push_back(attrib.vertices[3 * vertex]);
-                vertices.push_back(attrib.vertices[3 * vertex + 1]);
-                vertices.push_back(attrib.vertices[3 * vertex + 2]);
-
-                vertices.push_back(attrib.normals[3 * normal]);
-                vertices.push_back(attrib.normals[3 * normal + 1]);
-                vertices.push_back(attrib.normals[3 * normal + 2]);
-
-                vertices.push_back(materials[material].diffuse[0]);
-                vertices.push_back(materials[material].diffuse[1]);
-                vertices.push_back(materials[material].diffuse[2]);
-            }
-
-            return idmap[desc];
-        };
-
-        for (int s = 0; s < shapes.size(); ++s) {
-            assert(shapes[s].mesh.indices.size() % 3 == 0);
-
-            for (int v = 0; v < shapes[s].mesh.indices.size(); ++v) {
-                tinyobj::index_t idx = shapes[s].mesh.indices[v];
-                triangle_indices.push_back(get_vertex_id(idx.vertex_index, idx.normal_index, shapes[s].mesh.material_ids[v / 3]));
-            }
-        }
+    void init_opengl_objects(const MeshBuffers& mesh) {
+        num_triangles = mesh.index_count() / 3;
 
-        num_triangles = triangle_indices.size() / 3;
+        PackedMesh packed;
+        const bool use_packed = config.get_float("packed_vertices") != 0
+            and pack_vertices(mesh.vertices(), mesh.vertex_count(), mesh.floats_per_vertex(), packed);
+        const std::vector<uint16_t> short_indices = narrow_indices(mesh.indices(), mesh.index_count(), mesh.vertex_count());
 
         glGenVertexArrays(1, &vao);
         glGenBuffers(1, &vbo);
         glGenBuffers(1, &ebo);
 
-        glBindVertexArray(vao);
+        gl_state.bind_vertex_array(vao);
 
+        const size_t float_bytes = sizeof(float) * mesh.floats_per_vertex() * mesh.vertex_count();
+        const size_t vertex_bytes = use_packed ? sizeof(PackedVertex) * mesh.vertex_count() : float_bytes;
         glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices[0]) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, vertex_bytes, use_packed ? (const void*)packed.vertices.data() : mesh.vertices(), GL_STATIC_DRAW);
 
+        const size_t index_bytes = short_indices.empty() ? sizeof(unsigned int) * mesh.index_count() : sizeof(uint16_t) * mesh.index_count();
+        index_type = short_indices.empty() ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(triangle_indices[0]) * triangle_indices.size(), triangle_indices.data(), GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void *)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void *)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void *)(6 * sizeof(float)));
-        glEnableVertexAttribArray(2);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_bytes, short_indices.empty() ? (const void*)mesh.indices() : short_indices.data(), GL_STATIC_DRAW);
+
+        if (use_packed) {
+            glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void *)offsetof(PackedVertex, position));
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void *)offsetof(PackedVertex, normal));
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(2, 1, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(PackedVertex), (void *)offsetof(PackedVertex, color));
+            glEnableVertexAttribArray(2);
+
+            position_dequant = glm::make_mat4(packed.position_dequant);
+            for (size_t c = 0; c < packed.palette.size(); c += 3)
+                palette.push_back(glm::make_vec3(&packed.palette[c]));
+        } else {
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void *)0);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void *)(3 * sizeof(float)));
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void *)(6 * sizeof(float)));
+            glEnableVertexAttribArray(2);
+        }
 
         glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+        gl_state.bind_vertex_array(0);
+
+        // what every draw fetches at most, against floats and 32 bit indices
+        const size_t unpacked_bytes = float_bytes + sizeof(unsigned int) * mesh.index_count();
+        std::cerr << fmt::format("  {} vertices x {} B + {} indices x {} B = {:.1f} KB, {:.1f} KB unpacked ({:.2f}x less)\n",
+                                 mesh.vertex_count(), vertex_bytes / mesh.vertex_count(), mesh.index_count(),
+                                 index_bytes / mesh.index_count(), (vertex_bytes + index_bytes) / 1024.0,
+                                 unpacked_bytes / 1024.0, double(unpacked_bytes) / (vertex_bytes + index_bytes));
     }
     
 protected:
     virtual void render_mvp(glm::mat4 mvp) {
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, shadowmap_tex);
+        gl_state.bind_texture(GL_TEXTURE1, GL_TEXTURE_2D, shadowmap_tex, shadowmap_sampler);
         
-        shader.use();
-        shader.set_uniform("u_mvp", glm::value_ptr(mvp));
-        shader.set_uniformv("u_color", config.get_vec4("u_color_beacon"));
-        shader.set_uniformv("u_sun_location", glm::normalize(config.get_vec("u_sun_location")));
-        shader.set_uniformv("u_light", config.get_vec("u_light_beacon"));
-        shader.set_uniformv("u_camera", camera.position);
-        shader.set_uniform("u_lightmat", glm::value_ptr(last_light_matrix));
-        shader.set_uniform("u_shadowmap", 1);
+        MaterialBlock block {};
+        block.color = config.get_vec4("u_color_beacon");
+        block.light = config.get_vec("u_light_beacon");
+        material.update(block);
+        material.bind(MATERIAL_BLOCK_BINDING);
 
-        glBindVertexArray(vao);
-        glDrawElements(GL_TRIANGLES, num_triangles * 3, GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+        shader.use();
+        shader.set(u.mvp, mvp);
+        shader.set(u.shadowmap, 1);
+        shader.set(u.position_dequant, position_dequant);
+        shader.set(u.palette_colors, not palette.empty());
+        if (not palette.empty())
+            shader.set(u.palette, palette.data(), SZ(palette));
 
-        glActiveTexture(GL_TEXTURE1);        
-        glBindTexture(GL_TEXTURE_2D, 0);
+        gl_state.bind_vertex_array(vao);
+        glDrawElements(GL_TRIANGLES, num_triangles * 3, index_type, 0);
     }
 
     virtual glm::mat4 model_matrix() {
@@ -421,22 +402,15 @@ protected:
     
 public:
     ObjModel(const char* filename, Camera& camera): camera(camera) {
-        std::string warn;
-        std::string err;
-        bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename);
-
-        if (!err.empty())
-            fprintf(stderr, "loading %s, error: %s\n", filename, err.c_str());
-
-        if (!warn.empty())
-            fprintf(stderr, "loading %s, warn: %s\n", filename, warn.c_str());
-        
-        if (!ret) {
-            fprintf(stderr, "failed to load %s\n", filename);
-            throw std::runtime_error(std::string("failed to load ") + filename);
-        }
-
-        init_opengl_objects();
+        MeshLoadStats stats;
+        MeshBuffers mesh(filename, true, &stats);
+        std::cerr << fmt::format("loading {}: {} in {:.1f} ms\n", filename,
+                                 stats.from_cache ? "mapped cache" : "parsed, cache written", stats.total_seconds * 1000);
+        if (not stats.from_cache)
+            std::cerr << fmt::format("  vertex cache ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}\n", stats.cache_before.acmr,
+                                     stats.cache_after.acmr, stats.cache_before.atvr, stats.cache_after.atvr);
+
+        init_opengl_objects(mesh);
         reload_shader();
     }
 
@@ -453,7 +427,20 @@ public:
     }
 
     void reload_shader() {
-        shader = std::move(shader_t("obj-shader.vs", "obj-shader.fs"));
+        // a broken edit on R keeps the last good program, at startup there is none to keep
+        shader_t reloaded("obj-shader.vs", "obj-shader.fs");
+        if (not bind_uniform_blocks(reloaded, "obj-shader")) {
+            if (not shader_loaded)
+                throw std::runtime_error("obj-shader can't be used");
+            return;
+        }
+        shader = std::move(reloaded);
+        shader_loaded = true;
+        u.mvp = shader.uniform<glm::mat4>("u_mvp");
+        u.position_dequant = shader.uniform<glm::mat4>("u_position_dequant");
+        u.palette = shader.uniform<glm::vec3>("u_palette");
+        u.shadowmap = shader.uniform<int>("u_shadowmap");
+        u.palette_colors = shader.uniform<int>("u_palette_colors");
     }
 };
 
@@ -492,9 +479,18 @@ public:
 class HeightMap: public ModelBase {
 private:
     shader_t shader;
+    bool shader_loaded = false;
+    struct {
+        uniform_t<glm::mat4> mvp, position_dequant;
+        uniform_t<glm::vec3> lighthouse_flash_dir, lighthouse_location;
+        uniform_t<int> flashtex, shadowmap;
+    } u;
+    uniform_buffer_t<MaterialBlock> material;
     
     GLuint vbo, vao, ebo;
     int num_triangles = 0;
+    GLenum index_type = GL_UNSIGNED_INT;
+    glm::mat4 position_dequant = glm::mat4(1.0f);
     std::vector<std::vector<unsigned short>> pixel_data;
 
     const double hscale = config.get_float("ground_horizontal_scale");
@@ -507,36 +503,32 @@ private:
 protected:
     virtual void render_mvp(glm::mat4 mvp) {
         flashtexture.bind();
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, shadowmap_tex);
+        gl_state.bind_texture(GL_TEXTURE1, GL_TEXTURE_2D, shadowmap_tex, shadowmap_sampler);
         
+        MaterialBlock block {};
+        block.color = config.get_vec4("u_color");
+        block.water_color = config.get_vec4("u_water_color");
+        block.light = config.get_vec("u_light");
+        block.water_level = config.get_float("u_water_level");
+        block.light_wat = config.get_vec("u_light_wat");
+        material.update(block);
+        material.bind(MATERIAL_BLOCK_BINDING);
+
         shader.use();
-        shader.set_uniform("u_flashtex", 0);
-        shader.set_uniform("u_mvp", glm::value_ptr(mvp));
-        shader.set_uniformv("u_color", config.get_vec4("u_color"));
-        shader.set_uniformv("u_sun_location", glm::normalize(config.get_vec("u_sun_location")));
-        shader.set_uniformv("u_light", config.get_vec("u_light"));
-        shader.set_uniformv("u_light_wat", config.get_vec("u_light_wat"));
-        shader.set_uniformv("u_camera", camera.position);
-        shader.set_uniform("u_water_level", config.get_float("u_water_level"));
-        shader.set_uniformv("u_water_color", config.get_vec4("u_water_color"));
-        shader.set_uniform("u_lightmat", glm::value_ptr(last_light_matrix));
-        shader.set_uniform("u_shadowmap", 1);
+        shader.set(u.flashtex, 0);
+        shader.set(u.mvp, mvp);
+        shader.set(u.shadowmap, 1);
+        shader.set(u.position_dequant, position_dequant);
         
         glm::vec3 flashdir = config.get_vec("lighthouse_flash_dir");
         
         flashdir = glm::rotateY(flashdir, seconds() * (2.0f * glm::pi<float>()) * config.get_float("lighthouse_flash_speed"));
-        shader.set_uniformv("u_lighthouse_flash_dir", glm::normalize(flashdir));
-        shader.set_uniformv("u_lighthouse_location", lighthouse.get_offset() +
-                            glm::vec3 {0, config.get_float("lighthouse_flash_y_adjust"), 0});
+        shader.set(u.lighthouse_flash_dir, glm::normalize(flashdir));
+        shader.set(u.lighthouse_location, lighthouse.get_offset() +
+                   glm::vec3 {0, config.get_float("lighthouse_flash_y_adjust"), 0});
         
-        glBindVertexArray(vao);
-        glDrawElements(GL_TRIANGLES, num_triangles * 3, GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        flashtexture.unbind();
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        gl_state.bind_vertex_array(vao);
+        glDrawElements(GL_TRIANGLES, num_triangles * 3, index_type, 0);
     }
 
 public:
@@ -589,24 +581,50 @@ public:
             }
 
         num_triangles = SZ(triangle_indices) / 3;
+        const size_t vertex_count = vertices.size() / 6;
+
+        PackedMesh packed;
+        const bool use_packed = config.get_float("packed_vertices") != 0
+            and pack_vertices(vertices.data(), vertex_count, 6, packed);
+        const std::vector<uint16_t> short_indices = narrow_indices(triangle_indices.data(), triangle_indices.size(), vertex_count);
+
         glGenVertexArrays(1, &vao);
         glGenBuffers(1, &vbo);
         glGenBuffers(1, &ebo);
 
-        glBindVertexArray(vao);
+        gl_state.bind_vertex_array(vao);
 
+        const size_t float_bytes = sizeof(vertices[0]) * vertices.size();
+        const size_t vertex_bytes = use_packed ? sizeof(PackedVertex) * vertex_count : float_bytes;
         glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices[0]) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, vertex_bytes, use_packed ? (const void*)packed.vertices.data() : vertices.data(), GL_STATIC_DRAW);
 
+        const size_t index_bytes = short_indices.empty() ? sizeof(triangle_indices[0]) * triangle_indices.size() : sizeof(uint16_t) * triangle_indices.size();
+        index_type = short_indices.empty() ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(triangle_indices[0]) * triangle_indices.size(), triangle_indices.data(), GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_bytes, short_indices.empty() ? (const void*)triangle_indices.data() : short_indices.data(), GL_STATIC_DRAW);
+
+        if (use_packed) {
+            glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void *)offsetof(PackedVertex, position));
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void *)offsetof(PackedVertex, normal));
+            glEnableVertexAttribArray(1);
+            position_dequant = glm::make_mat4(packed.position_dequant);
+        } else {
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
+            glEnableVertexAttribArray(1);
+        }
 
         glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+        gl_state.bind_vertex_array(0);
+
+        const size_t unpacked_bytes = float_bytes + sizeof(triangle_indices[0]) * triangle_indices.size();
+        std::cerr << fmt::format("loading {}: {} vertices x {} B + {} indices x {} B = {:.1f} MB, {:.1f} MB unpacked ({:.2f}x less)\n",
+                                 path, vertex_count, vertex_bytes / vertex_count, triangle_indices.size(),
+                                 index_bytes / triangle_indices.size(), (vertex_bytes + index_bytes) / 1048576.0,
+                                 unpacked_bytes / 1048576.0, double(unpacked_bytes) / (vertex_bytes + index_bytes));
 
         reload_shader();
     }
@@ -630,11 +648,28 @@ public:
     }
 
     void reload_shader() {
-        shader = std::move(shader_t("ground-shader.vs", "ground-shader.fs"));
+        // a broken edit on R keeps the last good program, at startup there is none to keep
+        shader_t reloaded("ground-shader.vs", "ground-shader.fs");
+        if (not bind_uniform_blocks(reloaded, "ground-shader")) {
+            if (not shader_loaded)
+                throw std::runtime_error("ground-shader can't be used");
+            return;
+        }
+        shader = std::move(reloaded);
+        shader_loaded = true;
+        u.mvp = shader.uniform<glm::mat4>("u_mvp");
+        u.position_dequant = shader.uniform<glm::mat4>("u_position_dequant");
+        u.lighthouse_flash_dir = shader.uniform<glm::vec3>("u_lighthouse_flash_dir");
+        u.lighthouse_location = shader.uniform<glm::vec3>("u_lighthouse_location");
+        u.flashtex = shader.uniform<int>("u_flashtex");
+        u.shadowmap = shader.uniform<int>("u_shadowmap");
     }
 };
 
-int main(int, char **) {
+int main(int argc, char **argv) {
+    if (argc > 1)
+        return run_mesh_bench(argc, argv);
+
     OpenGL opengl("Task3");
     Camera camera;
     ObjModel beacon("lighthouse/lighthouse.obj", camera);
@@ -711,13 +746,10 @@ int main(int, char **) {
     GLuint shadowmap_fbo;
     glGenFramebuffers(1, &shadowmap_fbo);
     glGenTextures(1, &shadowmap_tex);
-    glBindTexture(GL_TEXTURE_2D, shadowmap_tex);
+    gl_state.bind_texture(GL_TEXTURE0, GL_TEXTURE_2D, shadowmap_tex);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, 
                  shadowmap_size, shadowmap_size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT); 
+    shadowmap_sampler = gl_state.sampler(GL_NEAREST, GL_NEAREST, GL_REPEAT);
     
     glBindFramebuffer(GL_FRAMEBUFFER, shadowmap_fbo);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, shadowmap_tex, 0);
@@ -725,8 +757,15 @@ int main(int, char **) {
     glReadBuffer(GL_NONE);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     
+    // the material buffers are bound per draw, this one stays
+    uniform_buffer_t<FrameBlock> frame_uniforms;
+    frame_uniforms.bind(FRAME_BLOCK_BINDING);
+
     opengl.main_loop([&]() {
         process_drag();
+        // of the last frame, both passes
+        const uniform_stats_t uniform_stats = shader_t::take_uniform_stats();
+        const GLState::Stats bind_stats = gl_state.take_stats();
 
         glm::vec3 forward = camera.get_forward();
         glm::vec3 up = camera.get_up();
@@ -761,7 +800,13 @@ int main(int, char **) {
                                           config.get_float("shadowmap_near"),
                                           config.get_float("shadowmap_far"));
 
-        render(last_light_matrix = lightprojection * lightview);
+        FrameBlock frame {};
+        frame.lightmat = lightprojection * lightview;
+        frame.camera = camera.position;
+        frame.sun_location = glm::normalize(config.get_vec("u_sun_location"));
+        frame_uniforms.update(frame);
+
+        render(frame.lightmat);
         
         if (shadowmap_debug)
             return;
@@ -786,6 +831,9 @@ int main(int, char **) {
         ImGui::Text("forward");
         ImGui::Text("x=%0.2f, y=%0.2f, z=%0.2f", forward.x, forward.y, forward.z);
         ImGui::SliderFloat("speed", &speed, 1, 1000, "%0.2f", 2.0f);
+        ImGui::Text("uniforms: %zu glUniform, %zu unchanged left out, %zu location lookups saved",
+                    uniform_stats.issued, uniform_stats.unchanged, uniform_stats.lookups);
+        ImGui::Text("binds: %zu issued, %zu already bound left out", bind_stats.issued, bind_stats.elided);
         ImGui::Text("");
         ImGui::Text("Controls: WASD (forward, left, right, backward)");
         ImGui::Text("Controls: QZ (up, down)");
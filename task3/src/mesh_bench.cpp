@@ -0,0 +1,323 @@
+#include "mesh_bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "mesh_cache.h"
+#include "mesh_optimize.h"
+#include "obj_parser.h"
+#include "tiny_obj_loader.h"
+#include "vertex_dedup.h"
+
+namespace
+{
+    // the obj files of this task, paths relative to assets
+    const std::vector<std::string> BUNDLED_OBJS = {"boat/Boat.obj", "lighthouse/lighthouse.obj",
+                                                   "beacon_obj/Beacon.obj", "ORIGAMI_Chat_Free.obj"};
+    const int REPEATS = 5;
+
+    void usage() {
+        std::cerr << "usage:\n"
+                  << "  task3                                interactive scene\n"
+                  << "  task3 --bench-dedup [<file.obj> ...]  vertex deduplication of the obj files, the bundled ones by default\n"
+                  << "  task3 --bench-cache [<file.obj> ...]  cold (parse, write the cache) against warm (map the cache) loads\n"
+                  << "  task3 --bench-parse [<file.obj> ...]  tinyobj::LoadObj against load_obj_parallel\n"
+                  << "  task3 --bench-optimize [<file.obj> ...]  vertex cache ACMR/ATVR of the file order and the optimized ones\n";
+    }
+
+    void load_obj(const std::string& path, tinyobj::attrib_t& attrib, std::vector<tinyobj::shape_t>& shapes,
+                  std::vector<tinyobj::material_t>& materials) {
+        std::string warn, err;
+        if (not tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str()))
+            throw std::runtime_error("failed to load " + path + ": " + err);
+    }
+
+    // what ObjModel did before dedup_vertices
+    DedupedMesh dedup_vertices_map(const std::vector<tinyobj::shape_t>& shapes) {
+        DedupedMesh mesh;
+        std::map<std::tuple<int, int, int>, int> idmap;
+
+        for (const auto& shape: shapes)
+            for (size_t v = 0; v < shape.mesh.indices.size(); ++v) {
+                tinyobj::index_t idx = shape.mesh.indices[v];
+                auto desc = std::make_tuple(idx.vertex_index, idx.normal_index, shape.mesh.material_ids[v / 3]);
+                if (not idmap.count(desc)) {
+                    int new_id = idmap.size();
+                    idmap[desc] = new_id;
+                    mesh.vertices.push_back(VertexKey {idx.vertex_index, idx.normal_index, shape.mesh.material_ids[v / 3]});
+                }
+                mesh.indices.push_back(idmap[desc]);
+            }
+        return mesh;
+    }
+
+    bool same_mesh(const DedupedMesh& a, const DedupedMesh& b) {
+        return a.indices == b.indices and a.vertices.size() == b.vertices.size()
+            and std::equal(a.vertices.begin(), a.vertices.end(), b.vertices.begin());
+    }
+
+    // best of REPEATS, in seconds
+    template <typename Call>
+    double best_time(Call call) {
+        double best = 1e30;
+        for (int r = 0; r < REPEATS; ++r) {
+            auto start = std::chrono::steady_clock::now();
+            call();
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    }
+
+    int bench_dedup(const std::vector<std::string>& files) {
+        const int threads = default_thread_count();
+
+        for (const auto& path: files) {
+            tinyobj::attrib_t attrib;
+            std::vector<tinyobj::shape_t> shapes;
+            std::vector<tinyobj::material_t> materials;
+            load_obj(path, attrib, shapes, materials);
+
+            size_t indices = 0;
+            for (const auto& shape: shapes)
+                indices += shape.mesh.indices.size();
+
+            DedupedMesh reference = dedup_vertices_map(shapes);
+            std::cout << fmt::format("{}: {} shapes, {} indices, {} unique vertices\n", path, shapes.size(), indices,
+                                     reference.vertices.size());
+
+            auto report = [&](const std::string& name, double seconds, double baseline) {
+                std::cout << fmt::format("  {:<22} {:8.2f} ms  {:7.1f} M indices/s  {:5.2f}x\n", name, seconds * 1000,
+                                         indices / seconds / 1e6, baseline / seconds);
+            };
+
+            double map_seconds = best_time([&]() { dedup_vertices_map(shapes); });
+            report("std::map", map_seconds, map_seconds);
+
+            for (int t: {1, threads}) {
+                DedupedMesh mesh;
+                double seconds = best_time([&]() { mesh = dedup_vertices(shapes, true, t); });
+                if (not same_mesh(mesh, reference))
+                    throw std::runtime_error("dedup_vertices differs from the std::map version on " + path);
+                report(fmt::format("hash, {} thread{}", t, t > 1 ? "s" : ""), seconds, map_seconds);
+                if (threads == 1)
+                    break;
+            }
+        }
+        return 0;
+    }
+
+    bool same_index(const tinyobj::index_t& a, const tinyobj::index_t& b) {
+        return a.vertex_index == b.vertex_index and a.normal_index == b.normal_index
+            and a.texcoord_index == b.texcoord_index;
+    }
+
+    // everything ObjModel and the cache use, compared exactly
+    bool same_obj(const tinyobj::attrib_t& a, const std::vector<tinyobj::shape_t>& a_shapes,
+                  const std::vector<tinyobj::material_t>& a_materials, const tinyobj::attrib_t& b,
+                  const std::vector<tinyobj::shape_t>& b_shapes, const std::vector<tinyobj::material_t>& b_materials) {
+        if (a.vertices != b.vertices or a.normals != b.normals or a.texcoords != b.texcoords or a.colors != b.colors
+            or a_shapes.size() != b_shapes.size() or a_materials.size() != b_materials.size())
+            return false;
+
+        for (size_t s = 0; s < a_shapes.size(); ++s) {
+            const tinyobj::mesh_t& m = a_shapes[s].mesh;
+            const tinyobj::mesh_t& n = b_shapes[s].mesh;
+            if (a_shapes[s].name != b_shapes[s].name or m.num_face_vertices != n.num_face_vertices
+                or m.material_ids != n.material_ids or m.smoothing_group_ids != n.smoothing_group_ids
+                or m.indices.size() != n.indices.size()
+                or not std::equal(m.indices.begin(), m.indices.end(), n.indices.begin(), same_index))
+                return false;
+        }
+
+        for (size_t m = 0; m < a_materials.size(); ++m)
+            if (a_materials[m].name != b_materials[m].name
+                or not std::equal(a_materials[m].diffuse, a_materials[m].diffuse + 3, b_materials[m].diffuse))
+                return false;
+        return true;
+    }
+
+    int bench_parse(const std::vector<std::string>& files) {
+        const int threads = default_thread_count();
+
+        for (const auto& path: files) {
+            tinyobj::attrib_t attrib;
+            std::vector<tinyobj::shape_t> shapes;
+            std::vector<tinyobj::material_t> materials;
+            std::string warn, err;
+
+            double tinyobj_seconds = best_time([&]() {
+                materials.clear();
+                if (not tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str()))
+                    throw std::runtime_error("failed to load " + path + ": " + err);
+            });
+
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            const double megabytes = double(file.tellg()) / (1 << 20);
+            std::cout << fmt::format("{}: {:.1f} MB, {} vertices, {} shapes\n", path, megabytes,
+                                     attrib.vertices.size() / 3, shapes.size());
+
+            auto report = [&](const std::string& name, double seconds) {
+                std::cout << fmt::format("  {:<22} {:8.2f} ms  {:7.1f} MB/s  {:5.2f}x\n", name, seconds * 1000,
+                                         megabytes / seconds, tinyobj_seconds / seconds);
+            };
+            report("tinyobj", tinyobj_seconds);
+
+            for (int t: {1, threads}) {
+                tinyobj::attrib_t parallel_attrib;
+                std::vector<tinyobj::shape_t> parallel_shapes;
+                std::vector<tinyobj::material_t> parallel_materials;
+
+                double seconds = best_time([&]() {
+                    parallel_materials.clear();
+                    if (not load_obj_parallel(&parallel_attrib, &parallel_shapes, &parallel_materials, &warn, &err,
+                                              path.c_str(), t))
+                        throw std::runtime_error("failed to load " + path + ": " + err);
+                });
+                if (not same_obj(attrib, shapes, materials, parallel_attrib, parallel_shapes, parallel_materials))
+                    throw std::runtime_error("load_obj_parallel differs from tinyobj on " + path);
+                report(fmt::format("parallel, {} thread{}", t, t > 1 ? "s" : ""), seconds);
+                if (threads == 1)
+                    break;
+            }
+        }
+        return 0;
+    }
+
+    // the triangles as original vertex ids, sorted, to check that reordering kept them all
+    std::vector<std::tuple<unsigned, unsigned, unsigned>> triangle_set(const std::vector<unsigned int>& indices,
+                                                                       const std::vector<unsigned int>& original) {
+        std::vector<std::tuple<unsigned, unsigned, unsigned>> triangles;
+        for (size_t i = 0; i < indices.size(); i += 3)
+            triangles.emplace_back(original[indices[i]], original[indices[i + 1]], original[indices[i + 2]]);
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+
+    int bench_optimize(const std::vector<std::string>& files) {
+        for (const auto& path: files) {
+            tinyobj::attrib_t attrib;
+            std::vector<tinyobj::shape_t> shapes;
+            std::vector<tinyobj::material_t> materials;
+            load_obj(path, attrib, shapes, materials);
+
+            DedupedMesh mesh = dedup_vertices(shapes, true);
+            const size_t vertex_count = mesh.vertices.size();
+            std::vector<float> positions;
+            for (const VertexKey& key: mesh.vertices)
+                positions.insert(positions.end(), attrib.vertices.begin() + 3 * key.vertex,
+                                 attrib.vertices.begin() + 3 * key.vertex + 3);
+
+            std::vector<unsigned int> identity(vertex_count);
+            for (size_t v = 0; v < vertex_count; ++v)
+                identity[v] = unsigned(v);
+            const auto reference = triangle_set(mesh.indices, identity);
+
+            std::cout << fmt::format("{}: {} triangles, {} vertices, cache of {}\n", path, mesh.indices.size() / 3,
+                                     vertex_count, VERTEX_CACHE_SIZE);
+            auto report = [&](const std::string& name, const std::vector<unsigned int>& indices, double seconds) {
+                VertexCacheStats stats = analyze_vertex_cache(indices, vertex_count);
+                std::cout << fmt::format("  {:<24} ACMR {:.3f}  ATVR {:.3f}  {:8.2f} ms\n", name, stats.acmr, stats.atvr,
+                                         seconds * 1000);
+            };
+            report("file order", mesh.indices, 0);
+
+            std::vector<unsigned int> indices;
+            std::vector<size_t> clusters;
+            double seconds = best_time([&]() {
+                indices = mesh.indices;
+                clusters = optimize_vertex_cache(indices, vertex_count);
+            });
+            report("vertex cache", indices, seconds);
+
+            std::vector<unsigned int> cached = indices;
+            bool kept = true;
+            seconds = best_time([&]() {
+                indices = cached;
+                kept = not optimize_overdraw(indices, clusters, positions);
+            });
+            report(fmt::format("overdraw, {} clusters{}", clusters.size(), kept ? ", kept" : ""), indices, seconds);
+
+            std::vector<unsigned int> sorted = indices, order;
+            seconds = best_time([&]() {
+                indices = sorted;
+                order = optimize_vertex_fetch(indices, vertex_count);
+            });
+            report("vertex fetch", indices, seconds);
+
+            if (triangle_set(indices, order) != reference)
+                throw std::runtime_error("reordering lost triangles of " + path);
+        }
+        return 0;
+    }
+
+    int bench_cache(const std::vector<std::string>& files) {
+        for (const auto& path: files) {
+            std::remove(mesh_cache_path(path).c_str());
+
+            MeshLoadStats cold;
+            MeshBuffers built(path, true, &cold);
+            if (cold.from_cache)
+                throw std::runtime_error("the cache of " + path + " was not removed");
+
+            MeshLoadStats warm;
+            warm.total_seconds = 1e30;
+            for (int r = 0; r < REPEATS; ++r) {
+                MeshLoadStats stats;
+                MeshBuffers mapped(path, true, &stats);
+                if (not stats.from_cache)
+                    throw std::runtime_error("no cache for " + path);
+                if (mapped.vertex_count() != built.vertex_count() or mapped.index_count() != built.index_count()
+                    or std::memcmp(mapped.vertices(), built.vertices(),
+                                   sizeof(float) * built.floats_per_vertex() * built.vertex_count()) != 0
+                    or std::memcmp(mapped.indices(), built.indices(), sizeof(unsigned int) * built.index_count()) != 0)
+                    throw std::runtime_error("the cache of " + path + " differs from the obj");
+                if (stats.total_seconds < warm.total_seconds)
+                    warm = stats;
+            }
+
+            std::cout << fmt::format("{}: {} vertices, {} indices\n", path, built.vertex_count(), built.index_count());
+            std::cout << fmt::format("  cold {:8.2f} ms  (hash {:.2f}, parse {:.2f}, build {:.2f}, write {:.2f})\n",
+                                     cold.total_seconds * 1000, cold.hash_seconds * 1000, cold.parse_seconds * 1000,
+                                     cold.build_seconds * 1000, cold.io_seconds * 1000);
+            std::cout << fmt::format("  warm {:8.2f} ms  (hash {:.2f}, map {:.2f})  {:.1f}x\n",
+                                     warm.total_seconds * 1000, warm.hash_seconds * 1000, warm.io_seconds * 1000,
+                                     cold.total_seconds / warm.total_seconds);
+        }
+        return 0;
+    }
+}
+
+int run_mesh_bench(int argc, char **argv) {
+    std::string mode = argv[1];
+    std::vector<std::string> files(argv + 2, argv + argc);
+    if (files.empty())
+        files = BUNDLED_OBJS;
+
+    try {
+        if (mode == "--bench-dedup")
+            return bench_dedup(files);
+        if (mode == "--bench-cache")
+            return bench_cache(files);
+        if (mode == "--bench-parse")
+            return bench_parse(files);
+        if (mode == "--bench-optimize")
+            return bench_optimize(files);
+    } catch (std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+
+    usage();
+    return 1;
+}
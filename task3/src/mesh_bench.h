@@ -0,0 +1,5 @@
+#pragma once
+
+// Command line benchmarks of mesh loading, they don't need a window or an OpenGL
+// context. Returns the process exit code.
+int run_mesh_bench(int argc, char **argv);
@@ -0,0 +1,279 @@
+#include "mesh_optimize.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // A FIFO cache over vertex ids: a vertex is in it while fewer than cache_size
+    // others were added since it was. reset() empties it without touching every vertex.
+    class FifoCache {
+    private:
+        std::vector<size_t> added;  // misses counted with the vertex coming in, 0 is never
+        size_t misses = 0, start = 0;
+        size_t size;
+
+    public:
+        FifoCache(size_t vertex_count, int cache_size): added(vertex_count, 0), size(cache_size) {}
+
+        // true for a miss
+        bool use(unsigned int v) {
+            if (added[v] > start and misses - added[v] < size)
+                return false;
+            misses += 1;
+            added[v] = misses;
+            return true;
+        }
+
+        void reset() {
+            start = misses;
+        }
+    };
+
+    struct Adjacency {
+        std::vector<size_t> offsets;    // of the triangles of every vertex
+        std::vector<unsigned int> triangles;
+    };
+
+    Adjacency build_adjacency(const std::vector<unsigned int>& indices, size_t vertex_count) {
+        Adjacency adjacency;
+        adjacency.offsets.assign(vertex_count + 1, 0);
+        for (unsigned int v: indices)
+            adjacency.offsets[v + 1] += 1;
+        for (size_t v = 0; v < vertex_count; ++v)
+            adjacency.offsets[v + 1] += adjacency.offsets[v];
+
+        adjacency.triangles.resize(indices.size());
+        std::vector<size_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); ++i)
+            adjacency.triangles[fill[indices[i]]++] = unsigned(i / 3);
+        return adjacency;
+    }
+
+    // Where to cut the triangles into clusters, see optimize_vertex_cache. A cluster costs
+    // the misses of its triangles from an empty cache. A cut is made once the clusters so
+    // far cost at most threshold times their triangles in one piece, less a cache of
+    // misses kept for the cluster after it. Should the last one still go over, the cuts
+    // are taken back from the end.
+    std::vector<size_t> cluster_boundaries(const std::vector<unsigned int>& indices, size_t vertex_count,
+                                           int cache_size, float threshold) {
+        FifoCache whole(vertex_count, cache_size), cluster(vertex_count, cache_size);
+        std::vector<size_t> clusters = {0};
+        std::vector<size_t> costs = {0};  // of the clusters before every cut
+        size_t whole_misses = 0, cost = 0, misses = 0;
+
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            for (int k = 0; k < 3; ++k) {
+                whole_misses += whole.use(indices[i + k]);
+                misses += cluster.use(indices[i + k]);
+            }
+
+            if (i + 3 < indices.size() and cost + misses + cache_size <= threshold * whole_misses) {
+                cost += misses;
+                misses = 0;
+                cluster.reset();
+                clusters.push_back(i + 3);
+                costs.push_back(cost);
+            }
+        }
+
+        while (clusters.size() > 1 and cost + misses > threshold * whole_misses) {
+            clusters.pop_back();
+            costs.pop_back();
+            cost = costs.back();
+            misses = 0;
+            cluster.reset();
+            for (size_t i = clusters.back(); i < indices.size(); ++i)
+                misses += cluster.use(indices[i]);
+        }
+        return clusters;
+    }
+}
+
+VertexCacheStats analyze_vertex_cache(const std::vector<unsigned int>& indices, size_t vertex_count, int cache_size) {
+    FifoCache cache(vertex_count, cache_size);
+    std::vector<bool> used(vertex_count, false);
+    size_t misses = 0, used_count = 0;
+    for (unsigned int v: indices) {
+        misses += cache.use(v);
+        if (not used[v]) {
+            used[v] = true;
+            used_count += 1;
+        }
+    }
+
+    VertexCacheStats stats;
+    if (not indices.empty()) {
+        stats.acmr = double(misses) / (indices.size() / 3);
+        stats.atvr = double(misses) / used_count;
+    }
+    return stats;
+}
+
+std::vector<size_t> optimize_vertex_cache(std::vector<unsigned int>& indices, size_t vertex_count, int cache_size,
+                                          float threshold) {
+    const size_t triangle_count = indices.size() / 3;
+    const Adjacency adjacency = build_adjacency(indices, vertex_count);
+
+    std::vector<int> live(vertex_count);  // triangles of the vertex not yet emitted
+    for (size_t v = 0; v < vertex_count; ++v)
+        live[v] = int(adjacency.offsets[v + 1] - adjacency.offsets[v]);
+
+    std::vector<size_t> timestamp(vertex_count, 0);
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<unsigned int> dead_end;  // recently used vertices, to go back to
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+
+    size_t time = cache_size + 1;
+    size_t cursor = 0;  // where the scan for any vertex with live triangles is
+    long fanning = vertex_count ? 0 : -1;
+
+    while (fanning >= 0) {
+        candidates.clear();
+        for (size_t a = adjacency.offsets[fanning]; a < adjacency.offsets[fanning + 1]; ++a) {
+            unsigned int t = adjacency.triangles[a];
+            if (emitted[t])
+                continue;
+            emitted[t] = true;
+
+            for (int k = 0; k < 3; ++k) {
+                unsigned int v = indices[3 * t + k];
+                result.push_back(v);
+                dead_end.push_back(v);
+                candidates.push_back(v);
+                live[v] -= 1;
+                if (time - timestamp[v] > size_t(cache_size))
+                    timestamp[v] = time++;
+            }
+        }
+
+        // the candidate that will still be in the cache after its triangles were emitted,
+        // the one that came in first, or one with live triangles at all
+        long next = -1;
+        long best = -1;
+        for (unsigned int v: candidates) {
+            if (live[v] <= 0)
+                continue;
+            long priority = 0;
+            if (long(time - timestamp[v]) + 2 * live[v] <= cache_size)
+                priority = long(time - timestamp[v]);
+            if (priority > best) {
+                best = priority;
+                next = v;
+            }
+        }
+
+        if (next < 0) {
+            while (not dead_end.empty() and next < 0) {
+                unsigned int v = dead_end.back();
+                dead_end.pop_back();
+                if (live[v] > 0)
+                    next = v;
+            }
+            while (next < 0 and cursor < vertex_count) {
+                if (live[cursor] > 0)
+                    next = long(cursor);
+                cursor += 1;
+            }
+        }
+        fanning = next;
+    }
+
+    indices.swap(result);
+    return cluster_boundaries(indices, vertex_count, cache_size, threshold);
+}
+
+bool optimize_overdraw(std::vector<unsigned int>& indices, const std::vector<size_t>& clusters,
+                       const std::vector<float>& positions, int cache_size, float threshold) {
+    struct Cluster {
+        size_t begin, end;
+        float area;
+        float centroid[3], normal[3];
+        float sort_key;
+    };
+
+    auto position = [&](unsigned int v, int axis) {
+        return positions[3 * v + axis];
+    };
+
+    // area weighted centroids and normals of the clusters, and of the mesh
+    std::vector<Cluster> list;
+    float mesh_centroid[3] = {0, 0, 0};
+    float mesh_area = 0;
+    for (size_t c = 0; c < clusters.size(); ++c) {
+        Cluster cluster {clusters[c], c + 1 < clusters.size() ? clusters[c + 1] : indices.size(), 0, {0, 0, 0}, {0, 0, 0}, 0};
+
+        for (size_t i = cluster.begin; i < cluster.end; i += 3) {
+            float e0[3], e1[3];
+            for (int a = 0; a < 3; ++a) {
+                e0[a] = position(indices[i + 1], a) - position(indices[i], a);
+                e1[a] = position(indices[i + 2], a) - position(indices[i], a);
+            }
+            float n[3] = {e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0]};
+            float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+            for (int a = 0; a < 3; ++a) {
+                float center = (position(indices[i], a) + position(indices[i + 1], a) + position(indices[i + 2], a)) / 3;
+                cluster.centroid[a] += center * area;
+                cluster.normal[a] += n[a];
+            }
+            cluster.area += area;
+        }
+
+        for (int a = 0; a < 3; ++a)
+            mesh_centroid[a] += cluster.centroid[a];
+        mesh_area += cluster.area;
+
+        if (cluster.area > 0)
+            for (int a = 0; a < 3; ++a)
+                cluster.centroid[a] /= cluster.area;
+        list.push_back(cluster);
+    }
+    if (mesh_area > 0)
+        for (int a = 0; a < 3; ++a)
+            mesh_centroid[a] /= mesh_area;
+
+    // how far out of the mesh the cluster faces
+    for (Cluster& cluster: list) {
+        float length = std::sqrt(cluster.normal[0] * cluster.normal[0] + cluster.normal[1] * cluster.normal[1]
+                                 + cluster.normal[2] * cluster.normal[2]);
+        cluster.sort_key = 0;
+        if (length > 0)
+            for (int a = 0; a < 3; ++a)
+                cluster.sort_key += (cluster.centroid[a] - mesh_centroid[a]) * cluster.normal[a] / length;
+    }
+
+    std::stable_sort(list.begin(), list.end(), [](const Cluster& a, const Cluster& b) {
+        return a.sort_key > b.sort_key;
+    });
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (const Cluster& cluster: list)
+        result.insert(result.end(), indices.begin() + cluster.begin, indices.begin() + cluster.end);
+
+    // the clusters are costed from an empty cache, after another one it may do worse
+    const size_t vertex_count = positions.size() / 3;
+    if (analyze_vertex_cache(result, vertex_count, cache_size).acmr >
+        threshold * analyze_vertex_cache(indices, vertex_count, cache_size).acmr)
+        return false;
+    indices.swap(result);
+    return true;
+}
+
+std::vector<unsigned int> optimize_vertex_fetch(std::vector<unsigned int>& indices, size_t vertex_count) {
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> remap(vertex_count, unused);
+    std::vector<unsigned int> order;
+
+    for (unsigned int& v: indices) {
+        if (remap[v] == unused) {
+            remap[v] = unsigned(order.size());
+            order.push_back(v);
+        }
+        v = remap[v];
+    }
+    return order;
+}
@@ -0,0 +1,881 @@
+#include "obj_parser.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    typedef tinyobj::real_t real_t;
+
+    // smallest chunk worth a thread
+    const size_t MIN_CHUNK_BYTES = 64 << 10;
+    // faces per triangulation job
+    const uint32_t TRIANGULATE_FACES = 4096;
+
+    // the file, mapped or read
+    class FileBytes {
+    private:
+        const char* bytes = nullptr;
+        size_t length = 0;
+        bool mapped = false;
+        std::string content;
+
+    public:
+        explicit FileBytes(const char* filename) {
+#ifndef _WIN32
+            int fd = open(filename, O_RDONLY);
+            if (fd < 0)
+                return;
+
+            struct stat st;
+            if (fstat(fd, &st) == 0) {
+                if (st.st_size == 0) {
+                    bytes = "";
+                } else {
+                    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (data != MAP_FAILED) {
+                        bytes = static_cast<const char*>(data);
+                        length = st.st_size;
+                        mapped = true;
+                    }
+                }
+            }
+            close(fd);
+#else
+            std::ifstream file(filename, std::ios::binary);
+            if (not file)
+                return;
+
+            std::ostringstream buffer;
+            buffer << file.rdbuf();
+            content = buffer.str();
+            bytes = content.data();
+            length = content.size();
+#endif
+        }
+
+        ~FileBytes() {
+#ifndef _WIN32
+            if (mapped)
+                munmap(const_cast<char*>(bytes), length);
+#endif
+        }
+
+        FileBytes(const FileBytes& other) = delete;
+        FileBytes& operator=(const FileBytes& other) = delete;
+
+        bool ok() const {
+            return bytes != nullptr;
+        }
+
+        const char* data() const {
+            return bytes;
+        }
+
+        size_t size() const {
+            return length;
+        }
+    };
+
+    // 10^-n as tinyobj computes it
+    struct NegativePowers {
+        double values[64];
+
+        NegativePowers() {
+            static const double pow_lut[] = {1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001};
+            for (int n = 0; n < 64; ++n)
+                values[n] = n < 8 ? pow_lut[n] : std::pow(10.0, -n);
+        }
+    };
+    const NegativePowers negative_powers;
+
+    bool is_digit(char c) {
+        return c >= '0' and c <= '9';
+    }
+
+    bool is_space(char c) {
+        return c == ' ' or c == '\t';
+    }
+
+    // The parsing helpers stay before end, a chunk's last line has no terminator.
+    // They otherwise do what the tinyobj ones of the same name do.
+
+    void skip_space(const char*& p, const char* end) {
+        while (p < end and is_space(*p))
+            ++p;
+    }
+
+    // strcspn(p, " \t\r")
+    const char* token_end(const char* p, const char* end) {
+        while (p < end and *p != ' ' and *p != '\t' and *p != '\r')
+            ++p;
+        return p;
+    }
+
+    bool try_parse_double(const char* s, const char* s_end, double* result) {
+        if (s >= s_end)
+            return false;
+
+        double mantissa = 0.0;
+        int exponent = 0;
+        char sign = '+', exp_sign = '+';
+        const char* curr = s;
+        int read = 0;
+        bool end_not_reached = false;
+        bool leading_decimal_dots = false;
+
+        if (*curr == '+' or *curr == '-') {
+            sign = *curr;
+            curr++;
+            if (curr != s_end and *curr == '.')
+                leading_decimal_dots = true;
+        } else if (is_digit(*curr)) {
+        } else if (*curr == '.') {
+            leading_decimal_dots = true;
+        } else {
+            return false;
+        }
+
+        end_not_reached = curr != s_end;
+        if (not leading_decimal_dots) {
+            while (end_not_reached and is_digit(*curr)) {
+                mantissa *= 10;
+                mantissa += static_cast<int>(*curr - 0x30);
+                curr++;
+                read++;
+                end_not_reached = curr != s_end;
+            }
+            if (read == 0)
+                return false;
+        }
+
+        if (not end_not_reached)
+            goto assemble;
+
+        if (*curr == '.') {
+            curr++;
+            read = 1;
+            end_not_reached = curr != s_end;
+            while (end_not_reached and is_digit(*curr)) {
+                mantissa += static_cast<int>(*curr - 0x30)
+                    * (read < 64 ? negative_powers.values[read] : std::pow(10.0, -read));
+                read++;
+                curr++;
+                end_not_reached = curr != s_end;
+            }
+        } else if (*curr == 'e' or *curr == 'E') {
+        } else {
+            goto assemble;
+        }
+
+        if (not end_not_reached)
+            goto assemble;
+
+        if (*curr == 'e' or *curr == 'E') {
+            curr++;
+            end_not_reached = curr != s_end;
+            if (end_not_reached and (*curr == '+' or *curr == '-')) {
+                exp_sign = *curr;
+                curr++;
+            } else if (end_not_reached and is_digit(*curr)) {
+            } else {
+                return false;
+            }
+
+            read = 0;
+            end_not_reached = curr != s_end;
+            while (end_not_reached and is_digit(*curr)) {
+                exponent *= 10;
+                exponent += static_cast<int>(*curr - 0x30);
+                curr++;
+                read++;
+                end_not_reached = curr != s_end;
+            }
+            exponent *= exp_sign == '+' ? 1 : -1;
+            if (read == 0)
+                return false;
+        }
+
+    assemble:
+        *result = (sign == '+' ? 1 : -1)
+            * (exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
+        return true;
+    }
+
+    real_t parse_real(const char*& p, const char* end, double default_value = 0.0) {
+        skip_space(p, end);
+        const char* e = token_end(p, end);
+        double value = default_value;
+        try_parse_double(p, e, &value);
+        p = e;
+        return static_cast<real_t>(value);
+    }
+
+    bool parse_real(const char*& p, const char* end, real_t* out) {
+        skip_space(p, end);
+        const char* e = token_end(p, end);
+        double value;
+        bool ret = try_parse_double(p, e, &value);
+        if (ret)
+            *out = static_cast<real_t>(value);
+        p = e;
+        return ret;
+    }
+
+    // atoi
+    int parse_int(const char* p, const char* end) {
+        while (p < end and (is_space(*p) or *p == '\r' or *p == '\n' or *p == '\v' or *p == '\f'))
+            ++p;
+
+        bool negative = false;
+        if (p < end and (*p == '+' or *p == '-'))
+            negative = *p++ == '-';
+
+        int value = 0;
+        while (p < end and is_digit(*p))
+            value = value * 10 + (*p++ - '0');
+        return negative ? -value : value;
+    }
+
+    // strcspn(p, "/ \t\r")
+    const char* index_end(const char* p, const char* end) {
+        while (p < end and *p != '/' and *p != ' ' and *p != '\t' and *p != '\r')
+            ++p;
+        return p;
+    }
+
+    // one of v, vt, vn as it is written, resolved later
+    struct Corner {
+        int v, vt, vn;
+    };
+
+    // a statement replayed in order after the parallel part
+    struct Event {
+        enum Kind { UseMtl, MtlLib, Group, Object, Smoothing } kind;
+        uint32_t faces;    // of the chunk before it
+        size_t line;       // 1 based in the chunk
+        std::string text;  // the line from the statement on
+    };
+
+    struct Chunk {
+        const char* begin;
+        const char* end;
+
+        std::vector<real_t> v, vn, vt, vc;
+        std::vector<Corner> corners;
+        std::vector<uint32_t> faces = {0};  // first corner of every face, then one past the last
+        // corner components written relative to the counts in the chunk, as 3 * corner + v, vt or vn
+        std::vector<size_t> relative;
+        std::vector<Event> events;
+
+        size_t lines = 0;
+        bool unsupported = false;
+        size_t error_line = 0;  // 1 based in the chunk, 0 is none
+
+        size_t face_count() const {
+            return faces.size() - 1;
+        }
+    };
+
+    // i, i/j, i//k or i/j/k. Indices are fixed like tinyobj fixIndex does it, negative
+    // ones against the counts of the chunk and noted in relative. False for a zero index.
+    bool parse_corner(const char*& p, const char* end, Chunk& chunk) {
+        Corner corner {-1, -1, -1};
+        const size_t id = chunk.corners.size();
+        const int counts[3] = {int(chunk.v.size() / 3), int(chunk.vt.size() / 2), int(chunk.vn.size() / 3)};
+
+        auto fix = [&](int component, int* out) {
+            int idx = parse_int(p, end);
+            p = index_end(p, end);
+            if (idx == 0)
+                return false;
+
+            if (idx > 0) {
+                *out = idx - 1;
+            } else {
+                *out = counts[component] + idx;
+                chunk.relative.push_back(3 * id + component);
+            }
+            return true;
+        };
+
+        if (not fix(0, &corner.v))
+            return false;
+
+        if (p < end and *p == '/') {
+            ++p;
+            if (p < end and *p == '/') {
+                ++p;
+                if (not fix(2, &corner.vn))
+                    return false;
+            } else {
+                if (not fix(1, &corner.vt))
+                    return false;
+                if (p < end and *p == '/') {
+                    ++p;
+                    if (not fix(2, &corner.vn))
+                        return false;
+                }
+            }
+        }
+
+        chunk.corners.push_back(corner);
+        return true;
+    }
+
+    void parse_chunk(Chunk& chunk) {
+        const char* p = chunk.begin;
+
+        while (p < chunk.end) {
+            const char* eol = static_cast<const char*>(std::memchr(p, '\n', chunk.end - p));
+            if (not eol)
+                eol = chunk.end;
+            const char* token = p;
+            p = eol + 1;
+            chunk.lines += 1;
+
+            // tinyobj ends a line at a lone \r as well
+            const char* end = static_cast<const char*>(std::memchr(token, '\r', eol - token));
+            if (not end)
+                end = eol;
+            else if (end + 1 != eol) {
+                chunk.unsupported = true;
+                return;
+            }
+
+            skip_space(token, end);
+            if (token == end or *token == '#')
+                continue;
+
+            auto at = [&](int i) {
+                return token + i < end ? token[i] : '\0';
+            };
+
+            if (at(0) == 'v' and is_space(at(1))) {
+                token += 2;
+                real_t x = parse_real(token, end), y = parse_real(token, end), z = parse_real(token, end);
+                real_t r, g, b;
+                if (not (parse_real(token, end, &r) and parse_real(token, end, &g) and parse_real(token, end, &b)))
+                    r = g = b = 1.0;
+
+                chunk.v.insert(chunk.v.end(), {x, y, z});
+                chunk.vc.insert(chunk.vc.end(), {r, g, b});
+            } else if (at(0) == 'v' and at(1) == 'n' and is_space(at(2))) {
+                token += 3;
+                real_t x = parse_real(token, end), y = parse_real(token, end), z = parse_real(token, end);
+                chunk.vn.insert(chunk.vn.end(), {x, y, z});
+            } else if (at(0) == 'v' and at(1) == 't' and is_space(at(2))) {
+                token += 3;
+                real_t x = parse_real(token, end), y = parse_real(token, end);
+                chunk.vt.insert(chunk.vt.end(), {x, y});
+            } else if ((at(0) == 'v' and at(1) == 'w' and is_space(at(2)))
+                       or ((at(0) == 'l' or at(0) == 'p' or at(0) == 't') and is_space(at(1)))) {
+                chunk.unsupported = true;
+                return;
+            } else if (at(0) == 'f' and is_space(at(1))) {
+                token += 2;
+                skip_space(token, end);
+                while (token < end and *token != '\r' and *token != '\0') {
+                    if (not parse_corner(token, end, chunk)) {
+                        chunk.error_line = chunk.lines;
+                        return;
+                    }
+                    while (token < end and (is_space(*token) or *token == '\r'))
+                        ++token;
+                }
+                chunk.faces.push_back(uint32_t(chunk.corners.size()));
+            } else {
+                Event::Kind kind;
+                if (end - token >= 6 and std::strncmp(token, "usemtl", 6) == 0)
+                    kind = Event::UseMtl;
+                else if (end - token >= 6 and std::strncmp(token, "mtllib", 6) == 0 and is_space(at(6)))
+                    kind = Event::MtlLib;
+                else if (at(0) == 'g' and is_space(at(1)))
+                    kind = Event::Group;
+                else if (at(0) == 'o' and is_space(at(1)))
+                    kind = Event::Object;
+                else if (at(0) == 's' and is_space(at(1)))
+                    kind = Event::Smoothing;
+                else
+                    continue;
+                chunk.events.push_back(Event {kind, uint32_t(chunk.face_count()), chunk.lines, std::string(token, end)});
+            }
+        }
+    }
+
+    // faces [first, last) of a chunk, all with one smoothing group
+    struct Segment {
+        size_t chunk;
+        uint32_t first, last;
+        unsigned int smoothing;
+    };
+
+    // faces exported to a shape with one material, see tinyobj exportGroupsToShape
+    struct Batch {
+        std::vector<Segment> segments;
+        int material;
+        size_t first_job = 0, last_job = 0;
+    };
+
+    struct ShapeBuild {
+        std::string name;
+        std::vector<size_t> batches;
+        bool keep_empty = false;  // the last shape is kept when it had faces, even if nothing came out of them
+    };
+
+    struct TriangulateJob {
+        Segment segment;
+        int material;
+        tinyobj::mesh_t mesh;
+    };
+
+    std::string parse_string(const char** token) {
+        (*token) += strspn((*token), " \t");
+        size_t e = strcspn((*token), " \t\r");
+        std::string s((*token), &(*token)[e]);
+        (*token) += e;
+        return s;
+    }
+
+    template <typename T>
+    int pnpoly(int nvert, T* vertx, T* verty, T testx, T testy) {
+        int i, j, c = 0;
+        for (i = 0, j = nvert - 1; i < nvert; j = i++) {
+            if (((verty[i] > testy) != (verty[j] > testy))
+                and (testx < (vertx[j] - vertx[i]) * (testy - verty[i]) / (verty[j] - verty[i]) + vertx[i]))
+                c = !c;
+        }
+        return c;
+    }
+
+    void push_triangle(tinyobj::mesh_t& mesh, const Corner& a, const Corner& b, const Corner& c,
+                       int material, unsigned int smoothing) {
+        for (const Corner* corner: {&a, &b, &c}) {
+            tinyobj::index_t idx;
+            idx.vertex_index = corner->v;
+            idx.normal_index = corner->vn;
+            idx.texcoord_index = corner->vt;
+            mesh.indices.push_back(idx);
+        }
+        mesh.num_face_vertices.push_back(3);
+        mesh.material_ids.push_back(material);
+        mesh.smoothing_group_ids.push_back(smoothing);
+    }
+
+    // the triangulating part of tinyobj exportGroupsToShape, for one face
+    void triangulate(const Corner* corners, size_t count, const std::vector<real_t>& v, int material,
+                     unsigned int smoothing, tinyobj::mesh_t& mesh) {
+        size_t npolys = count;
+        if (npolys < 3)
+            return;
+
+        // find the two axes to work in
+        size_t axes[2] = {1, 2};
+        for (size_t k = 0; k < npolys; ++k) {
+            size_t vi0 = size_t(corners[(k + 0) % npolys].v);
+            size_t vi1 = size_t(corners[(k + 1) % npolys].v);
+            size_t vi2 = size_t(corners[(k + 2) % npolys].v);
+
+            if (((3 * vi0 + 2) >= v.size()) or ((3 * vi1 + 2) >= v.size()) or ((3 * vi2 + 2) >= v.size()))
+                continue;
+
+            real_t e0x = v[vi1 * 3 + 0] - v[vi0 * 3 + 0];
+            real_t e0y = v[vi1 * 3 + 1] - v[vi0 * 3 + 1];
+            real_t e0z = v[vi1 * 3 + 2] - v[vi0 * 3 + 2];
+            real_t e1x = v[vi2 * 3 + 0] - v[vi1 * 3 + 0];
+            real_t e1y = v[vi2 * 3 + 1] - v[vi1 * 3 + 1];
+            real_t e1z = v[vi2 * 3 + 2] - v[vi1 * 3 + 2];
+            real_t cx = std::fabs(e0y * e1z - e0z * e1y);
+            real_t cy = std::fabs(e0z * e1x - e0x * e1z);
+            real_t cz = std::fabs(e0x * e1y - e0y * e1x);
+            const real_t epsilon = std::numeric_limits<real_t>::epsilon();
+            if (cx > epsilon or cy > epsilon or cz > epsilon) {
+                // found a corner
+                if (cx > cy and cx > cz) {
+                } else {
+                    axes[0] = 0;
+                    if (cz > cx and cz > cy)
+                        axes[1] = 1;
+                }
+                break;
+            }
+        }
+
+        real_t area = 0;
+        for (size_t k = 0; k < npolys; ++k) {
+            size_t vi0 = size_t(corners[(k + 0) % npolys].v);
+            size_t vi1 = size_t(corners[(k + 1) % npolys].v);
+            if (((vi0 * 3 + axes[0]) >= v.size()) or ((vi0 * 3 + axes[1]) >= v.size())
+                or ((vi1 * 3 + axes[0]) >= v.size()) or ((vi1 * 3 + axes[1]) >= v.size()))
+                continue;
+
+            real_t v0x = v[vi0 * 3 + axes[0]];
+            real_t v0y = v[vi0 * 3 + axes[1]];
+            real_t v1x = v[vi1 * 3 + axes[0]];
+            real_t v1y = v[vi1 * 3 + axes[1]];
+            area += (v0x * v1y - v0y * v1x) * static_cast<real_t>(0.5);
+        }
+
+        std::vector<Corner> remaining(corners, corners + count);
+        size_t guess_vert = 0;
+        Corner ind[3];
+        real_t vx[3], vy[3];
+
+        // how many iterations can we do without decreasing the remaining vertices
+        size_t remaining_iterations = count;
+        size_t previous_remaining_vertices = remaining.size();
+
+        while (remaining.size() > 3 and remaining_iterations > 0) {
+            npolys = remaining.size();
+            if (guess_vert >= npolys)
+                guess_vert -= npolys;
+
+            if (previous_remaining_vertices != npolys) {
+                previous_remaining_vertices = npolys;
+                remaining_iterations = npolys;
+            } else {
+                remaining_iterations--;
+            }
+
+            for (size_t k = 0; k < 3; k++) {
+                ind[k] = remaining[(guess_vert + k) % npolys];
+                size_t vi = size_t(ind[k].v);
+                if (((vi * 3 + axes[0]) >= v.size()) or ((vi * 3 + axes[1]) >= v.size())) {
+                    vx[k] = static_cast<real_t>(0.0);
+                    vy[k] = static_cast<real_t>(0.0);
+                } else {
+                    vx[k] = v[vi * 3 + axes[0]];
+                    vy[k] = v[vi * 3 + axes[1]];
+                }
+            }
+            real_t e0x = vx[1] - vx[0];
+            real_t e0y = vy[1] - vy[0];
+            real_t e1x = vx[2] - vx[1];
+            real_t e1y = vy[2] - vy[1];
+            real_t cross = e0x * e1y - e0y * e1x;
+            // an internal angle
+            if (cross * area < static_cast<real_t>(0.0)) {
+                guess_vert += 1;
+                continue;
+            }
+
+            // other vertices inside this triangle
+            bool overlap = false;
+            for (size_t other = 3; other < npolys; ++other) {
+                size_t idx = (guess_vert + other) % npolys;
+                size_t ovi = size_t(remaining[idx].v);
+                if (((ovi * 3 + axes[0]) >= v.size()) or ((ovi * 3 + axes[1]) >= v.size()))
+                    continue;
+
+                real_t tx = v[ovi * 3 + axes[0]];
+                real_t ty = v[ovi * 3 + axes[1]];
+                if (pnpoly(3, vx, vy, tx, ty)) {
+                    overlap = true;
+                    break;
+                }
+            }
+
+            if (overlap) {
+                guess_vert += 1;
+                continue;
+            }
+
+            // an ear
+            push_triangle(mesh, ind[0], ind[1], ind[2], material, smoothing);
+            remaining.erase(remaining.begin() + (guess_vert + 1) % npolys);
+        }
+
+        if (remaining.size() == 3)
+            push_triangle(mesh, remaining[0], remaining[1], remaining[2], material, smoothing);
+    }
+}
+
+bool load_obj_parallel(tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes,
+                       std::vector<tinyobj::material_t>* materials, std::string* warn, std::string* err,
+                       const char* filename, int threads) {
+    attrib->vertices.clear();
+    attrib->vertex_weights.clear();
+    attrib->normals.clear();
+    attrib->texcoords.clear();
+    attrib->texcoord_ws.clear();
+    attrib->colors.clear();
+    attrib->skin_weights.clear();
+    shapes->clear();
+
+    FileBytes file(filename);
+    if (not file.ok()) {
+        if (err)
+            *err = std::string("Cannot open file [") + filename + "]\n";
+        return false;
+    }
+
+    // chunks end after a newline
+    const size_t num_chunks = std::max<size_t>(1, std::min<size_t>(4 * threads, file.size() / MIN_CHUNK_BYTES));
+    std::vector<Chunk> chunks;
+    const char* const file_end = file.data() + file.size();
+    const char* begin = file.data();
+    for (size_t c = 1; c <= num_chunks and begin < file_end; ++c) {
+        const char* end = c == num_chunks ? file_end : file.data() + file.size() * c / num_chunks;
+        if (end < begin)
+            continue;
+        const char* eol = static_cast<const char*>(std::memchr(end, '\n', file_end - end));
+        end = eol ? eol + 1 : file_end;
+
+        chunks.emplace_back();
+        chunks.back().begin = begin;
+        chunks.back().end = end;
+        begin = end;
+    }
+
+    parallel_for(int(chunks.size()), threads, [&](int c) { parse_chunk(chunks[c]); });
+
+    size_t lines = 0;
+    for (const Chunk& chunk: chunks) {
+        if (chunk.unsupported)
+            return tinyobj::LoadObj(attrib, shapes, materials, warn, err, filename);
+        if (chunk.error_line) {
+            if (err) {
+                std::stringstream ss;
+                ss << "Failed parse `f' line(e.g. zero value for face index. line " << lines + chunk.error_line << ".)\n";
+                *err += ss.str();
+            }
+            return false;
+        }
+        lines += chunk.lines;
+    }
+
+    // the attribute arrays, with relative indices resolved against them
+    std::vector<size_t> v_offset(chunks.size() + 1, 0), vn_offset = v_offset, vt_offset = v_offset;
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        v_offset[c + 1] = v_offset[c] + chunks[c].v.size();
+        vn_offset[c + 1] = vn_offset[c] + chunks[c].vn.size();
+        vt_offset[c + 1] = vt_offset[c] + chunks[c].vt.size();
+    }
+    attrib->vertices.resize(v_offset.back());
+    attrib->colors.resize(v_offset.back());
+    attrib->normals.resize(vn_offset.back());
+    attrib->texcoords.resize(vt_offset.back());
+
+    std::vector<Corner> greatest(chunks.size(), Corner {-1, -1, -1});
+    parallel_for(int(chunks.size()), threads, [&](int c) {
+        Chunk& chunk = chunks[c];
+        std::copy(chunk.v.begin(), chunk.v.end(), attrib->vertices.begin() + v_offset[c]);
+        std::copy(chunk.vc.begin(), chunk.vc.end(), attrib->colors.begin() + v_offset[c]);
+        std::copy(chunk.vn.begin(), chunk.vn.end(), attrib->normals.begin() + vn_offset[c]);
+        std::copy(chunk.vt.begin(), chunk.vt.end(), attrib->texcoords.begin() + vt_offset[c]);
+
+        const int offsets[3] = {int(v_offset[c] / 3), int(vt_offset[c] / 2), int(vn_offset[c] / 3)};
+        for (size_t r: chunk.relative) {
+            Corner& corner = chunk.corners[r / 3];
+            (r % 3 == 0 ? corner.v : r % 3 == 1 ? corner.vt : corner.vn) += offsets[r % 3];
+        }
+        for (const Corner& corner: chunk.corners) {
+            greatest[c].v = std::max(greatest[c].v, corner.v);
+            greatest[c].vt = std::max(greatest[c].vt, corner.vt);
+            greatest[c].vn = std::max(greatest[c].vn, corner.vn);
+        }
+    });
+
+    // statements that cut faces into shapes, in file order
+    std::map<std::string, int> material_map;
+    tinyobj::MaterialFileReader read_materials("");
+    int material = -1;
+    unsigned int smoothing = 0;
+    std::string name;
+
+    std::vector<Batch> batches;
+    std::vector<ShapeBuild> builds;
+    ShapeBuild shape;
+    std::vector<Segment> group;
+
+    auto export_group = [&]() {
+        if (group.empty())
+            return false;
+        shape.name = name;
+        shape.batches.push_back(batches.size());
+        batches.push_back(Batch {group, material});
+        return true;
+    };
+
+    size_t first_line = 0;
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        uint32_t first = 0;
+        auto flush = [&](uint32_t last) {
+            if (last > first)
+                group.push_back(Segment {c, first, last, smoothing});
+            first = last;
+        };
+
+        for (const Event& event: chunks[c].events) {
+            flush(event.faces);
+            const char* token = event.text.c_str();
+
+            if (event.kind == Event::UseMtl) {
+                token += 6;
+                std::string namebuf = parse_string(&token);
+
+                int new_material = -1;
+                auto it = material_map.find(namebuf);
+                if (it != material_map.end())
+                    new_material = it->second;
+                else if (warn)
+                    *warn += "material [ '" + namebuf + "' ] not found in .mtl\n";
+
+                if (new_material != material) {
+                    export_group();
+                    group.clear();
+                    material = new_material;
+                }
+            } else if (event.kind == Event::MtlLib) {
+                token += 7;
+                std::vector<std::string> filenames;
+                std::stringstream ss(token);
+                std::string item;
+                while (std::getline(ss, item, ' '))
+                    filenames.push_back(item);
+
+                if (filenames.empty()) {
+                    if (warn) {
+                        std::stringstream ss;
+                        ss << "Looks like empty filename for mtllib. Use default material (line "
+                           << first_line + event.line << ".)\n";
+                        *warn += ss.str();
+                    }
+                } else {
+                    bool found = false;
+                    for (const auto& mtl: filenames) {
+                        std::string warn_mtl, err_mtl;
+                        bool ok = read_materials(mtl, materials, &material_map, &warn_mtl, &err_mtl);
+                        if (warn)
+                            *warn += warn_mtl;
+                        if (err)
+                            *err += err_mtl;
+                        if (ok) {
+                            found = true;
+                            break;
+                        }
+                    }
+                    if (not found and warn)
+                        *warn += "Failed to load material file(s). Use default material.\n";
+                }
+            } else if (event.kind == Event::Group or event.kind == Event::Object) {
+                export_group();
+                builds.push_back(shape);
+                shape = ShapeBuild();
+                group.clear();
+
+                if (event.kind == Event::Object) {
+                    name = token + 2;
+                } else {
+                    // names[0] is the g
+                    std::vector<std::string> names;
+                    while (*token != '\0' and *token != '\r' and *token != '\n') {
+                        names.push_back(parse_string(&token));
+                        token += strspn(token, " \t\r");
+                    }
+
+                    if (names.size() < 2) {
+                        // like tinyobj, the name is only reset with warnings
+                        if (warn) {
+                            std::stringstream ss;
+                            ss << "Empty group name. line: " << first_line + event.line << "\n";
+                            *warn += ss.str();
+                            name = "";
+                        }
+                    } else {
+                        name = names[1];
+                        for (size_t i = 2; i < names.size(); ++i)
+                            name += " " + names[i];
+                    }
+                }
+            } else if (event.kind == Event::Smoothing) {
+                token += 2;
+                token += strspn(token, " \t");
+                if (token[0] == '\0' or token[0] == '\r' or token[1] == '\n')
+                    continue;
+
+                if (strlen(token) >= 3 and token[0] == 'o' and token[1] == 'f' and token[2] == 'f') {
+                    smoothing = 0;
+                } else {
+                    int id = atoi(token);
+                    smoothing = id < 0 ? 0 : static_cast<unsigned int>(id);
+                }
+            }
+        }
+        flush(uint32_t(chunks[c].face_count()));
+        first_line += chunks[c].lines;
+    }
+    shape.keep_empty = export_group();
+    builds.push_back(shape);
+
+    // triangulation jobs of at most TRIANGULATE_FACES faces, in batch order
+    std::vector<TriangulateJob> jobs;
+    for (Batch& batch: batches) {
+        batch.first_job = jobs.size();
+        for (const Segment& segment: batch.segments)
+            for (uint32_t f = segment.first; f < segment.last; f += TRIANGULATE_FACES) {
+                Segment piece = segment;
+                piece.first = f;
+                piece.last = std::min(segment.last, f + TRIANGULATE_FACES);
+                jobs.push_back(TriangulateJob {piece, batch.material, {}});
+            }
+        batch.last_job = jobs.size();
+    }
+
+    parallel_for(int(jobs.size()), threads, [&](int j) {
+        TriangulateJob& job = jobs[j];
+        const Chunk& chunk = chunks[job.segment.chunk];
+        for (uint32_t f = job.segment.first; f < job.segment.last; ++f)
+            triangulate(chunk.corners.data() + chunk.faces[f], chunk.faces[f + 1] - chunk.faces[f],
+                        attrib->vertices, job.material, job.segment.smoothing, job.mesh);
+    });
+
+    for (const ShapeBuild& build: builds) {
+        tinyobj::shape_t out;
+        out.name = build.name;
+        for (size_t b: build.batches)
+            for (size_t j = batches[b].first_job; j < batches[b].last_job; ++j) {
+                const tinyobj::mesh_t& mesh = jobs[j].mesh;
+                out.mesh.indices.insert(out.mesh.indices.end(), mesh.indices.begin(), mesh.indices.end());
+                out.mesh.num_face_vertices.insert(out.mesh.num_face_vertices.end(), mesh.num_face_vertices.begin(),
+                                                  mesh.num_face_vertices.end());
+                out.mesh.material_ids.insert(out.mesh.material_ids.end(), mesh.material_ids.begin(),
+                                             mesh.material_ids.end());
+                out.mesh.smoothing_group_ids.insert(out.mesh.smoothing_group_ids.end(),
+                                                    mesh.smoothing_group_ids.begin(), mesh.smoothing_group_ids.end());
+            }
+
+        if (not out.mesh.indices.empty() or build.keep_empty)
+            shapes->push_back(std::move(out));
+    }
+
+    Corner max_index {-1, -1, -1};
+    for (const Corner& corner: greatest) {
+        max_index.v = std::max(max_index.v, corner.v);
+        max_index.vt = std::max(max_index.vt, corner.vt);
+        max_index.vn = std::max(max_index.vn, corner.vn);
+    }
+    if (warn) {
+        std::stringstream ss;
+        if (max_index.v >= int(attrib->vertices.size() / 3))
+            ss << "Vertex indices out of bounds (line " << lines << ".)\n" << std::endl;
+        if (max_index.vn >= int(attrib->normals.size() / 3))
+            ss << "Vertex normal indices out of bounds (line " << lines << ".)\n" << std::endl;
+        if (max_index.vt >= int(attrib->texcoords.size() / 2))
+            ss << "Vertex texcoord indices out of bounds (line " << lines << ".)\n" << std::endl;
+        *warn += ss.str();
+    }
+    return true;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "parallel_for.h"
+#include "tiny_obj_loader.h"
+
+// Same as tinyobj::LoadObj(attrib, shapes, materials, warn, err, filename) with the
+// default triangulation and vertex colors, on threads:
+// - the file is mapped and cut into chunks at line starts;
+// - the chunks are parsed in parallel, with tinyobj's number arithmetic, so the values
+//   are bit for bit the same, but straight from the mapping instead of through getline;
+// - the v, vn, vt arrays are concatenated and relative face indices resolved;
+// - usemtl, mtllib, g, o and s are replayed in order to cut the faces into shapes;
+// - polygons are triangulated in parallel, with tinyobj's ear clipping.
+// Files with statements this does not handle (l, p, vw, t) go to tinyobj::LoadObj.
+bool load_obj_parallel(tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes,
+                       std::vector<tinyobj::material_t>* materials, std::string* warn, std::string* err,
+                       const char* filename, int threads = default_thread_count());
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <GL/glew.h>
+
+#include "opengl_shader.h"
+
+// std140 mirrors of the uniform blocks of the shaders. Every program binds a block to
+// the same binding point, shader_t::bind_block checks its layout against the mirror.
+
+const GLuint FRAME_BLOCK_BINDING = 0;
+const GLuint MATERIAL_BLOCK_BINDING = 1;
+
+// Frame, written once per frame and read by both passes
+struct FrameBlock {
+    glm::mat4 lightmat;
+    glm::vec3 camera;
+    float pad0;
+    glm::vec3 sun_location;  // normalized
+    float pad1;
+};
+static_assert(sizeof(FrameBlock) == 96, "FrameBlock is uploaded as is");
+
+const std::vector<block_member_t> FRAME_BLOCK_MEMBERS = {
+    {"u_lightmat", offsetof(FrameBlock, lightmat)},
+    {"u_camera", offsetof(FrameBlock, camera)},
+    {"u_sun_location", offsetof(FrameBlock, sun_location)},
+};
+
+// Material, one per model, the water members are for the ground
+struct MaterialBlock {
+    glm::vec4 color;
+    glm::vec4 water_color;
+    glm::vec3 light;
+    float water_level;
+    glm::vec3 light_wat;
+    float pad0;
+};
+static_assert(sizeof(MaterialBlock) == 64, "MaterialBlock is uploaded as is");
+
+const std::vector<block_member_t> MATERIAL_BLOCK_MEMBERS = {
+    {"u_color", offsetof(MaterialBlock, color)},
+    {"u_water_color", offsetof(MaterialBlock, water_color)},
+    {"u_light", offsetof(MaterialBlock, light)},
+    {"u_water_level", offsetof(MaterialBlock, water_level)},
+    {"u_light_wat", offsetof(MaterialBlock, light_wat)},
+};
+
+// Binds Frame and Material of a program that was just linked. False and reported when
+// either is missing or laid out otherwise, left unbound both would read binding 0.
+inline bool bind_uniform_blocks(shader_t& shader, const std::string& name) {
+    if (not shader.bind_block("Frame", FRAME_BLOCK_BINDING, sizeof(FrameBlock), FRAME_BLOCK_MEMBERS) or
+        not shader.bind_block("Material", MATERIAL_BLOCK_BINDING, sizeof(MaterialBlock), MATERIAL_BLOCK_MEMBERS)) {
+        std::cerr << "uniform blocks of " << name << " don't match uniform_blocks.h" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// A uniform buffer of one T, uploaded when the value changes. T is value initialized
+// by the callers so that the padding compares equal.
+template<typename T>
+class uniform_buffer_t {
+private:
+    GLuint buffer;
+    T last;
+    bool written = false;
+
+public:
+    uniform_buffer_t(const uniform_buffer_t& other) = delete;
+    uniform_buffer_t& operator=(const uniform_buffer_t& other) = delete;
+
+    uniform_buffer_t() {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    ~uniform_buffer_t() {
+        glDeleteBuffers(1, &buffer);
+    }
+
+    void update(const T& value) {
+        if (written and std::memcmp(&last, &value, sizeof(T)) == 0)
+            return;
+
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &value);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        std::memcpy(&last, &value, sizeof(T));
+        written = true;
+    }
+
+    void bind(GLuint binding) const {
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+    }
+};
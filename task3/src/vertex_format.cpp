@@ -0,0 +1,89 @@
+#include "vertex_format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "parallel_for.h"
+
+namespace
+{
+    // vertices per parallel_for job
+    const size_t BLOCK_SIZE = 1 << 16;
+
+    // The GL 3.3 decode of a normalized signed 10 bit c is (2c + 1) / 1023, so -1 and 1
+    // are exact and 0 is half a step off. 4.2 and later decode max(c / 511, -1) instead,
+    // which is off by less than 0.003, and the shaders normalize the normal anyway.
+    uint32_t snorm10(float v) {
+        float c = (std::max(-1.0f, std::min(1.0f, v)) * 1023.0f - 1.0f) / 2;
+        int q = std::max(-512, std::min(511, int(std::round(c))));
+        return uint32_t(q) & 0x3ff;
+    }
+}
+
+uint32_t pack_normal(float x, float y, float z) {
+    float length = std::sqrt(x * x + y * y + z * z);
+    if (length > 0) {
+        x /= length;
+        y /= length;
+        z /= length;
+    }
+    return snorm10(x) | snorm10(y) << 10 | snorm10(z) << 20;
+}
+
+bool pack_vertices(const float* vertices, size_t vertex_count, int floats_per_vertex, PackedMesh& packed) {
+    float lo[3] = {0, 0, 0}, hi[3] = {0, 0, 0};
+    for (size_t v = 0; v < vertex_count; ++v)
+        for (int a = 0; a < 3; ++a) {
+            float p = vertices[v * floats_per_vertex + a];
+            lo[a] = v ? std::min(lo[a], p) : p;
+            hi[a] = v ? std::max(hi[a], p) : p;
+        }
+
+    // colors in order of first use
+    std::vector<uint8_t> color(floats_per_vertex == 9 ? vertex_count : 0);
+    packed.palette.clear();
+    for (size_t v = 0; v < color.size(); ++v) {
+        const float* rgb = vertices + v * floats_per_vertex + 6;
+        size_t c = 0;
+        while (c < packed.palette.size() / 3 and not std::equal(rgb, rgb + 3, packed.palette.begin() + 3 * c))
+            ++c;
+        if (c == packed.palette.size() / 3) {
+            if (c == MAX_PALETTE_SIZE)
+                return false;
+            packed.palette.insert(packed.palette.end(), rgb, rgb + 3);
+        }
+        color[v] = uint8_t(c);
+    }
+
+    float scale[3];
+    std::memset(packed.position_dequant, 0, sizeof(packed.position_dequant));
+    for (int a = 0; a < 3; ++a) {
+        scale[a] = hi[a] > lo[a] ? 65535.0f / (hi[a] - lo[a]) : 0.0f;
+        packed.position_dequant[5 * a] = hi[a] - lo[a];
+        packed.position_dequant[12 + a] = lo[a];
+    }
+    packed.position_dequant[15] = 1;
+
+    packed.vertices.resize(vertex_count);
+    const int blocks = int((vertex_count + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    parallel_for(blocks, default_thread_count(), [&](int b) {
+        const size_t end = std::min(vertex_count, (b + 1) * BLOCK_SIZE);
+        for (size_t v = b * BLOCK_SIZE; v < end; ++v) {
+            const float* in = vertices + v * floats_per_vertex;
+            PackedVertex& out = packed.vertices[v];
+            for (int a = 0; a < 3; ++a)
+                out.position[a] = uint16_t(std::round((in[a] - lo[a]) * scale[a]));
+            out.color = color.empty() ? 0 : color[v];
+            out.reserved = 0;
+            out.normal = pack_normal(in[3], in[4], in[5]);
+        }
+    });
+    return true;
+}
+
+std::vector<uint16_t> narrow_indices(const unsigned int* indices, size_t index_count, size_t vertex_count) {
+    if (vertex_count > 65536)
+        return {};
+    return std::vector<uint16_t>(indices, indices + index_count);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The packed vertex layout of the vbos, against 6 or 9 floats (24 or 36 bytes):
+//   position  3 x GL_UNSIGNED_SHORT, normalized over the bounding box of the mesh,
+//             position_dequant maps them back
+//   color     GL_UNSIGNED_BYTE index into the palette of the mesh, 8 bit material ids
+//   normal    GL_INT_2_10_10_10_REV, normalized
+struct PackedVertex {
+    uint16_t position[3];
+    uint8_t color;
+    uint8_t reserved;
+    uint32_t normal;
+};
+static_assert(sizeof(PackedVertex) == 12, "PackedVertex is uploaded as is");
+
+// colors a shader takes as uniforms, meshes with more keep float vertices
+const size_t MAX_PALETTE_SIZE = 64;
+
+struct PackedMesh {
+    std::vector<PackedVertex> vertices;
+    std::vector<float> palette;  // 3 floats per color
+    float position_dequant[16];  // column major, the 0..1 positions to model space
+};
+
+// n with components in -1..1, scaled to unit length first
+uint32_t pack_normal(float x, float y, float z);
+
+// vertices of position, normal and with 9 floats_per_vertex a color. False when there
+// are more than MAX_PALETTE_SIZE colors.
+bool pack_vertices(const float* vertices, size_t vertex_count, int floats_per_vertex, PackedMesh& packed);
+
+// GL_UNSIGNED_SHORT indices when vertex_count allows, else empty
+std::vector<uint16_t> narrow_indices(const unsigned int* indices, size_t index_count, size_t vertex_count);
@@ -22,6 +22,7 @@
 
 #include "stb_image.h"
 #include "tiny_obj_loader.h"
+#include "gl_state.h"
 #include "opengl_shader.h"
 #include "miniconfig.h"
 
@@ -240,7 +241,7 @@ public:
 class Texture {
 private:
     int width, height;
-    GLuint texture;
+    GLuint texture, sampler;
     
 public:
     Texture(const Texture& other) = delete;
@@ -258,10 +259,11 @@ public:
             throw std::runtime_error(std::string("failed to load texture ") + path);
         
         glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
+        gl_state.bind_texture(GL_TEXTURE0, GL_TEXTURE_2D, texture);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
         
         glGenerateMipmap(GL_TEXTURE_2D);
+        sampler = gl_state.sampler(GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE);
         
         stbi_image_free(data);
     }
@@ -271,18 +273,7 @@ public:
     }
 
     void bind(GLuint slot = GL_TEXTURE0) {
-        glActiveTexture(slot);
-        glBindTexture(GL_TEXTURE_2D, texture);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    }
-
-    static void unbind(GLuint slot=GL_TEXTURE0) {
-        glActiveTexture(slot);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        gl_state.bind_texture(slot, GL_TEXTURE_2D, texture, sampler);
     }
 };
 
@@ -306,6 +297,8 @@ public:
 class TrivialModel: public ModelBase {
 private:
     shader_t shader;
+    uniform_t<glm::mat4> u_vp_inv;
+    uniform_t<glm::vec3> u_camera;
     
     GLuint vbo, vao, ebo;
     int num_triangles = 2;
@@ -330,7 +323,7 @@ private:
         glGenBuffers(1, &vbo);
         glGenBuffers(1, &ebo);
 
-        glBindVertexArray(vao);
+        gl_state.bind_vertex_array(vao);
 
         glBindBuffer(GL_ARRAY_BUFFER, vbo);
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_data[0]) * vertex_data.size(), vertex_data.data(), GL_STATIC_DRAW);
@@ -341,7 +334,7 @@ private:
         glEnableVertexAttribArray(0);
 
         glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+        gl_state.bind_vertex_array(0);
     }
     
 protected:
@@ -352,12 +345,11 @@ protected:
 
         using std::cout;        
         
-        shader.set_uniform("u_vp_inv", glm::value_ptr(vp_matrix_inv));
-        shader.set_uniformv("u_camera", camera.position);
+        shader.set(u_vp_inv, vp_matrix_inv);
+        shader.set(u_camera, camera.position);
 
-        glBindVertexArray(vao);
+        gl_state.bind_vertex_array(vao);
         glDrawElements(GL_TRIANGLES, num_triangles * 3, GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
     }
     
 public:
@@ -368,6 +360,8 @@ public:
 
     void reload_shader() {
         shader = std::move(shader_t("TheShader.vs", "TheShader.fs"));
+        u_vp_inv = shader.uniform<glm::mat4>("u_vp_inv");
+        u_camera = shader.uniform<glm::vec3>("u_camera");
     }
 };
 
@@ -432,6 +426,9 @@ int main(int, char **) {
     
     opengl.main_loop([&]() {
         process_drag();
+        // of the last frame
+        const uniform_stats_t uniform_stats = shader_t::take_uniform_stats();
+        const GLState::Stats bind_stats = gl_state.take_stats();
 
         glm::vec3 forward = camera.get_forward();
         glm::vec3 up = camera.get_up();
@@ -473,6 +470,9 @@ int main(int, char **) {
 
         ImGui::Begin("Info");
         ImGui::Text("FPS: %d, %0.1f ms per frame", FPS, avg_render_time);
+        ImGui::Text("uniforms: %zu glUniform, %zu unchanged left out, %zu location lookups saved",
+                    uniform_stats.issued, uniform_stats.unchanged, uniform_stats.lookups);
+        ImGui::Text("binds: %zu issued, %zu already bound left out", bind_stats.issued, bind_stats.elided);
         ImGui::Text("");
         ImGui::Text("Coordinates");
         ImGui::Text("x=%0.2f, y=%0.2f, z=%0.2f", camera.position.x, camera.position.y, camera.position.z);
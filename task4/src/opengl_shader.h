@@ -1,11 +1,47 @@
 #pragma once
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <glm/glm.hpp>
 #include <GL/glew.h>
 
+// the GL type of a uniform set from a T
+template<typename T> struct uniform_traits;
+template<> struct uniform_traits<int> { static constexpr GLenum type = GL_INT; };
+template<> struct uniform_traits<float> { static constexpr GLenum type = GL_FLOAT; };
+template<> struct uniform_traits<double> { static constexpr GLenum type = GL_DOUBLE; };
+template<> struct uniform_traits<glm::vec2> { static constexpr GLenum type = GL_FLOAT_VEC2; };
+template<> struct uniform_traits<glm::vec3> { static constexpr GLenum type = GL_FLOAT_VEC3; };
+template<> struct uniform_traits<glm::vec4> { static constexpr GLenum type = GL_FLOAT_VEC4; };
+template<> struct uniform_traits<glm::ivec2> { static constexpr GLenum type = GL_INT_VEC2; };
+template<> struct uniform_traits<glm::mat4> { static constexpr GLenum type = GL_FLOAT_MAT4; };
+
+// A uniform of one program, from shader_t::uniform. int is for int, bool and sampler
+// uniforms. A name the program has no active uniform of that type for gives a handle
+// that sets nothing, as location -1 does.
+template<typename T>
+class uniform_t
+{
+public:
+   using value_type = T;
+
+   bool active() const { return slot_ >= 0; }
+
+private:
+   friend class shader_t;
+   int slot_ = -1;
+};
+
+// glUniform calls of all programs
+struct uniform_stats_t
+{
+   size_t issued = 0;
+   size_t unchanged = 0;  // left out, the program had the value already
+   size_t lookups = 0;    // glGetUniformLocation left out, one per set
+};
+
 class shader_t
 {
 public:
@@ -19,11 +55,54 @@ public:
    template<typename T> void set_uniform(const std::string& name, T val1, T val2, T val3);
    template<typename T> void set_uniform(const std::string& name, T val1, T val2, T val3, T val4);
    template <int C> void set_uniformv(const std::string& name, glm::vec<C, float, glm::defaultp>);
+
+   // the uniforms are listed at link time, these need no glGetUniformLocation and leave
+   // out values the program has already. An array name gives its first element, to set
+   // count of them from there.
+   template<typename T> uniform_t<T> uniform(const std::string& name) const;
+   template<typename T> void set(uniform_t<T> uniform, const typename uniform_t<T>::value_type& value) {
+      store(uniform.slot_, uniform_traits<T>::type, &value, 1);
+   }
+   template<typename T> void set(uniform_t<T> uniform, const T* values, int count) {
+      store(uniform.slot_, uniform_traits<T>::type, values, count);
+   }
+
+   // the calls since the last take, once per frame
+   static uniform_stats_t take_uniform_stats();
+
 private:
+   // one per active uniform, and per element of arrays
+   struct uniform_slot_t
+   {
+      GLint location;
+      GLenum type;     // int, bool and samplers as GL_INT, bvecs as ivecs
+      int array_left;  // elements from this one to the end of its array
+      std::vector<unsigned char> value;  // as last set, empty before
+   };
+
+   void list_uniforms();
+   int find_slot(const std::string& name, GLenum type) const;
+   int handle_slot(const std::string& name, GLenum type) const;
+   void store(int slot, GLenum type, const void* values, int count);
+   void store(const std::string& name, GLenum type, const void* values) {
+      store(find_slot(name, type), type, values, 1);
+   }
+
    void check_compile_error();
    void check_linking_error();
    void compile(const std::string& vertex_code, const std::string& fragment_code);
    void link();
 
    GLuint vertex_id_, fragment_id_, program_id_;
+   std::vector<uniform_slot_t> uniforms_;
+   std::unordered_map<std::string, int> slots_;
+   static uniform_stats_t stats_;
 };
+
+template<typename T>
+uniform_t<T> shader_t::uniform(const std::string& name) const
+{
+   uniform_t<T> uniform;
+   uniform.slot_ = handle_slot(name, uniform_traits<T>::type);
+   return uniform;
+}